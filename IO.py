@@ -3,6 +3,7 @@ import pprint
 import gzip,os,sys,time
 print sys.version
 import hickle as hkl
+import checkpoint
 from numpy import *
 #all numpy symbols have to be imported as * in order to read "array([...])" in .txt file with LoadDict function
 
@@ -21,12 +22,17 @@ def LoadDict(filename):
         return eval(f.read())
 
 def SaveBigDict(filename, root):
-    if filename[-4:]!=".hkl":
-        filename+=".hkl"
-    hkl.dump(root, "_"+filename, mode='w', compression='gzip')
-    os.rename("_"+filename, filename)
+    if filename[-4:]==".hkl":
+        filename=filename[:-4]
+    checkpoint.dump(root, filename)
 
 def LoadBigDict(filename):
-    if filename[-4:]!=".hkl":
-        filename+=".hkl"
-    return hkl.load(filename)
+    """read a native checkpoint if there is one, otherwise an old hickle file"""
+    if filename[-4:]==".hkl" or filename[-5:]==checkpoint.SUFFIX:
+        filename=os.path.splitext(filename)[0]
+    if checkpoint.IsCheckpoint(filename+checkpoint.SUFFIX):
+        return checkpoint.load(filename)
+    return hkl.load(filename+".hkl")
+
+def HasBigDict(filename):
+    return os.path.exists(filename+checkpoint.SUFFIX) or os.path.exists(filename+".hkl")
@@ -0,0 +1,270 @@
+#!/usr/bin/python
+"""
+reader and writer of the native checkpoint files (.ckpt) written by Dictionary::BigSave,
+and of the delta logs (.dlog) appended by the simulator, see src/utility/checkpoint.h for the layout
+"""
+import os, mmap, struct, zlib
+import numpy as np
+
+SUFFIX=".ckpt"
+VERSION=1
+ALIGN=64
+MAGIC=b"FSCKPT\0\0"
+HEADER="<8sIIQQQQ"
+HEADER_SIZE=64
+RECORD="<BBHIqQQ"
+NONE, DICT, LIST, BOOL, INT, REAL, COMPLEX, STRING, ARRAY=range(9)
+
+DELTA_SUFFIX=".dlog"
+DELTA_VERSION=1
+DELTA_MAGIC=b"FSDELTA\0"
+DELTA_HEADER="<8sIIQ"
+DELTA_RECORD=b"FSRECORD"
+DELTA_RECORD_HEADER="<8sQII"
+DELTA_BLOCK=1024
+
+class CheckpointError(IOError):
+    pass
+
+def _AlignUp(offset, align):
+    return (offset+align-1)//align*align
+
+def IsCheckpoint(filename):
+    if not os.path.exists(filename):
+        return False
+    with open(filename, "rb") as f:
+        return f.read(len(MAGIC))==MAGIC
+
+def _parse(buf, filename):
+    """return the Tag, the entries and the children of the entries of a checkpoint in buf"""
+    if len(buf)<HEADER_SIZE:
+        raise CheckpointError("{0} is not a checkpoint file!".format(filename))
+    magic, version, _, nentry, indexoffset, indexsize, tag=struct.unpack_from(HEADER, buf, 0)
+    if magic!=MAGIC or version>VERSION or indexoffset+indexsize>len(buf):
+        raise CheckpointError("{0} is not a valid checkpoint file of version {1}!".format(filename, VERSION))
+    entries=[]
+    p=indexoffset
+    for i in range(nentry):
+        Type, dtypesize, ndim, keysize, parent, offset, size=struct.unpack_from(RECORD, buf, p)
+        p+=struct.calcsize(RECORD)
+        shape=struct.unpack_from("<{0}Q".format(ndim), buf, p)
+        p+=8*ndim
+        dtype=buf[p:p+dtypesize].decode("ascii")
+        p+=dtypesize
+        key=buf[p:p+keysize].decode("utf-8")
+        p+=keysize
+        entries.append((Type, parent, key, dtype, shape, offset, size))
+    if len(entries)==0 or entries[0][0]!=DICT:
+        raise CheckpointError("{0} has a broken index!".format(filename))
+    children=[[] for e in entries]
+    for i, e in enumerate(entries[1:], 1):
+        children[e[1]].append(i)
+    return tag, entries, children
+
+def _paths(entries):
+    paths=[""]
+    for Type, parent, key, dtype, shape, offset, size in entries[1:]:
+        paths.append(key if parent==0 else paths[parent]+"/"+key)
+    return paths
+
+def _unshuffle(planes):
+    n=len(planes)//8
+    data=np.frombuffer(planes, dtype=np.uint8, count=8*n).reshape(8, n).T.tobytes()
+    return data+planes[8*n:]
+
+def _record(payload, arrays, base):
+    """
+    parse a record, return its image and the changes as [(path, size, blocks, data)],
+    or None if it does not fit the base
+    """
+    try:
+        imagesize,=struct.unpack_from("<Q", payload, 0)
+        p=8+imagesize
+        image=payload[8:p]
+        narray,=struct.unpack_from("<I", payload, p)
+        p+=4
+        changes=[]
+        for a in range(narray):
+            pathsize,=struct.unpack_from("<I", payload, p)
+            p+=4
+            path=payload[p:p+pathsize].decode("utf-8")
+            p+=pathsize
+            size, nblock=struct.unpack_from("<QQ", payload, p)
+            p+=16
+            blocks=struct.unpack_from("<{0}Q".format(nblock), payload, p)
+            p+=8*nblock
+            zipsize,=struct.unpack_from("<Q", payload, p)
+            p+=8
+            data=zlib.decompress(payload[p:p+zipsize]) if zipsize>0 else b""
+            p+=zipsize
+            nbytes=sum(min(DELTA_BLOCK, size-b*DELTA_BLOCK) for b in blocks)
+            if len(image)!=imagesize or any(b*DELTA_BLOCK>=size for b in blocks) or len(data)!=nbytes:
+                return None
+            current=arrays[path] if path in arrays else base(path)
+            if current is None or len(current)!=size:
+                return None
+            changes.append((path, size, blocks, _unshuffle(data)))
+        return image, changes
+    except (struct.error, zlib.error, UnicodeDecodeError):
+        return None
+
+def _replay(filename, tag, base):
+    """
+    replay the delta log of a checkpoint with tag, base(path) gives the bytes of an array of the checkpoint;
+    return the image of the last record and the replayed arrays, or None if there is no log of the checkpoint
+    """
+    if tag==0 or not os.path.exists(filename):
+        return None
+    with open(filename, "rb") as f:
+        log=f.read()
+    if len(log)<HEADER_SIZE or log[:len(DELTA_MAGIC)]!=DELTA_MAGIC:
+        print("{0} is not a delta log, it is ignored!".format(filename))
+        return None
+    magic, version, blocksize, baseid=struct.unpack_from(DELTA_HEADER, log, 0)
+    if version>DELTA_VERSION or blocksize!=DELTA_BLOCK or baseid!=tag:
+        return None
+    arrays={}
+    image=None
+    p=HEADER_SIZE
+    headersize=struct.calcsize(DELTA_RECORD_HEADER)
+    while len(log)-p>=headersize:
+        magic, size, crc, _=struct.unpack_from(DELTA_RECORD_HEADER, log, p)
+        payload=log[p+headersize:p+headersize+size]
+        if magic!=DELTA_RECORD or len(payload)!=size or zlib.crc32(payload)&0xffffffff!=crc:
+            break
+        record=_record(payload, arrays, base)
+        if record is None:
+            break
+        image, changes=record
+        for path, arraysize, blocks, data in changes:
+            if path not in arrays:
+                arrays[path]=bytearray(base(path))
+            offset=0
+            for b in blocks:
+                n=min(DELTA_BLOCK, arraysize-b*DELTA_BLOCK)
+                arrays[path][b*DELTA_BLOCK:b*DELTA_BLOCK+n]=data[offset:offset+n]
+                offset+=n
+        p+=headersize+size
+    if p<len(log):
+        print("The last {0} bytes of {1} are not a complete record, they are dropped!".format(len(log)-p, filename))
+    if image is None:
+        return None
+    return image, arrays
+
+def load(filename):
+    if filename[-5:]!=SUFFIX:
+        filename+=SUFFIX
+    with open(filename, "rb") as f:
+        #ACCESS_COPY, so that arrays are writable and changes never go back to the file
+        buf=mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_COPY)
+    tag, entries, children=_parse(buf, filename)
+    paths=_paths(entries)
+    arrays={}
+
+    def base(path):
+        if path not in paths:
+            return None
+        Type, parent, key, dtype, shape, offset, size=entries[paths.index(path)]
+        return buf[offset:offset+size] if Type==ARRAY else None
+
+    replayed=_replay(filename[:-len(SUFFIX)]+DELTA_SUFFIX, tag, base)
+    if replayed is not None:
+        #the entries of the last record, with the replayed arrays in place of the empty ones
+        image, arrays=replayed
+        buf=bytearray(image)
+        tag, entries, children=_parse(buf, filename)
+        paths=_paths(entries)
+
+    def decode(i):
+        Type, parent, key, dtype, shape, offset, size=entries[i]
+        if Type==DICT:
+            return dict((entries[c][2], decode(c)) for c in children[i] if entries[c][0]!=NONE)
+        elif Type==LIST:
+            return [decode(c) for c in children[i]]
+        elif Type==BOOL:
+            return buf[offset:offset+1]!=b"\0"
+        elif Type==INT:
+            return struct.unpack_from("<q", buf, offset)[0]
+        elif Type==REAL:
+            return struct.unpack_from("<d", buf, offset)[0]
+        elif Type==COMPLEX:
+            return complex(*struct.unpack_from("<dd", buf, offset))
+        elif Type==STRING:
+            return bytes(buf[offset:offset+size]).decode("utf-8")
+        elif Type==ARRAY:
+            dt=np.dtype(str(dtype))
+            if size==0 and paths[i] in arrays:
+                return np.frombuffer(arrays[paths[i]], dtype=dt).reshape(shape)
+            return np.frombuffer(buf, dtype=dt, count=size//dt.itemsize, offset=offset).reshape(shape)
+        elif Type==NONE:
+            return None
+        raise CheckpointError("Unknown type {0} of {1}".format(Type, key))
+
+    return decode(0)
+
+def dump(root, filename):
+    if filename[-5:]!=SUFFIX:
+        filename+=SUFFIX
+    entries=[]
+    payloads=[]
+    end=[HEADER_SIZE]
+
+    def add(Type, parent, key, payload=b"", dtype="", shape=(), align=8):
+        offset=0
+        if len(payload)>0:
+            offset=_AlignUp(end[0], align)
+            end[0]=offset+len(payload)
+        entries.append((Type, parent, key.encode("utf-8"), dtype.encode("ascii"), shape, offset, len(payload)))
+        payloads.append(payload)
+        return len(entries)-1
+
+    def encode(value, parent, key):
+        if isinstance(value, dict):
+            self=add(DICT, parent, key)
+            for k in sorted(value.keys()):
+                encode(value[k], self, str(k))
+        elif isinstance(value, (list, tuple)):
+            self=add(LIST, parent, key)
+            for v in value:
+                encode(v, self, "")
+        elif isinstance(value, np.ndarray):
+            value=np.ascontiguousarray(value)
+            add(ARRAY, parent, key, value.tobytes(), value.dtype.str, value.shape, ALIGN)
+        elif isinstance(value, (bool, np.bool_)):
+            add(BOOL, parent, key, struct.pack("<B", bool(value)))
+        elif isinstance(value, (int, np.integer)) or type(value).__name__=="long":
+            add(INT, parent, key, struct.pack("<q", int(value)))
+        elif isinstance(value, (float, np.floating)):
+            add(REAL, parent, key, struct.pack("<d", float(value)))
+        elif isinstance(value, (complex, np.complexfloating)):
+            add(COMPLEX, parent, key, struct.pack("<dd", value.real, value.imag))
+        elif isinstance(value, (str, bytes)) or type(value).__name__=="unicode":
+            if not isinstance(value, bytes):
+                value=value.encode("utf-8")
+            add(STRING, parent, key, value)
+        elif value is None:
+            add(NONE, parent, key)
+        else:
+            raise CheckpointError("{0} can not be saved into a checkpoint: {1}".format(key, type(value)))
+
+    encode(root, -1, "")
+    index=b""
+    for Type, parent, key, dtype, shape, offset, size in entries:
+        index+=struct.pack(RECORD, Type, len(dtype), len(shape), len(key), parent, offset, size)
+        index+=struct.pack("<{0}Q".format(len(shape)), *shape)+dtype+key
+    indexoffset=_AlignUp(end[0], 8)
+    header=struct.pack(HEADER, MAGIC, VERSION, 0, len(entries), indexoffset, len(index), 0)
+
+    path, name=os.path.split(filename)
+    temp=os.path.join(path, "_"+name)
+    with open(temp, "wb") as f:
+        f.write(header.ljust(HEADER_SIZE, b"\0"))
+        for e, payload in zip(entries, payloads):
+            if e[6]>0:
+                f.write(b"\0"*(e[5]-f.tell()))
+                f.write(payload)
+        f.write(b"\0"*(indexoffset-f.tell()))
+        f.write(index)
+        f.flush()
+        os.fsync(f.fileno())
+    os.rename(temp, filename)
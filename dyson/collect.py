@@ -1,6 +1,6 @@
 #!/usr/bin/env python
 import numpy as np
-import os, sys, weight
+import os, sys, weight, subprocess
 from logger import *
 import parameter as para
 from scipy.interpolate import LSQUnivariateSpline
@@ -8,6 +8,8 @@ import traceback
 
 StatisFilePattern="_statis"
 AcceptRatio=0.75
+#native reducer built next to simulator.exe, it streams the statistics files with many threads
+ReducerExe="reduce_statis.exe"
 
 class CollectStatisFailure(Exception):
     def __init__(self, msg):
@@ -146,6 +148,8 @@ def GetFileList():
     FileList = [f for f in os.listdir(workspace) if os.path.isfile(os.path.join(workspace,f))]
     FileList = [f for f in FileList if f[0]!="_"]
     StatisFileList=[os.path.join(workspace, f) for f in FileList if f.find(StatisFilePattern) is not -1]
+    #a job may have both an old .hkl and a new .ckpt file, IO.LoadBigDict picks the newer format
+    StatisFileList=sorted(set(os.path.splitext(f)[0] for f in StatisFileList))
     return StatisFileList
 
 def CollectStatis(_map):
@@ -157,6 +161,16 @@ def CollectStatis(_map):
     if len(_FileList)==0:
         raise CollectStatisFailure("No statistics files to read!") 
     log.info("Collect statistics from {0}".format(_FileList))
+    Reducer=os.path.join(workspace, ReducerExe)
+    #the reducer only reads native checkpoints, which LoadBigDict prefers as well
+    if os.path.isfile(Reducer) and all(os.path.isfile(f+".ckpt") for f in _FileList):
+        Output=os.path.join(workspace, "_statis_total")
+        if subprocess.call([Reducer, "-o", Output, workspace])!=0:
+            raise CollectStatisFailure("{0} fails to collect statistics!".format(ReducerExe))
+        Dict=IO.LoadBigDict(Output)
+        SigmaSmoothT.MergeFromDict(Dict['Sigma']['Histogram'])
+        PolarSmoothT.MergeFromDict(Dict['Polar']['Histogram'])
+        return (SigmaSmoothT, PolarSmoothT)
     Total=len(_FileList)
     Success=0.0
     for f in _FileList:
@@ -51,6 +51,8 @@ def Measure(para, Observable,Factory, G0, W0, G, W, SigmaDeltaT, Sigma, Polar, D
     data={}
     data["Chi"]=Chi.ToDict()
     data["G"]=G.ToDict()
+    #bare G0 for the native Dyson job of simulator.exe, the bare W0 is the DeltaT part of W
+    data["G0"]=G0.ToDict()
     data["W"]=W.ToDict()
     data["W"].update(W0.ToDict())
     data["SigmaDeltaT"]=SigmaDeltaT.ToDict()
@@ -223,7 +225,7 @@ if __name__=="__main__":
     global StatisFile
     StatisFile=os.path.join(workspace, "statis_total")
 
-    IsNewCalculation=not os.path.exists(WeightFile+".hkl")
+    IsNewCalculation=not IO.HasBigDict(WeightFile)
     if not IsNewCalculation: 
         try:
             log.info(green("Try to load previous DYSHON_para file"))
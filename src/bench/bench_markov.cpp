@@ -0,0 +1,292 @@
+//
+//  bench_markov.cpp
+//  Feynman_Simulator
+//
+//  Created by Kun Chen on 3/4/15.
+//  Copyright (c) 2015 Kun Chen. All rights reserved.
+//
+
+/**
+*  Micro-benchmark of every Markov update in isolation. For each update, a diagram at the chosen order
+*  which passes the precondition of the update is sampled once, then the update is proposed again and again
+*  from that same diagram. Timing, acceptance and heap allocations are written out as JSON.
+*  The diagram is restored every RestoreInterval proposals, outside of the timing; the clock is read around
+*  each batch of RestoreInterval proposals and its cost is subtracted. -r 1 proposes every update from the
+*  sampled diagram itself, at the price of one pair of clock reads per call.
+*
+*  Usage: bench_markov.exe [-o Order] [-n Proposals] [-s Seed] [-r RestoreInterval] [-j OutputFile] [-g MT19937|Philox]
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include <cstring>
+#include "utility/pyglue/pywrapper.h"
+#include "utility/dictionary.h"
+#include "module/parameter/parameter.h"
+#include "module/weight/weight.h"
+#include "module/weight/component.h"
+#include "module/diagram/diagram.h"
+#include "module/markov/markov.h"
+
+using namespace std;
+
+/**********************   allocation counter  **************************/
+
+static atomic<long long> NAllocation(0);
+
+void* operator new(size_t size)
+{
+    NAllocation++;
+    void* p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr)
+        throw bad_alloc();
+    return p;
+}
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+void operator delete[](void* p) noexcept
+{
+    free(p);
+}
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+void operator delete[](void* p, size_t) noexcept
+{
+    free(p);
+}
+
+/**********************   updates  **************************/
+
+enum State {
+    NOWORM, //Order==target without worm
+    WORM, //Order==target with worm
+    MEASURE_G, //NOWORM and measuring on a G line
+    MEASURE_W, //NOWORM and measuring on a W line
+    ORDER1, //the initial diagram of order 1 without worm
+    ORDER0 //the initial diagram jumped to order 0
+};
+
+struct Update {
+    string Name; //the same as Markov::OperationName
+    void (mc::Markov::*Call)();
+    State Precondition;
+};
+
+const vector<Update> Updates = {
+    { "CREATE_WORM", &mc::Markov::CreateWorm, NOWORM },
+    { "DELETE_WORM", &mc::Markov::DeleteWorm, WORM },
+    { "MOVE_WORM_G", &mc::Markov::MoveWormOnG, WORM },
+    { "MOVE_WORM_W", &mc::Markov::MoveWormOnW, WORM },
+    { "RECONNECT", &mc::Markov::Reconnect, WORM },
+    { "ADD_INTERACTION", &mc::Markov::AddInteraction, WORM },
+    { "DEL_INTERACTION", &mc::Markov::DeleteInteraction, WORM },
+    { "ADD_DELTA_INTERACTION", &mc::Markov::AddDeltaInteraction, WORM },
+    { "DEL_DELTA_INTERACTION", &mc::Markov::DeleteDeltaInteraction, WORM },
+    { "CHANGE_TAU_VERTEX", &mc::Markov::ChangeTauOnVertex, NOWORM },
+    { "CHANGE_R_VERTEX", &mc::Markov::ChangeROnVertex, NOWORM },
+    { "CHANGE_R_LOOP", &mc::Markov::ChangeRLoop, NOWORM },
+    { "CHANGE_MEASURE_G2W", &mc::Markov::ChangeMeasureFromGToW, MEASURE_G },
+    { "CHANGE_MEASURE_W2G", &mc::Markov::ChangeMeasureFromWToG, MEASURE_W },
+    { "CHANGE_DELTA2CONTINUS", &mc::Markov::ChangeDeltaToContinuous, NOWORM },
+    { "CHANGE_CONTINUS2DELTA", &mc::Markov::ChangeContinuousToDelta, NOWORM },
+    { "CHANGE_SPIN_VERTEX", &mc::Markov::ChangeSpinOnVertex, NOWORM },
+    { "JUMP_TO_ORDER0", &mc::Markov::JumpToOrder0, ORDER1 },
+    { "JUMP_BACK_TO_ORDER1", &mc::Markov::JumpBackToOrder1, ORDER0 },
+};
+
+bool IsState(diag::Diagram& Diag, State state, int Order)
+{
+    bool NoWorm = !Diag.Worm.Exist;
+    switch (state) {
+    case NOWORM:
+        return Diag.Order == Order && NoWorm;
+    case WORM:
+        return Diag.Order == Order && !NoWorm;
+    case MEASURE_G:
+        return Diag.Order == Order && NoWorm && Diag.MeasureGLine;
+    case MEASURE_W:
+        return Diag.Order == Order && NoWorm && !Diag.MeasureGLine;
+    default:
+        return false;
+    }
+}
+
+struct Result {
+    string Name;
+    bool IsReachable;
+    long long Calls;
+    double Seconds;
+    real Proposed, Accepted;
+    long long Allocations;
+};
+
+string ToJSON(const vector<Result>& results, int Order, long long Proposals, int Seed, int RestoreInterval)
+{
+    ostringstream os;
+    os.precision(10);
+    os << "{\n  \"order\": " << Order << ",\n  \"proposals\": " << Proposals
+       << ",\n  \"seed\": " << Seed << ",\n  \"restore_interval\": " << RestoreInterval << ",\n  \"updates\": [";
+    for (uint i = 0; i < results.size(); i++) {
+        auto& r = results[i];
+        os << (i == 0 ? "\n" : ",\n") << "    {\"name\": \"" << r.Name << "\", \"reachable\": " << (r.IsReachable ? "true" : "false");
+        if (r.IsReachable) {
+            os << ", \"calls\": " << r.Calls
+               << ", \"ns_per_call\": " << r.Seconds * 1e9 / r.Calls
+               << ", \"proposed\": " << (long long)r.Proposed
+               << ", \"ns_per_proposal\": " << (r.Proposed > 0 ? r.Seconds * 1e9 / r.Proposed : 0.0)
+               << ", \"acceptance\": " << (r.Proposed > 0 ? r.Accepted / r.Proposed : 0.0)
+               << ", \"allocations_per_call\": " << double(r.Allocations) / r.Calls;
+        }
+        os << "}";
+    }
+    os << "\n  ]\n}\n";
+    return os.str();
+}
+
+vector<Result> Bench(int Order, long long Proposals, int Seed, int RestoreInterval, RNGEngine Engine);
+
+int main(int argc, const char* argv[])
+{
+    int Order = 2;
+    long long Proposals = 20000;
+    int Seed = 519180543;
+    int RestoreInterval = 16;
+    string OutputFile;
+    RNGEngine Engine = MT19937;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-o") == 0)
+            Order = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-n") == 0)
+            Proposals = atoll(argv[i + 1]);
+        else if (strcmp(argv[i], "-s") == 0)
+            Seed = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-r") == 0)
+            RestoreInterval = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-j") == 0)
+            OutputFile = argv[i + 1];
+        else if (strcmp(argv[i], "-g") == 0 && (strcmp(argv[i + 1], "MT19937") == 0 || strcmp(argv[i + 1], "Philox") == 0))
+            Engine = strcmp(argv[i + 1], "Philox") == 0 ? PHILOX : MT19937;
+        else
+            ABORT("Unknown argument " << argv[i]
+                                      << "\nUsage: bench_markov.exe [-o Order] [-n Proposals] [-s Seed] [-r RestoreInterval] [-j OutputFile] [-g MT19937|Philox]");
+    }
+    ASSERT_ALLWAYS(Order >= 1 && Order + 1 < MAX_ORDER, "Order should be in [1, MAX_ORDER-1)!");
+    ASSERT_ALLWAYS(RestoreInterval >= 1 && Proposals >= 1, "Proposals and RestoreInterval should be positive!");
+
+    Python::Initialize();
+    Python::ArrayInitialize();
+    LOGGER_CONF("bench_markov.log", "bench", Logger::file_on, INFO, INFO);
+    string json = ToJSON(Bench(Order, Proposals, Seed, RestoreInterval, Engine), Order, Proposals, Seed, RestoreInterval);
+    if (OutputFile.empty())
+        cout << json;
+    else
+        ofstream(OutputFile) << json;
+    Python::Finalize();
+    return 0;
+}
+
+/**
+*  seconds of reading the clock before and after a batch, it is subtracted from every batch;
+*  with a small RestoreInterval it is of the same order as the cheap updates
+*/
+double ClockOverhead()
+{
+    const int N = 1000000;
+    double total = 0.0;
+    for (int i = 0; i < N; i++) {
+        auto start = chrono::steady_clock::now();
+        auto end = chrono::steady_clock::now();
+        total += chrono::duration<double>(end - start).count();
+    }
+    return total / N;
+}
+
+//all python objects are gone when it returns, before Python::Finalize
+vector<Result> Bench(int Order, long long Proposals, int Seed, int RestoreInterval, RNGEngine Engine)
+{
+    para::ParaMC Para;
+    Para.SetTest();
+    //one more order, so that AddInteraction can be proposed at Order
+    Para.Order = Order + 1;
+    Para.OrderReWeight.assign(Para.Order + 1, 1.0);
+    Para.OrderTimeRatio.assign(Para.Order + 1, 1.0);
+    Para.Seed = Seed;
+    if (Engine == PHILOX)
+        Para.RNG.Reset((unsigned int)Seed, 0);
+    else
+        Para.RNG.Reset(Seed);
+    //with the test weights order 0 is nearly absorbing, keep the chain away from it
+    Para.OrderReWeight[0] = 1e-8;
+    weight::Weight Weight(true);
+    Weight.SetTest(Para);
+    diag::Diagram Diag;
+    Diag.SetTest(Para.Lat, *Weight.G, *Weight.W);
+    Dictionary Initial = Diag.ToDict();
+    mc::Markov Markov;
+    Markov.BuildNew(Para, Diag, Weight);
+
+    double Overhead = ClockOverhead();
+    vector<Result> results;
+    for (auto& update : Updates) {
+        Result r{ update.Name, false, 0, 0.0, 0.0, 0.0, 0 };
+        int op = Markov.UpdateIndex(update.Name);
+        ASSERT_ALLWAYS(op >= 0, "Unknown update " << update.Name);
+
+        //sample a diagram in the precondition of the update, the sampling is not timed
+        const long long MaxHop = 10000000;
+        bool IsJump = (update.Precondition == ORDER1 || update.Precondition == ORDER0);
+        for (long long i = 0; i < MaxHop && !IsJump && !IsState(Diag, update.Precondition, Order); i++)
+            Markov.Hop(1);
+        r.IsReachable = IsJump || IsState(Diag, update.Precondition, Order);
+        if (!r.IsReachable) {
+            results.push_back(r);
+            continue;
+        }
+        Dictionary Snapshot = IsJump ? Initial : Diag.ToDict();
+        //what JumpToOrder0 does once it is accepted
+        auto Restore = [&]() {
+            Diag.FromDict(Snapshot, Para.Lat, *Weight.G, *Weight.W);
+            if (update.Precondition == ORDER0) {
+                Diag.Order = 0;
+                Diag.Weight = weight::Norm::Weight();
+            }
+        };
+        real Proposed = Markov.ProposedOf(op), Accepted = Markov.AcceptedOf(op);
+        long long NBatch = 0;
+        for (long long done = 0; done < Proposals; done += RestoreInterval) {
+            Restore();
+            long long n = min<long long>(RestoreInterval, Proposals - done);
+            long long alloc = NAllocation;
+            auto start = chrono::steady_clock::now();
+            for (long long i = 0; i < n; i++)
+                (Markov.*update.Call)();
+            auto end = chrono::steady_clock::now();
+            r.Allocations += NAllocation - alloc;
+            r.Seconds += chrono::duration<double>(end - start).count();
+            r.Calls += n;
+            NBatch++;
+        }
+        r.Seconds = max(0.0, r.Seconds - NBatch * Overhead);
+        r.Proposed = Markov.ProposedOf(op) - Proposed;
+        r.Accepted = Markov.AcceptedOf(op) - Accepted;
+        //the next update starts sampling from a normal diagram again
+        Diag.FromDict(Initial, Para.Lat, *Weight.G, *Weight.W);
+        results.push_back(r);
+    }
+    return results;
+}
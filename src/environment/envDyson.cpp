@@ -0,0 +1,123 @@
+//
+//  envDyson.cpp
+//  Feynman_Simulator
+//
+//  Created by Kun Chen on 3/5/15.
+//  Copyright (c) 2015 Kun Chen. All rights reserved.
+//
+
+#include "environment.h"
+#include "utility/dictionary.h"
+
+using namespace std;
+using namespace para;
+
+const string ParaKey = "Para";
+
+EnvDyson::EnvDyson(const para::Job& job)
+    : Job(job)
+{
+}
+
+void EnvDyson::_Allocate()
+{
+    Calculator = dyson::Calculator(Para.NThread);
+    G0.Allocate(weight::SMOOTH, Para, SPIN, weight::TauAntiSymmetric);
+    G.Allocate(weight::SMOOTH, Para, SPIN, weight::TauAntiSymmetric);
+    W0.Allocate(weight::DELTA, Para, SPIN2, weight::TauSymmetric);
+    W.Allocate(weight::SMOOTH, Para, SPIN2, weight::TauSymmetric);
+    SigmaDeltaT.Allocate(weight::DELTA, Para, SPIN, weight::TauAntiSymmetric);
+    Sigma.Allocate(weight::SMOOTH, Para, SPIN, weight::TauAntiSymmetric);
+    Polar.Allocate(weight::SMOOTH, Para, SPIN2, weight::TauSymmetric);
+    ChiTensor.Allocate(weight::SMOOTH, Para, SPIN2, weight::TauSymmetric);
+    Chi.Allocate(weight::SMOOTH, Para, 1, weight::TauSymmetric);
+}
+
+/**
+*  the bare G0 is written by dyson/main.py as "G0", the bare W0 is the DeltaT part of "W"
+*/
+void EnvDyson::_ReadBare(Dictionary& weight_)
+{
+    weight_.BigLoad(Job.WeightFile);
+    G0.FromDict(weight_.Get<Dictionary>("G0"));
+    W0.FromDict(weight_.Get<Dictionary>("W"));
+}
+
+bool EnvDyson::BuildNew()
+{
+    LOGGER_CONF(Job.LogFile, Job.Type, Logger::file_on | Logger::screen_on, INFO, INFO);
+    Dictionary para_;
+    para_.Load(Job.InputFile);
+    Para.FromDict(para_.Get<Dictionary>(ParaKey));
+    _Allocate();
+    Dictionary weight_;
+    _ReadBare(weight_);
+    LOG_INFO("Start from bare G, W");
+    G.Copy(G0);
+    return true;
+}
+
+bool EnvDyson::Load()
+{
+    LOGGER_CONF(Job.LogFile, Job.Type, Logger::file_on | Logger::screen_on, INFO, INFO);
+    Dictionary para_;
+    LOG_INFO("Trying to load " << Job.ParaFile);
+    try {
+        para_.Load(Job.ParaFile);
+    }
+    catch (IOInvalid e) {
+        LOG_WARNING("Load " << Job.ParaFile << " failed, use " << Job.InputFile << " instead!");
+        para_.Load(Job.InputFile);
+    }
+    Para.FromDict(para_.Get<Dictionary>(ParaKey));
+    _Allocate();
+    Dictionary weight_;
+    _ReadBare(weight_);
+    LOG_INFO("Load G, W from " << Job.WeightFile);
+    G.FromDict(weight_.Get<Dictionary>("G"));
+    W.FromDict(weight_.Get<Dictionary>("W"));
+    SigmaDeltaT.FromDict(weight_.Get<Dictionary>("SigmaDeltaT"));
+    Sigma.FromDict(weight_.Get<Dictionary>("Sigma"));
+    Polar.FromDict(weight_.Get<Dictionary>("Polar"));
+    return true;
+}
+
+void EnvDyson::Iterate()
+{
+    Para.Version++;
+    LOG_INFO("Start Version " << Para.Version << "...");
+    Calculator.SigmaDeltaT_FirstOrder(G, W0, SigmaDeltaT);
+    Calculator.SigmaSmoothT_FirstOrder(G, W, Sigma);
+    Calculator.G_Dyson(G0, SigmaDeltaT, Sigma, G);
+    Calculator.Polar_FirstOrder(G, Polar);
+    Determ = Calculator.W_Dyson(W0, Polar, W, ChiTensor);
+    Calculator.Add_ChiTensor_ZerothOrder(ChiTensor, G);
+    Calculator.Calculate_Chi(ChiTensor, Chi);
+    LOG_INFO("Version " << Para.Version << " is done!");
+}
+
+void EnvDyson::Save()
+{
+    LOG_INFO("Save weights into " << Job.WeightFile);
+    for (auto f : { &G0, &W0, &G, &W, &SigmaDeltaT, &Sigma, &Polar, &Chi })
+        f->FFT("RT", Calculator.NThread);
+    Dictionary weight_;
+    weight_["G0"] = G0.ToDict();
+    weight_["G"] = G.ToDict();
+    Dictionary W_ = W.ToDict();
+    W_.Update(W0.ToDict());
+    weight_["W"] = W_;
+    weight_["SigmaDeltaT"] = SigmaDeltaT.ToDict();
+    weight_["Sigma"] = Sigma.ToDict();
+    weight_["Polar"] = Polar.ToDict();
+    weight_["Chi"] = Chi.ToDict();
+    weight_.BigSave(Job.WeightFile);
+
+    Dictionary para_;
+    para_[ParaKey] = Para.ToDict();
+    para_.Save(Job.ParaFile, "w");
+    //tell the Monte Carlo jobs to reload G and W
+    Message Message_ = Para.GenerateMessage();
+    Message_.SqueezeFactor = 1.0;
+    Message_.Save(Job.MessageFile);
+}
@@ -22,6 +22,23 @@ EnvMonteCarlo::EnvMonteCarlo(const para::Job& job, bool IsAllTauSymmetric)
     : Job(job)
     , Weight(IsAllTauSymmetric)
 {
+    _Generation = 0;
+    _Running = 0;
+    _Steps = 0;
+    _DoesMeasure = true;
+    _Quit = false;
+}
+
+EnvMonteCarlo::~EnvMonteCarlo()
+{
+    {
+        unique_lock<mutex> lock(_Mutex);
+        _Done.wait(lock, [this] { return _Running == 0; });
+        _Quit = true;
+    }
+    _Start.notify_all();
+    for (auto& t : _Threads)
+        t.join();
 }
 
 bool EnvMonteCarlo::BuildNew()
@@ -33,9 +50,10 @@ bool EnvMonteCarlo::BuildNew()
     Para.FromDict(para_.Get<Dictionary>(ParaKey));
 
     //Load GW weight from a global file shared by other MC processes
+    CheckpointReader reader;
     Dictionary GW_;
-    GW_.BigLoad(Job.WeightFile);
-    Weight.FromDict(GW_, weight::GW, Para);
+    _ReadGW(reader, GW_);
+    _AssignGW(reader, GW_);
 
     //    Weight.SetDiagCounter(Para);//Test for DiagCounter
     //    Weight.SetTest(Para);//Test for WeightTest
@@ -46,6 +64,7 @@ bool EnvMonteCarlo::BuildNew()
     MarkovMonitor.BuildNew(Para, Diag, Weight);
     para_[ConfigKey] = Diag.ToDict();
     para_.Save(Job.ParaFile, "w");
+    _BuildWalkers();
     return true;
 }
 /**
@@ -74,27 +93,78 @@ bool EnvMonteCarlo::Load()
     Weight.FromDict(statis_, weight::GW, Para);
     Weight.FromDict(statis_, weight::SigmaPolar, Para);
     LOG_INFO(DoesParaFileExit);
-    if (DoesParaFileExit)
+    //the config saved together with the statistics is consistent with them
+    if (statis_.HasKey(ConfigKey))
+        Diag.FromDict(statis_.Get<Dictionary>(ConfigKey), Para.Lat, *Weight.G, *Weight.W);
+    else if (DoesParaFileExit)
         Diag.FromDict(para_.Get<Dictionary>(ConfigKey), Para.Lat, *Weight.G, *Weight.W);
     else
         Diag.BuildNew(Para.Lat, *Weight.G, *Weight.W);
     MarkovMonitor.FromDict(statis_, Para, Diag, Weight);
     Markov.BuildNew(Para, Diag, Weight);
+    _BuildWalkers();
     return true;
 }
 
-void EnvMonteCarlo::Save()
+void EnvMonteCarlo::Save(bool DoesWait)
 {
     LOG_INFO("Start saving data...");
+    _ReduceWalkers();
     Dictionary para_;
     para_[ParaKey] = Para.ToDict();
     para_[ConfigKey] = Diag.ToDict();
     para_["PID"] = Job.PID;
     para_.Save(Job.ParaFile, "w");
+    //the flags are taken before the snapshot, so a block changed in between is flagged again for the next save
+    DirtyMap Dirty;
+    if (Job.DoesSaveDelta)
+        Dirty = Weight.TakeDirty(weight::GW | weight::SigmaPolar);
     Dictionary statis_ = Weight.ToDict(weight::GW | weight::SigmaPolar);
     statis_.Update(MarkovMonitor.ToDict());
-    statis_.BigSave(Job.StatisticsFile);
-    LOG_INFO("Saving data is done!");
+    statis_[ConfigKey] = para_[ConfigKey];
+    //a save which waits, like the last one of the job, compacts the delta log into the checkpoint
+    if (Job.DoesSaveDelta)
+        _StatisticsWriter.Submit(statis_, Job.StatisticsFile, Dirty, DoesWait);
+    else
+        _StatisticsWriter.Submit(statis_, Job.StatisticsFile);
+    if (DoesWait) {
+        _StatisticsWriter.Wait();
+        LOG_INFO("Saving data is done!");
+    }
+    else
+        LOG_INFO("Statistics are snapshotted, writing in background...");
+}
+
+bool EnvMonteCarlo::IsSaving()
+{
+    return _StatisticsWriter.IsBusy();
+}
+
+/**
+*  Read the weight file shared by all MC processes. With Job.DoesMapWeight, a native checkpoint
+*  is only mapped into reader, otherwise the whole file is loaded into GW_
+*/
+void EnvMonteCarlo::_ReadGW(CheckpointReader& reader, Dictionary& GW_)
+{
+    if (Job.DoesMapWeight && IsCheckpoint(Job.WeightFile))
+        reader.Open(Job.WeightFile);
+    else
+        GW_.BigLoad(Job.WeightFile);
+}
+
+/**
+*  A mapped G/W uses the pages of the weight file in place, so they are shared by all processes on
+*  the same node; if the file does not match Para, G/W are copied as usual
+*/
+void EnvMonteCarlo::_AssignGW(CheckpointReader& reader, Dictionary& GW_)
+{
+    if (reader.IsOpen()) {
+        if (Weight.MapGW(reader, Para))
+            return;
+        LOG_WARNING("G/W in " << Job.WeightFile << " can not be mapped, copy them instead!");
+        GW_ = reader.ToDict();
+    }
+    Weight.FromDict(GW_, weight::GW, Para);
 }
 
 void EnvMonteCarlo::DeleteSavedFiles()
@@ -104,11 +174,20 @@ void EnvMonteCarlo::DeleteSavedFiles()
     system(("rm " + Job.WeightFile).c_str());
 }
 
+void EnvMonteCarlo::FreezeProbofCall()
+{
+    Markov.FreezeProbofCall();
+    for (auto& walker : _Walkers)
+        walker->Markov.CopyProbofCall(Markov);
+}
+
 void EnvMonteCarlo::AdjustOrderReWeight()
 {
     LOG_INFO("Start adjusting OrderReweight...");
     if (MarkovMonitor.AdjustOrderReWeight()) {
         Markov.Reset(Para, Diag, Weight);
+        for (auto& walker : _Walkers)
+            walker->Reset(Para, Weight);
         string str;
         for (int i = 0; i <= Para.Order; i++)
             str += ToString((Para.OrderReWeight[i])) + "  ";
@@ -135,21 +214,27 @@ bool EnvMonteCarlo::ListenToMessage()
         LOG_INFO("Status has not been updated yet since the last annealing!");
         return false;
     }
+    CheckpointReader reader;
     Dictionary weight_;
     try {
-        weight_.BigLoad(Job.WeightFile);
+        _ReadGW(reader, weight_);
     }
     catch (IOInvalid e) {
         LOG_WARNING("Annealing Failed!");
         return false;
     }
+    _ReduceWalkers();
     Para.UpdateWithMessage(Message_);
-    Weight.FromDict(weight_, weight::GW, Para);
+    //a mapped G/W is remapped to the new version of the weight file, the old mapping is released
+    _AssignGW(reader, weight_);
     Weight.Anneal(Para);
     Diag.Reset(Para.Lat, *Weight.G, *Weight.W);
     Markov.Reset(Para, Diag, Weight);
     MarkovMonitor.Reset(Para, Diag, Weight);
     MarkovMonitor.SqueezeStatistics(Message_.SqueezeFactor);
+    //G/W have been reallocated, walkers have to borrow them again
+    for (auto& walker : _Walkers)
+        walker->Anneal(Para, Weight);
     LOG_INFO("Annealled to " << Message_.PrettyString()
                              << "\nwith squeeze factor" << Message_.SqueezeFactor);
     return true;
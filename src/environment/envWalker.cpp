@@ -0,0 +1,177 @@
+//
+//  envWalker.cpp
+//  Feynman_Simulator
+//
+//  Created by Kun Chen on 3/2/15.
+//  Copyright (c) 2015 Kun Chen. All rights reserved.
+//
+
+#include "environment.h"
+#include "module/weight/component.h"
+
+using namespace std;
+using namespace para;
+
+/**
+*  Build a new walker from the parameters of the master, the walker starts from a new diagram
+*
+*  @param para   parameters of the master, Counter and RNG will be replaced
+*  @param master the master Weight whose G/W are shared
+*  @param RNG    generator of this walker, spawned from the one of the master
+*  @param DoesShareSigmaPolar measure into Sigma/Polar of the master, their Accumulation has to be SHARDED or ATOMIC
+*/
+EnvWalker::EnvWalker(const ParaMC& para, weight::Weight& master, const RandomFactory& RNG, bool doessharesigmapolar)
+    : DoesShareSigmaPolar(doessharesigmapolar)
+    , Para(para)
+    , Weight(master._IsAllSymmetric)
+{
+    Para.Counter = 0;
+    Para.RNG = RNG;
+    Weight.ShareGW(master);
+    if (DoesShareSigmaPolar)
+        Weight.ShareSigmaPolar(master);
+    else
+        Weight.BuildNew(weight::SigmaPolar, Para);
+    Diag.BuildNew(Para.Lat, *Weight.G, *Weight.W);
+    Markov.BuildNew(Para, Diag, Weight);
+    MarkovMonitor.BuildNew(Para, Diag, Weight);
+}
+
+void EnvWalker::Run(int Steps, bool DoesMeasure)
+{
+    for (int i = 0; i < Steps; i++) {
+        Markov.Hop(Para.Sweep);
+        if (DoesMeasure)
+            MarkovMonitor.Measure();
+    }
+}
+
+/**
+*  Follow the master after reweighting; the walker keeps its own Counter, RNG stream and Sigma/Polar accumulators
+*/
+void EnvWalker::Reset(const ParaMC& para, weight::Weight& master)
+{
+    long long Counter = Para.Counter;
+    int Seed = Para.Seed;
+    RandomFactory RNG = Para.RNG;
+    Para = para;
+    Para.Counter = Counter;
+    Para.Seed = Seed;
+    Para.RNG = RNG;
+    Weight.ShareGW(master);
+    if (DoesShareSigmaPolar)
+        Weight.ShareSigmaPolar(master);
+    Diag.Reset(Para.Lat, *Weight.G, *Weight.W);
+    Markov.Reset(Para, Diag, Weight);
+    MarkovMonitor.Reset(Para, Diag, Weight);
+}
+
+/**
+*  Follow the master after annealing, the accumulators of the walker have to be reduced into the master first
+*/
+void EnvWalker::Anneal(const ParaMC& para, weight::Weight& master)
+{
+    Reset(para, master);
+    Weight.Anneal(Para);
+}
+
+void EnvMonteCarlo::_BuildWalkers()
+{
+    bool DoesBatch = Job.Accumulation == "Batched";
+    bool DoesShare = Job.NWalker > 1 && Job.Accumulation != "Private" && !DoesBatch;
+    //walkers merge into the master, only its estimators have to flag the changed blocks
+    Weight.TrackDirty(Job.DoesSaveDelta);
+    if (DoesBatch) {
+        Weight.Sigma->Estimator.SetAccumulation(weight::BATCHED);
+        Weight.Polar->Estimator.SetAccumulation(weight::BATCHED);
+    }
+    if (DoesShare) {
+        auto mode = Job.Accumulation == "Sharded" ? weight::SHARDED : weight::ATOMIC;
+        Weight.Sigma->Estimator.SetAccumulation(mode);
+        Weight.Polar->Estimator.SetAccumulation(mode);
+    }
+    for (int i = 1; i < Job.NWalker; i++) {
+        //walker streams are drawn from the master stream, so a reloaded job does not repeat them
+        _Walkers.push_back(unique_ptr<EnvWalker>(new EnvWalker(Para, Weight, Para.RNG.Spawn(), DoesShare)));
+        if (DoesBatch) {
+            _Walkers.back()->Weight.Sigma->Estimator.SetAccumulation(weight::BATCHED);
+            _Walkers.back()->Weight.Polar->Estimator.SetAccumulation(weight::BATCHED);
+        }
+        _Threads.push_back(thread(&EnvMonteCarlo::_WalkerLoop, this, _Walkers.back().get()));
+    }
+    if (Job.NWalker > 1)
+        LOG_INFO(Job.NWalker << " walkers are sharing G/W, with " << Job.Accumulation << " Sigma/Polar accumulation!");
+}
+
+/**
+*  Merge the Sigma/Polar accumulators of all walkers into the master, walkers start from empty accumulators again
+*/
+void EnvMonteCarlo::_ReduceWalkers()
+{
+    for (auto& walker : _Walkers) {
+        if (walker->DoesShareSigmaPolar)
+            continue;
+        Weight.Sigma->Estimator.Merge(walker->Weight.Sigma->Estimator);
+        Weight.Polar->Estimator.Merge(walker->Weight.Polar->Estimator);
+    }
+}
+
+void EnvMonteCarlo::_WalkerLoop(EnvWalker* walker)
+{
+    int Generation = 0;
+    while (true) {
+        int Steps;
+        bool DoesMeasure;
+        {
+            unique_lock<mutex> lock(_Mutex);
+            _Start.wait(lock, [&] { return _Quit || _Generation != Generation; });
+            if (_Quit)
+                return;
+            Generation = _Generation;
+            Steps = _Steps;
+            DoesMeasure = _DoesMeasure;
+        }
+        exception_ptr Error;
+        try {
+            walker->Run(Steps, DoesMeasure);
+        }
+        catch (...) {
+            Error = current_exception();
+        }
+        lock_guard<mutex> lock(_Mutex);
+        if (Error)
+            _Error = Error;
+        if (--_Running == 0)
+            _Done.notify_all();
+    }
+}
+
+/**
+*  Let all walkers hop for Steps blocks of Para.Sweep in background threads, returns immediately
+*/
+void EnvMonteCarlo::RunWalkers(int Steps, bool DoesMeasure)
+{
+    if (_Walkers.empty())
+        return;
+    lock_guard<mutex> lock(_Mutex);
+    ASSERT_ALLWAYS(_Running == 0, "Walkers are still running!");
+    _Steps = Steps;
+    _DoesMeasure = DoesMeasure;
+    _Running = _Walkers.size();
+    _Generation++;
+    _Start.notify_all();
+}
+
+/**
+*  Block until all walkers finish their steps, an exception from a walker is rethrown here
+*/
+void EnvMonteCarlo::WaitWalkers()
+{
+    unique_lock<mutex> lock(_Mutex);
+    _Done.wait(lock, [this] { return _Running == 0; });
+    if (_Error) {
+        exception_ptr Error = _Error;
+        _Error = nullptr;
+        rethrow_exception(Error);
+    }
+}
@@ -14,11 +14,41 @@
 #include "module/weight/weight.h"
 #include "module/markov/markov_monitor.h"
 #include "module/markov/markov.h"
+#include "module/dyson/dyson.h"
 #include "job/job.h"
+#include "utility/checkpoint.h"
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+/**
+*  \brief an extra Markov chain of a multi-walker job. It has its own Diagram, RNG stream and
+*  Sigma/Polar accumulators, while G/W are borrowed read-only from the master EnvMonteCarlo.
+*  If DoesShareSigmaPolar, the walker measures into the Sigma/Polar of the master instead
+*/
+class EnvWalker {
+public:
+    EnvWalker(const para::ParaMC&, weight::Weight&, const RandomFactory& RNG, bool DoesShareSigmaPolar = false);
+
+    bool DoesShareSigmaPolar;
+    para::ParaMC Para;
+    weight::Weight Weight;
+    diag::Diagram Diag;
+    mc::Markov Markov;
+    mc::MarkovMonitor MarkovMonitor;
+
+    void Run(int Steps, bool DoesMeasure);
+    void Reset(const para::ParaMC&, weight::Weight&);
+    void Anneal(const para::ParaMC&, weight::Weight&);
+};
 
 class EnvMonteCarlo {
 public:
     EnvMonteCarlo(const para::Job& job, bool IsAllTauSymmetric = false);
+    ~EnvMonteCarlo();
 
     //can be read from StateFile or InputFile
     para::Job Job;
@@ -30,14 +60,65 @@ public:
 
     bool BuildNew();
     bool Load();
-    void Save(); //Save everything in EnvMonteCarlo
+    //Save everything in EnvMonteCarlo; if !DoesWait, statistics are only snapshotted and written in the background
+    void Save(bool DoesWait = true);
+    bool IsSaving();
     void DeleteSavedFiles();
     void AdjustOrderReWeight();
+    //end the tuning of ProbofCall of the master, walkers follow the master
+    void FreezeProbofCall();
 
     bool ListenToMessage();
 
+    //walkers run in background threads between RunWalkers and WaitWalkers,
+    //everything else in EnvMonteCarlo should only be called while they are waiting
+    void RunWalkers(int Steps, bool DoesMeasure = true);
+    void WaitWalkers();
+
 private:
     std::string _DiagramFile;
+    AsyncCheckpointWriter _StatisticsWriter;
+
+    std::vector<std::unique_ptr<EnvWalker> > _Walkers;
+    std::vector<std::thread> _Threads;
+    std::mutex _Mutex;
+    std::condition_variable _Start, _Done;
+    int _Generation, _Running, _Steps;
+    bool _DoesMeasure, _Quit;
+    std::exception_ptr _Error;
+    void _ReadGW(CheckpointReader&, Dictionary&);
+    void _AssignGW(CheckpointReader&, Dictionary&);
+    void _BuildWalkers();
+    void _ReduceWalkers();
+    void _WalkerLoop(EnvWalker*);
+};
+
+/**
+*  \brief the self-consistent loop of dyson/main.py without Monte Carlo statistics, Sigma and Polar are
+*  the first order diagrams. The bare G0 and W0 are read from the weight file, "G0"/"SmoothT" and "W"/"DeltaT",
+*  and the results are written back to it for the Monte Carlo jobs
+*/
+class EnvDyson {
+public:
+    EnvDyson(const para::Job& job);
+
+    para::Job Job;
+    para::ParaDyson Para;
+    dyson::Calculator Calculator;
+    dyson::Field G0, W0, G, W, SigmaDeltaT, Sigma, Polar, ChiTensor, Chi;
+    Complex Determ;
+
+    //start from G=G0 and W=0
+    bool BuildNew();
+    //continue from G, W, SigmaDeltaT, Sigma and Polar of the weight file
+    bool Load();
+    //one iteration, throw ValueInvalid if a denominator touches zero
+    void Iterate();
+    void Save();
+
+private:
+    void _Allocate();
+    void _ReadBare(Dictionary&);
 };
 
 int TestEnvironment();
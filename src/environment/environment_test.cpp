@@ -0,0 +1,91 @@
+//
+//  environment_test.cpp
+//  Feynman_Simulator
+//
+//  Created by Kun Chen on 3/2/15.
+//  Copyright (c) 2015 Kun Chen. All rights reserved.
+//
+
+#include "environment.h"
+#include "utility/sput.h"
+#include "utility/dictionary.h"
+#include "module/weight/component.h"
+
+using namespace std;
+
+void Test_Walkers();
+void Test_WalkerReweight();
+
+int TestEnvironment()
+{
+    sput_start_testing();
+    sput_enter_suite("Test Walkers:");
+    sput_run_test(Test_Walkers);
+    sput_run_test(Test_WalkerReweight);
+    sput_finish_testing();
+    return sput_get_return_value();
+}
+
+real SigmaNormAccu(weight::Weight& weight)
+{
+    return weight.Sigma->Estimator.ToDict().Get<real>("NormAccu");
+}
+
+void Test_Walkers()
+{
+    para::ParaMC Para;
+    Para.SetTest();
+    Para.Sweep = 10;
+    weight::Weight Weight(true);
+    Weight.SetTest(Para);
+
+    EnvWalker Walker1(Para, Weight, 1), Walker2(Para, Weight, 2);
+    sput_fail_unless(Walker1.Weight.G == Weight.G && Walker2.Weight.W == Weight.W, "Walkers share G/W with the master");
+    sput_fail_if(Walker1.Weight.Sigma == Weight.Sigma, "Walkers have their own Sigma");
+
+    thread t1(&EnvWalker::Run, &Walker1, 1000, true);
+    thread t2(&EnvWalker::Run, &Walker2, 1000, true);
+    t1.join();
+    t2.join();
+    sput_fail_unless(Walker1.Diag.CheckDiagram() && Walker2.Diag.CheckDiagram(), "Check diagrams of walkers");
+
+    //the same stream gives the same chain, no matter it runs in a thread or not
+    EnvWalker Walker3(Para, Weight, 1);
+    Walker3.Run(1000, true);
+    sput_fail_unless(Walker3.Para.Counter == Walker1.Para.Counter && Equal(Walker3.Diag.Weight, Walker1.Diag.Weight), "Walkers in threads are independent");
+
+    real Total = SigmaNormAccu(Weight) + SigmaNormAccu(Walker1.Weight) + SigmaNormAccu(Walker2.Weight);
+    Weight.Sigma->Estimator.Merge(Walker1.Weight.Sigma->Estimator);
+    Weight.Sigma->Estimator.Merge(Walker2.Weight.Sigma->Estimator);
+    sput_fail_unless(Equal(SigmaNormAccu(Weight), Total), "Reduce accumulators of walkers");
+    sput_fail_unless(Equal(SigmaNormAccu(Walker1.Weight), 0.0), "Walker accumulators are cleared after reduction");
+}
+
+void Test_WalkerReweight()
+{
+    para::ParaMC Para;
+    Para.SetTest();
+    Para.Sweep = 10;
+    weight::Weight Weight(true);
+    Weight.SetTest(Para);
+
+    EnvWalker Walker(Para, Weight, 1);
+    Walker.Run(1000, true);
+    Walker.Weight.Sigma->Estimator.MeasureNorm(1.0);
+    real NormAccu = SigmaNormAccu(Walker.Weight);
+
+    //a reweight after Beta has been changed must not rescale the accumulators of the walker
+    Para.Beta *= 1.5;
+    Para.OrderReWeight[1] *= 2.0;
+    Walker.Reset(Para, Weight);
+    sput_fail_unless(Equal(SigmaNormAccu(Walker.Weight), NormAccu), "Reweight keeps accumulators of walkers");
+    Walker.Reset(Para, Weight);
+    sput_fail_unless(Equal(SigmaNormAccu(Walker.Weight), NormAccu), "Repeated reweight keeps accumulators of walkers");
+    sput_fail_unless(Equal(Walker.Para.OrderReWeight[1], Para.OrderReWeight[1]), "Walker follows the new reweight");
+    sput_fail_unless(Walker.Diag.CheckDiagram(), "Check diagram of walker after reweight");
+
+    //annealing happens only after the accumulators are reduced into the master
+    Weight.Sigma->Estimator.Merge(Walker.Weight.Sigma->Estimator);
+    Walker.Anneal(Para, Weight);
+    sput_fail_unless(Equal(SigmaNormAccu(Walker.Weight), 0.0), "Anneal a reduced walker");
+}
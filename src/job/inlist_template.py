@@ -13,7 +13,13 @@ MonteCarlo={
     "__AutoRun" : True,
     "__KeepCPUBusy": True,
     },
-"Job": {"DoesLoad" : False}
+"Job": {"DoesLoad" : False,
+        "NWalker" : 1, #number of Markov chains sharing G/W in one process
+        "Accumulation" : "Private", #or "Sharded"/"Atomic" to share Sigma/Polar between walkers, "Batched" for private ones with buffered measurement
+        "DoesMapWeight" : False, #use G/W of the weight checkpoint in place, shared by all processes on a node
+        "DoesTuneUpdate" : False, #adapt the probabilities of updates to their cost and acceptance during the toss
+        "DoesSaveDelta" : False #append the changed blocks of Sigma/Polar to a delta log, compacted at the end of the job
+        }
 }
 
 Dyson={
@@ -53,6 +59,7 @@ Common={
     "Sample" : 50000000,
     "Sweep" : 10,
     "Toss" : 1000,
+    "RNGEngine" : "MT19937", #or "Philox" for counter-based streams of the same Seed in all walkers
     "WormSpaceReweight" : 0.05
     },
 "Dyson": {
@@ -26,6 +26,14 @@ para::Job::Job(string inputfile)
     GET(_Para, Sample);
     GET(_Para, PID);
     GET(_Para, Sample);
+    GET_WITH_DEFAULT(_Para, NWalker, 1);
+    ASSERT_ALLWAYS(NWalker >= 1, "NWalker should be at least 1!");
+    GET_WITH_DEFAULT(_Para, Accumulation, string("Private"));
+    if (AccumulationName.find(Accumulation) == AccumulationName.end())
+        ABORT("I don't know what is Accumulation " << Accumulation << "?");
+    GET_WITH_DEFAULT(_Para, DoesMapWeight, false);
+    GET_WITH_DEFAULT(_Para, DoesTuneUpdate, false);
+    GET_WITH_DEFAULT(_Para, DoesSaveDelta, false);
     GET(_Para, WeightFile);
     GET(_Para, MessageFile);
     string Prefix = ToString(PID) + "_" + string(Type);
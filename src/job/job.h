@@ -17,15 +17,24 @@ namespace para {
 class Job {
 public:
     typedef std::string type;
-    std::set<std::string> TypeName = { "MC", "DiagCount" };
+    std::set<std::string> TypeName = { "MC", "DiagCount", "Dyson" };
+    std::set<std::string> AccumulationName = { "Private", "Sharded", "Atomic", "Batched" };
 
     Job(std::string inputfile);
     Job(type, bool, bool, int);
 
     type Type;
     bool DoesLoad;
-    int Sample;
+    int Sample; //number of iterations of a Dyson job
     int PID;
+    int NWalker; //number of Markov chains running in threads of the same process
+    //how walkers accumulate Sigma/Polar: "Private" for their own copies,
+    //"Sharded" or "Atomic" to measure into the master's copy concurrently,
+    //"Batched" for their own copies, which buffer the measurements and add them sorted by index
+    std::string Accumulation;
+    bool DoesMapWeight; //map G/W read-only from the weight checkpoint instead of copying them
+    bool DoesTuneUpdate; //adapt the probabilities of updates during the toss, then freeze them
+    bool DoesSaveDelta; //append the changed blocks of the statistics to a delta log instead of rewriting them
     std::string WeightFile;
     std::string MessageFile;
     std::string StatisticsFile;
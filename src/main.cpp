@@ -9,6 +9,7 @@
 /********************** include files *****************************************/
 #include <iostream>
 #include <unistd.h>
+#include <string.h>
 #include "test.h"
 #include "environment/environment.h"
 #include "utility/pyglue/pywrapper.h"
@@ -22,6 +23,7 @@ const string HelpStr = "Usage:"
                        "-p N / --PID N   use N to construct input file path."
                        "or -f / --file PATH   use PATH as the input file path.";
 void MonteCarlo(const Job&);
+void Dyson(const Job&);
 int main(int argc, const char* argv[])
 {
     Python::Initialize();
@@ -40,6 +42,8 @@ int main(int argc, const char* argv[])
 
     if (Job.Type == "MC")
         MonteCarlo(Job);
+    else if (Job.Type == "Dyson")
+        Dyson(Job);
     else
         cout << "Not Defined" << endl;
     Python::Finalize();
@@ -66,14 +70,27 @@ void MonteCarlo(const para::Job& Job)
     MessageTimer.start();
     ReweightTimer.start();
 
-    int sigma[MAX_ORDER] = { 0 };
-    int polar[MAX_ORDER] = { 0 };
+    vector<int> sigma(Para.Order + 1, 0);
+    vector<int> polar(Para.Order + 1, 0);
 
     Env.ListenToMessage();
 
+    //walkers of a multi-walker job hop in background threads, they only stop at every 100 steps of the master,
+    //where Save/ListenToMessage/AdjustOrderReWeight can touch them safely
+    Env.RunWalkers(Para.Toss, false);
     for (uint Step = 0; Step < Para.Toss; Step++) {
-        Markov.Hop(Para.Sweep);
+        if (!Job.DoesTuneUpdate) {
+            Markov.Hop(Para.Sweep);
+            continue;
+        }
+        Markov.Tune(Para.Sweep);
+        if ((Step + 1) % 100 == 0)
+            Markov.AdaptProbofCall();
     }
+    Env.WaitWalkers();
+    if (Job.DoesTuneUpdate)
+        Env.FreezeProbofCall();
+    Env.RunWalkers(100);
 
     //    for (uint i = 0; i < 1000; i++) {
     //        for (uint Step = 0; Step < Job.Sample; Step++) {
@@ -91,6 +108,7 @@ void MonteCarlo(const para::Job& Job)
         }
 
         if (Step % 100 == 0) {
+            Env.WaitWalkers();
             MarkovMonitor.AddStatistics();
 
             if (PrinterTimer.check(Para.PrinterTimer)) {
@@ -98,10 +116,13 @@ void MonteCarlo(const para::Job& Job)
                 Markov.PrintDetailBalanceInfo();
             }
 
+            //the statistics file is written in background, interrupts are delayed until it is complete
+            if (Interrupt.IsDelaying() && !Env.IsSaving())
+                Interrupt.Resume();
+
             if (DiskWriterTimer.check(Para.DiskWriterTimer)) {
                 Interrupt.Delay();
-                Env.Save();
-                Interrupt.Resume();
+                Env.Save(false);
             }
 
             if (MessageTimer.check(Para.MessageTimer))
@@ -109,7 +130,34 @@ void MonteCarlo(const para::Job& Job)
 
             if (ReweightTimer.check(Para.ReweightTimer))
                 Env.AdjustOrderReWeight();
+
+            Env.RunWalkers(100);
         }
     }
     LOG_INFO("Markov is ended!");
 }
+
+void Dyson(const para::Job& Job)
+{
+    InterruptHandler Interrupt;
+    EnvDyson Env(Job);
+    if (Job.DoesLoad)
+        Env.Load();
+    else
+        Env.BuildNew();
+
+    LOG_INFO("Dyson is started!");
+    for (int Step = 0; Step < Job.Sample; Step++) {
+        try {
+            Env.Iterate();
+        }
+        catch (ValueInvalid e) {
+            LOG_INFO("Version " << Env.Para.Version << " fails due to:\n" << e.what());
+            break;
+        }
+        Interrupt.Delay();
+        Env.Save();
+        Interrupt.Resume();
+    }
+    LOG_INFO("Dyson is ended!");
+}
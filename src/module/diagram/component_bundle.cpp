@@ -16,10 +16,6 @@ template <typename T>
 Bundle<T>::Bundle(string bundle_name)
 {
     _bundle_name = bundle_name;
-    for (int i = 0; i < MAX_BUNDLE; i++) {
-        _component_bundle[i].Name = i;
-        _component_name[i] = _component_bundle + i;
-    }
     _available_space = 0;
 }
 
@@ -32,8 +28,12 @@ string Bundle<T>::BundleName()
 template <typename T>
 T *Bundle<T>::Add()
 {
-    if (_available_space > MAX_BUNDLE)
+    if (_available_space >= MAX_BUNDLE)
         ABORT("Too many objects >=" << MAX_BUNDLE);
+    if (_available_space == Capacity()) {
+        _component_bundle.push_back(T());
+        _component_name.push_back(&_component_bundle.back());
+    }
     T *address = _component_name[_available_space];
 
     //need to be checked
@@ -49,6 +49,10 @@ void Bundle<T>::Add(T *Target)
 {
     if (_available_space >= MAX_BUNDLE)
         ABORT("Too many objects >=" << MAX_BUNDLE);
+    if (_available_space == Capacity()) {
+        _component_bundle.push_back(T());
+        _component_name.push_back(&_component_bundle.back());
+    }
     _component_name[_available_space] = Target;
     _available_space++;
 }
@@ -115,6 +119,13 @@ int Bundle<T>::HowMany()
     return _available_space;
 }
 
+//number of objects created so far
+template <typename T>
+int Bundle<T>::Capacity()
+{
+    return (int)_component_name.size();
+}
+
 template <typename T>
 void Bundle<T>::Recover(int step)
 {
@@ -125,7 +136,7 @@ void Bundle<T>::Recover(int step)
 template <typename T>
 bool Bundle<T>::Exist(T *target)
 {
-    if (target != nullptr && target->Name < _available_space && target >= _component_bundle && target < _component_bundle + MAX_BUNDLE)
+    if (target != nullptr && target->Name >= 0 && target->Name < _available_space && _component_name[target->Name] == target)
         return true;
     else
         return false;
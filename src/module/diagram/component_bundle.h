@@ -11,16 +11,22 @@
 
 #include "component.h"
 #include <string>
+#include <vector>
+#include <deque>
 
 class RandomFactory;
 namespace diag {
 
 const int MAX_BUNDLE = 2 * MAX_ORDER;
+/**
+*  Objects are created on demand, the bundle only grows as large as the highest order ever reached.
+*  They live in a deque, so pointers to them stay valid while it grows.
+*/
 template <typename T>
 class Bundle {
   private:
-    T *_component_name[MAX_BUNDLE];
-    T _component_bundle[MAX_BUNDLE];
+    std::vector<T *> _component_name;
+    std::deque<T> _component_bundle;
     std::string _bundle_name;
     int _available_space;
 
@@ -37,6 +43,7 @@ class Bundle {
     T &operator[](name);
     T *operator()(name);
     int HowMany();
+    int Capacity();
     T *RandomPick(RandomFactory &RNG);
     bool Exist(T *target);
 };
@@ -37,21 +37,21 @@ Diagram::Diagram()
 
 bool Diagram::GHashCheck(Momentum k)
 {
-    return (GHash[k.index()]);
+    return GHash.Test(k.index());
 }
 
 void Diagram::AddGHash(Momentum k)
 {
-    if (DEBUGMODE && GHash[k.index()])
+    if (DEBUGMODE && GHash.Test(k.index()))
         ABORT("add occupied G Hash!");
-    GHash[k.index()] = true;
+    GHash.Set(k.index());
 }
 
 void Diagram::RemoveGHash(Momentum k)
 {
-    if (DEBUGMODE && !(GHash[k.index()]))
+    if (DEBUGMODE && !GHash.Test(k.index()))
         ABORT("remove empty G Hash!");
-    GHash[k.index()] = false;
+    GHash.Reset(k.index());
 }
 
 void Diagram::ReplaceGHash(Momentum kold, Momentum k)
@@ -62,21 +62,27 @@ void Diagram::ReplaceGHash(Momentum kold, Momentum k)
 
 bool Diagram::WHashCheck(Momentum k)
 {
-    return (k == 0 || WHash[k.abs()]);
+    return (k == 0 || WHash.Test(k.abs()));
+}
+
+int Diagram::WFreeCount()
+{
+    //every occupied abs(k)>0 takes k and -k, k=0 is never free
+    return 2 * (MAX_K - WHash.Count() + WHash.Test(0));
 }
 
 void Diagram::AddWHash(Momentum k)
 {
-    if (DEBUGMODE && WHash[k.abs()])
+    if (DEBUGMODE && WHash.Test(k.abs()))
         ABORT("add occupied W Hash!");
-    WHash[k.abs()] = true;
+    WHash.Set(k.abs());
 }
 
 void Diagram::RemoveWHash(Momentum k)
 {
-    if (DEBUGMODE && !(WHash[k.abs()]))
+    if (DEBUGMODE && !WHash.Test(k.abs()))
         ABORT("remove empty W Hash!");
-    WHash[k.abs()] = false;
+    WHash.Reset(k.abs());
 }
 
 void Diagram::ReplaceWHash(Momentum kold, Momentum k)
@@ -95,12 +101,8 @@ void Diagram::Reset(Lattice& lat, weight::GClass& g, weight::WClass& w)
 
 void Diagram::ClearDiagram()
 {
-    for (int i = 0; i < 2 * MAX_K + 1; i++) {
-        GHash[i] = false;
-    }
-    for (int i = 0; i < MAX_K + 1; i++) {
-        WHash[i] = false;
-    }
+    GHash.Clear();
+    WHash.Clear();
 
     while (G.HowMany() > 0)
         G.Remove(G.HowMany() - 1);
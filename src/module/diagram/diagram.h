@@ -44,8 +44,8 @@ public:
     Bundle<WLine> W;
     Bundle<Vertex> Ver;
 
-    bool GHash[2 * MAX_K + 1];
-    bool WHash[MAX_K + 1];
+    MomentumHash<2 * MAX_K + 1> GHash; //indexed by Momentum::index()
+    MomentumHash<MAX_K + 1> WHash; //indexed by Momentum::abs()
 
     WormClass Worm;
     bool IsWorm(vertex);
@@ -60,6 +60,8 @@ public:
     //Diagram Hash Table Check
     bool GHashCheck(Momentum);
     bool WHashCheck(Momentum);
+    //number of momenta k with WHashCheck(k)==false
+    int WFreeCount();
 
     void AddGHash(Momentum);
     void AddWHash(Momentum);
@@ -81,7 +81,6 @@ void Diagram::_FromDict(const Dictionary& WDict, wLine w)
     w->nVer[OUT] = Ver(w_out);
     WDict.Get("K", w->K);
     AddWHash(w->K);
-    WDict.Print();
     WDict.Get("IsDelta", w->IsDelta);
     WDict.Get("IsMeasure", w->IsMeasure);
     if (w->IsMeasure) {
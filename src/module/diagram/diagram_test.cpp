@@ -90,6 +90,15 @@ void Test_Diagram_IO()
     Diag.SetTest(lat, G, W);
     LOG_INFO(Diag.Ver(0)->PrettyString());
     sput_fail_unless(Diag.CheckDiagram(), "Check diagram G,W,Ver and Weight");
+    sput_fail_unless(Diag.WFreeCount() == 2 * (MAX_K - Diag.W.HowMany()), "Every W line takes k and -k");
+    int NFreeSlot = MAX_K + 1 - Diag.WHash.Count();
+    bool IsFree = Diag.WHash.SelectFree(NFreeSlot) == -1;
+    for (int n = 0, last = -1; n < NFreeSlot; n++) {
+        int slot = Diag.WHash.SelectFree(n);
+        IsFree &= slot > last && !Diag.WHash.Test(slot);
+        last = slot;
+    }
+    sput_fail_unless(IsFree, "Select every free slot of the W hash in order");
     Diag.WriteDiagram2gv("./test.gv");
     //system("rm ./test.gv");
 }
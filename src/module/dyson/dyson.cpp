@@ -0,0 +1,396 @@
+//
+//  dyson.cpp
+//  Feynman_Simulator
+//
+//  Created by Kun Chen on 3/5/15.
+//  Copyright (c) 2015 Kun Chen. All rights reserved.
+//
+
+#include "dyson.h"
+#include "module/parameter/parameter.h"
+#include "utility/dictionary.h"
+#include "utility/parallel.h"
+#include "utility/fft.h"
+#include <math.h>
+#include <algorithm>
+
+using namespace std;
+using namespace weight;
+
+namespace dyson {
+
+/**********************   Field  **************************/
+
+Field::Field(const std::string& Name, const para::Parameter& Para, uint NSpin,
+             TauSymmetry Symmetry, const std::string& Domain)
+{
+    Allocate(Name, Para, NSpin, Symmetry, Domain);
+}
+
+void Field::Allocate(const std::string& Name_, const para::Parameter& Para, uint NSpin_,
+                     TauSymmetry Symmetry, const std::string& Domain)
+{
+    ASSERT_ALLWAYS(Name_ == SMOOTH || Name_ == DELTA, "Should be either SmoothT or DeltaT, not " << Name_);
+    Name = Name_;
+    NSpin = NSpin_;
+    NSublat = Para.NSublat;
+    Vol = Para.Lat.Vol;
+    L = Para.Lat.Size;
+    Beta = Para.Beta;
+    IsSymmetric = (Symmetry == TauSymmetric);
+    NT = HasTau() ? Para.MaxTauBin : 1;
+    SpaceDomain = Domain.find('K') != string::npos ? 'K' : 'R';
+    TimeDomain = Domain.find('W') != string::npos ? 'W' : 'T';
+    uint Shape[SMOOTH_T_SIZE] = { NSpin, NSublat, NSpin, NSublat, Vol, NT };
+    if (HasTau())
+        _SmoothT.Allocate(Shape, Name);
+    else
+        _DeltaT.Allocate(Shape, Name);
+    Size = Rank() * Rank() * NPoint();
+    Assign(Complex(0.0, 0.0));
+}
+
+void Field::Copy(const Field& source)
+{
+    ASSERT_ALLWAYS(Name == source.Name && Size == source.Size, "Shape should match!");
+    IsSymmetric = source.IsSymmetric;
+    SpaceDomain = source.SpaceDomain;
+    TimeDomain = source.TimeDomain;
+    std::copy(source.Data(), source.Data() + Size, Data());
+}
+
+void Field::Assign(const Complex& c)
+{
+    std::fill(Data(), Data() + Size, c);
+}
+
+Complex* Field::Data()
+{
+    return HasTau() ? _SmoothT.Data() : _DeltaT.Data();
+}
+
+const Complex* Field::Data() const
+{
+    return HasTau() ? &_SmoothT(0) : &_DeltaT(0);
+}
+
+void Field::FFT(const std::string& Domain, int NThread)
+{
+    if (Domain.find('R') != string::npos && SpaceDomain == 'K') {
+        _FFTSpace(1, NThread);
+        SpaceDomain = 'R';
+    }
+    if (Domain.find('K') != string::npos && SpaceDomain == 'R') {
+        _FFTSpace(-1, NThread);
+        SpaceDomain = 'K';
+    }
+    if (Domain.find('T') != string::npos && TimeDomain == 'W') {
+        _FFTTime(1, NThread);
+        TimeDomain = 'T';
+    }
+    if (Domain.find('W') != string::npos && TimeDomain == 'T') {
+        _FFTTime(-1, NThread);
+        TimeDomain = 'W';
+    }
+}
+
+//the same as numpy.fft.fftn/ifftn over the lattice dimensions of VOL
+void Field::_FFTSpace(int Sign, int NThread)
+{
+    uint Shape[D + 2];
+    bool Mask[D + 2];
+    Shape[0] = Rank() * Rank();
+    Mask[0] = false;
+    for (int d = 0; d < D; d++) {
+        Shape[d + 1] = L[d];
+        Mask[d + 1] = true;
+    }
+    Shape[D + 1] = NT;
+    Mask[D + 1] = false;
+    fft::fftnD(Data(), Shape, D + 2, Sign > 0 ? fft::BACK : fft::FORTH, Mask, NThread);
+}
+
+/**
+*  the transformation is done in the continuous tau representation, tau_n=(n+1/2)*Beta/NT, so an anti-symmetric
+*  function gets the phase exp(-i*PI*tau_n/Beta) first, and omega_m gets the extra phase exp(-i*PI*m/NT);
+*  both phases and 1/NT are folded into the plan
+*/
+void Field::_FFTTime(int Sign, int NThread)
+{
+    if (!HasTau())
+        return;
+    fft::Twist TauPhase = IsSymmetric ? fft::Twist() : fft::Twist(Sign, 0.5);
+    fft::Twist OmegaPhase(Sign, 0.0);
+    if (Sign < 0)
+        fft::GetPlan(Size / NT, NT, 1, fft::FORTH, TauPhase, OmegaPhase).Execute(Data(), NThread);
+    else
+        fft::GetPlan(Size / NT, NT, 1, fft::BACK, OmegaPhase, TauPhase, 1.0 / NT).Execute(Data(), NThread);
+}
+
+bool Field::FromDict(const Dictionary& dict)
+{
+    SpaceDomain = 'R';
+    TimeDomain = 'T';
+    return HasTau() ? _SmoothT.FromDict(dict) : _DeltaT.FromDict(dict);
+}
+
+Dictionary Field::ToDict()
+{
+    ASSERT_ALLWAYS(SpaceDomain == 'R' && TimeDomain == 'T', "Field should be in R and T!");
+    return HasTau() ? _SmoothT.ToDict() : _DeltaT.ToDict();
+}
+
+/**********************   Calculator  **************************/
+
+//the same as map.Spin2Index of dyson/weight.py
+static int Spin2Index(int SpinIn, int SpinOut)
+{
+    return SpinIn * SPIN + SpinOut;
+}
+
+Calculator::Calculator(int NThread_)
+{
+    NThread = ThreadNumber(NThread_);
+}
+
+/**
+*  C(p)=A(p)*B(p) for the Rank*Rank matrices at every point p=vol*NT+tau, the arrays are in the layout
+*  [Rank, Rank, Vol, NTA/NTB/NT], where NTA or NTB is 1 for a DeltaT factor
+*/
+static void MatMul(const Complex* A, uint NTA, const Complex* B, uint NTB, vector<Complex>& C,
+                   uint Rank, uint Vol, uint NT, int NThread)
+{
+    uint NPoint = Vol * NT;
+    C.assign(Rank * Rank * NPoint, Complex(0.0, 0.0));
+    ParallelFor(NPoint, NThread, [&](uint begin, uint end) {
+        for (uint p = begin; p < end; p++) {
+            uint v = p / NT, t = p % NT;
+            uint pa = v * NTA + (NTA > 1 ? t : 0), pb = v * NTB + (NTB > 1 ? t : 0);
+            for (uint i = 0; i < Rank; i++)
+                for (uint k = 0; k < Rank; k++) {
+                    Complex a = A[(i * Rank + k) * Vol * NTA + pa];
+                    for (uint m = 0; m < Rank; m++)
+                        C[(i * Rank + m) * NPoint + p] += a * B[(k * Rank + m) * Vol * NTB + pb];
+                }
+        }
+    });
+}
+
+static bool Less(const Complex& a, const Complex& b)
+{
+    return a.Re < b.Re || (a.Re == b.Re && a.Im < b.Im);
+}
+
+/**
+*  solve Denorm(p)*X(p)=B(p) at every point p with the batched LU decomposition, for every (B, X)
+*  in Equations. X is only written if no denominator touches zero, otherwise ValueInvalid is thrown,
+*  like DenorminatorTouchZero of dyson/calculator.py
+*
+*  @return the minimum of det(Denorm(p)), ordered by the real part first
+*/
+Complex Calculator::_Solve(const vector<Complex>& Denorm, uint Rank, uint NPoint,
+                           const vector<pair<const Complex*, Field*> >& Equations)
+{
+    _LU.Resize(Rank, NPoint);
+    _LU.Factor(Denorm.data(), NThread);
+    const vector<Complex>& Determ = _LU.Determinant();
+    uint pmin = min_element(Determ.begin(), Determ.end(), Less) - Determ.begin();
+    Field& f = *Equations[0].second;
+    LOG_INFO("The minimum " << Determ[pmin] << " is at K=" << pmin / f.NT << " and Omega=" << pmin % f.NT);
+    if (Determ[pmin].Re < 0.0 && Determ[pmin].Im < 1.0e-4)
+        THROW_ERROR(ValueInvalid, "Denorminator touch zero, minimum " << Determ[pmin]
+                                                                      << " is at K=" << pmin / f.NT
+                                                                      << " and Omega=" << pmin % f.NT);
+    for (auto& eq : Equations) {
+        ASSERT_ALLWAYS(eq.second->Size == Rank * Rank * NPoint, "Shape should match!");
+        _LU.Solve(eq.first, eq.second->Data(), NThread);
+    }
+    return Determ[pmin];
+}
+
+void Calculator::SigmaSmoothT_FirstOrder(Field& G, Field& W, Field& Sigma)
+{
+    const real OrderSign = -1.0;
+    G.FFT("RT", NThread);
+    W.FFT("RT", NThread);
+    Sigma.Assign(Complex(0.0, 0.0));
+    Sigma.SpaceDomain = 'R';
+    Sigma.TimeDomain = 'T';
+    uint NSub = G.NSublat, NPoint = G.NPoint();
+    for (int spin1 = 0; spin1 < SPIN; spin1++)
+        for (int spin2 = 0; spin2 < SPIN; spin2++) {
+            int spinWIn = Spin2Index(spin1, spin2);
+            int spinWOut = Spin2Index(spin2, spin1);
+            for (uint sub1 = 0; sub1 < NSub; sub1++)
+                for (uint sub2 = 0; sub2 < NSub; sub2++) {
+                    Complex* s = &Sigma(spin1, sub1, spin1, sub2, 0);
+                    Complex* g = &G(spin2, sub1, spin2, sub2, 0);
+                    Complex* w = &W(spinWIn, sub1, spinWOut, sub2, 0);
+                    for (uint p = 0; p < NPoint; p++)
+                        s[p] += OrderSign * g[p] * w[p];
+                }
+        }
+}
+
+void Calculator::SigmaDeltaT_FirstOrder(Field& G, Field& W0, Field& SigmaDeltaT)
+{
+    const real OrderSign = -1.0, AntiSymmetricFactor = -1.0, FermiLoopSign = -1.0;
+    G.FFT("RT", NThread);
+    W0.FFT("R", NThread);
+    SigmaDeltaT.Assign(Complex(0.0, 0.0));
+    SigmaDeltaT.SpaceDomain = 'R';
+    uint NSub = G.NSublat, Vol = G.Vol, NT = G.NT;
+    //G(tau=0^-), extrapolated from the last two bins
+    auto GMinus = [&](int sp, uint sub1, uint sub2, uint r) {
+        return 1.5 * G(sp, sub1, sp, sub2, r, NT - 1) - 0.5 * G(sp, sub1, sp, sub2, r, NT - 2);
+    };
+    //Fock diagram
+    for (int spin1 = 0; spin1 < SPIN; spin1++)
+        for (int spin2 = 0; spin2 < SPIN; spin2++) {
+            int spinWIn = Spin2Index(spin1, spin2);
+            int spinWOut = Spin2Index(spin2, spin1);
+            for (uint sub1 = 0; sub1 < NSub; sub1++)
+                for (uint sub2 = 0; sub2 < NSub; sub2++)
+                    for (uint r = 0; r < Vol; r++)
+                        SigmaDeltaT(spin1, sub1, spin1, sub2, r) += OrderSign * AntiSymmetricFactor
+                                                                    * GMinus(spin2, sub1, sub2, r) * W0(spinWIn, sub1, spinWOut, sub2, r);
+        }
+    //Hartree diagram, or bubble diagram
+    for (int sp1 = 0; sp1 < SPIN; sp1++)
+        for (int sp2 = 0; sp2 < SPIN; sp2++) {
+            int spinWIn = Spin2Index(sp1, sp1);
+            int spinWOut = Spin2Index(sp2, sp2);
+            for (uint sub1 = 0; sub1 < NSub; sub1++)
+                for (uint sub2 = 0; sub2 < NSub; sub2++) {
+                    Complex G1 = GMinus(sp2, sub2, sub2, 0);
+                    for (uint r = 0; r < Vol; r++)
+                        SigmaDeltaT(sp1, sub1, sp1, sub1, 0) += OrderSign * FermiLoopSign * AntiSymmetricFactor
+                                                                * G1 * W0(spinWIn, sub1, spinWOut, sub2, r);
+                }
+        }
+}
+
+void Calculator::Polar_FirstOrder(Field& G, Field& Polar)
+{
+    const real OrderSign = -1.0, FermiLoopSign = -1.0, AntiSymmetricFactor = -1.0;
+    G.FFT("RT", NThread);
+    Polar.Assign(Complex(0.0, 0.0));
+    Polar.SpaceDomain = 'R';
+    Polar.TimeDomain = 'T';
+    uint NSub = G.NSublat, Vol = G.Vol, NT = G.NT;
+    for (int spin1 = 0; spin1 < SPIN; spin1++)
+        for (int spin2 = 0; spin2 < SPIN; spin2++) {
+            int spinIn = Spin2Index(spin1, spin2);
+            int spinOut = Spin2Index(spin2, spin1);
+            for (uint subA = 0; subA < NSub; subA++)
+                for (uint subB = 0; subB < NSub; subB++)
+                    for (uint r = 0; r < Vol; r++) {
+                        Complex* p = &Polar(spinIn, subA, spinOut, subB, r);
+                        Complex* g1 = &G(spin1, subB, spin1, subA, r);
+                        Complex* g2 = &G(spin2, subA, spin2, subB, r);
+                        for (uint t = 0; t < NT; t++)
+                            p[t] += OrderSign * FermiLoopSign * AntiSymmetricFactor * g1[NT - 1 - t] * g2[t];
+                    }
+        }
+}
+
+Complex Calculator::W_Dyson(Field& W0, Field& Polar, Field& W, Field& ChiTensor)
+{
+    Polar.FFT("KW", NThread);
+    W0.FFT("K", NThread);
+    uint Rank = Polar.Rank(), Vol = Polar.Vol, NT = Polar.NT, NPoint = Polar.NPoint();
+    real dBeta = Polar.Beta / NT;
+    vector<Complex> JP, JPJ;
+    MatMul(W0.Data(), 1, Polar.Data(), NT, JP, Rank, Vol, NT, NThread);
+    MatMul(JP.data(), NT, W0.Data(), 1, JPJ, Rank, Vol, NT, NThread);
+    vector<Complex> Denorm(JP.size()), MinusPolar(JP.size());
+    for (uint i = 0; i < Rank; i++)
+        for (uint j = 0; j < Rank; j++)
+            for (uint p = 0; p < NPoint; p++) {
+                uint index = (i * Rank + j) * NPoint + p;
+                Denorm[index] = (i == j ? 1.0 : 0.0) - JP[index] * dBeta * cos((p % NT) * PI / NT);
+                MinusPolar[index] = -Polar.Data()[index];
+            }
+    Complex Determ = _Solve(Denorm, Rank, NPoint, { { JPJ.data(), &W }, { MinusPolar.data(), &ChiTensor } });
+    W.SpaceDomain = ChiTensor.SpaceDomain = 'K';
+    W.TimeDomain = ChiTensor.TimeDomain = 'W';
+    return Determ;
+}
+
+Complex Calculator::G_Dyson(Field& G0, Field& SigmaDeltaT, Field& Sigma, Field& G)
+{
+    G0.FFT("KW", NThread);
+    SigmaDeltaT.FFT("K", NThread);
+    Sigma.FFT("KW", NThread);
+    uint Rank = G0.Rank(), Vol = G0.Vol, NT = G0.NT, NPoint = G0.NPoint();
+    real dBeta = G0.Beta / NT;
+    vector<Complex> G0Sigma, G0SigmaDeltaT;
+    MatMul(G0.Data(), NT, Sigma.Data(), NT, G0Sigma, Rank, Vol, NT, NThread);
+    MatMul(G0.Data(), NT, SigmaDeltaT.Data(), 1, G0SigmaDeltaT, Rank, Vol, NT, NThread);
+    vector<Complex> Denorm(G0Sigma.size());
+    for (uint i = 0; i < Rank; i++)
+        for (uint j = 0; j < Rank; j++)
+            for (uint p = 0; p < NPoint; p++) {
+                uint index = (i * Rank + j) * NPoint + p;
+                //correction term of the delta part, cos(PI*tau/Beta)
+                Complex GS = dBeta * (dBeta * G0Sigma[index]
+                                      + G0SigmaDeltaT[index] * cos(PI * (p % NT + 0.5) / NT));
+                Denorm[index] = (i == j ? 1.0 : 0.0) - GS;
+            }
+    Complex Determ = _Solve(Denorm, Rank, NPoint, { { G0.Data(), &G } });
+    G.SpaceDomain = 'K';
+    G.TimeDomain = 'W';
+    return Determ;
+}
+
+/**
+*  This diagram has +1 sign since two fermi loop contribute (-1)^2
+*/
+void Calculator::Add_ChiTensor_ZerothOrder(Field& ChiTensor, Field& G)
+{
+    G.FFT("RT", NThread);
+    ChiTensor.FFT("RT", NThread);
+    uint NSub = G.NSublat, NT = G.NT, NPoint = ChiTensor.NPoint();
+    auto GMinus = [&](int spIn, int spOut, uint sub) {
+        return 1.5 * G(spIn, sub, spOut, sub, 0, NT - 1) - 0.5 * G(spIn, sub, spOut, sub, 0, NT - 2);
+    };
+    for (int spIn1 = 0; spIn1 < SPIN; spIn1++)
+        for (int spIn2 = 0; spIn2 < SPIN; spIn2++)
+            for (int spOut1 = 0; spOut1 < SPIN; spOut1++)
+                for (int spOut2 = 0; spOut2 < SPIN; spOut2++) {
+                    int ChiSpIn = Spin2Index(spIn1, spIn2);
+                    int ChiSpOut = Spin2Index(spOut1, spOut2);
+                    for (uint subIn = 0; subIn < NSub; subIn++)
+                        for (uint subOut = 0; subOut < NSub; subOut++) {
+                            Complex GG = GMinus(spIn1, spIn2, subIn) * GMinus(spOut1, spOut2, subOut);
+                            Complex* chi = &ChiTensor(ChiSpIn, subIn, ChiSpOut, subOut, 0);
+                            for (uint p = 0; p < NPoint; p++)
+                                chi[p] += GG;
+                        }
+                }
+}
+
+void Calculator::Calculate_Chi(Field& ChiTensor, Field& Chi)
+{
+    int UU = Spin2Index(UP, UP), DD = Spin2Index(DOWN, DOWN);
+    real SzSz[::SPIN2][::SPIN2] = {};
+    SzSz[UU][UU] = SzSz[DD][DD] = 1.0 / 4.0;
+    SzSz[UU][DD] = SzSz[DD][UU] = -1.0 / 4.0;
+    Chi.Assign(Complex(0.0, 0.0));
+    Chi.SpaceDomain = ChiTensor.SpaceDomain;
+    Chi.TimeDomain = ChiTensor.TimeDomain;
+    uint NSub = ChiTensor.NSublat, NPoint = ChiTensor.NPoint();
+    for (int i = 0; i < ::SPIN2; i++)
+        for (int k = 0; k < ::SPIN2; k++) {
+            if (SzSz[i][k] == 0.0)
+                continue;
+            for (uint m = 0; m < NSub; m++)
+                for (uint n = 0; n < NSub; n++) {
+                    Complex* chi = &Chi(0, m, 0, n, 0);
+                    Complex* tensor = &ChiTensor(k, m, i, n, 0);
+                    for (uint p = 0; p < NPoint; p++)
+                        chi[p] += SzSz[i][k] * tensor[p];
+                }
+        }
+}
+}
@@ -0,0 +1,132 @@
+//
+//  dyson.h
+//  Feynman_Simulator
+//
+//  Created by Kun Chen on 3/5/15.
+//  Copyright (c) 2015 Kun Chen. All rights reserved.
+//
+
+#ifndef __Feynman_Simulator__dyson__
+#define __Feynman_Simulator__dyson__
+
+#include "module/weight/weight_array.h"
+#include "module/weight/index_map.h"
+#include "utility/complex.h"
+#include "utility/vector.h"
+#include "utility/lu.h"
+#include <string>
+#include <vector>
+
+class Dictionary;
+namespace para {
+class Parameter;
+}
+
+/*
+ *  Native version of the self-consistent step of dyson/calculator.py. A Field has the layout of
+ *  WeightArray, [SP1, SUB1, SP2, SUB2, VOL, TAU] (without TAU for DeltaT), so (SP1, SUB1) and (SP2, SUB2)
+ *  are the row and the column of a NSpin*NSublat matrix at every point (VOL, TAU).
+ *  The conventions of the Fourier transforms are the same as dyson/weight.py.
+ */
+namespace dyson {
+
+class Field {
+public:
+    Field()
+        : NSpin(0)
+        , NT(0)
+        , SpaceDomain('R')
+        , TimeDomain('T'){};
+    Field(const std::string& Name, const para::Parameter&, uint NSpin,
+          weight::TauSymmetry, const std::string& Domain = "RT");
+    //Name is either weight::SMOOTH or weight::DELTA, the array starts from zero
+    void Allocate(const std::string& Name, const para::Parameter&, uint NSpin,
+                  weight::TauSymmetry, const std::string& Domain = "RT");
+    void Copy(const Field&);
+    void Assign(const Complex& c);
+
+    std::string Name;
+    uint NSpin; //2 for G/Sigma, 4 for W/Polar, 1 for Chi
+    uint NSublat;
+    uint Vol;
+    uint NT; //MaxTauBin for SmoothT, 1 for DeltaT
+    uint Size;
+    Vec<int> L;
+    real Beta;
+    bool IsSymmetric;
+    char SpaceDomain; //'R' or 'K'
+    char TimeDomain; //'T' or 'W'
+
+    bool HasTau() const { return Name == weight::SMOOTH; }
+    //rank of the (spin, sublattice) matrix at every point
+    uint Rank() const { return NSpin * NSublat; }
+    uint NPoint() const { return Vol * NT; }
+    Complex* Data();
+    const Complex* Data() const;
+    Complex& operator()(uint sp1, uint sub1, uint sp2, uint sub2, uint vol, uint tau = 0)
+    {
+        return Data()[(((sp1 * NSublat + sub1) * NSpin + sp2) * NSublat + sub2) * NPoint() + vol * NT + tau];
+    }
+
+    /**
+    *  transform to the domains in Domain, like "KW" or "R"; the others are not touched
+    *  K: forward FFT over the lattice, R: its inverse with 1/Vol
+    *  W: forward FFT over tau after the phase twist of an anti-symmetric function, T: its inverse with 1/NT
+    */
+    void FFT(const std::string& Domain, int NThread = 1);
+
+    //the array has to be in R and T
+    bool FromDict(const Dictionary&);
+    Dictionary ToDict();
+
+private:
+    weight::WeightArray<weight::SMOOTH_T_SIZE> _SmoothT;
+    weight::WeightArray<weight::DELTA_T_SIZE> _DeltaT;
+    void _FFTSpace(int Sign, int NThread);
+    void _FFTTime(int Sign, int NThread);
+};
+
+/**
+*  the first order diagrams and the Dyson equations of dyson/calculator.py, spin is conserved.
+*  The arguments are transformed to the domains each step works in, and the results are
+*  left in the domains the python version leaves them in.
+*  NThread<=0 uses all cores.
+*/
+class Calculator {
+public:
+    Calculator(int NThread = 0);
+    int NThread;
+
+    //Fock diagram, in R and T
+    void SigmaSmoothT_FirstOrder(Field& G, Field& W, Field& Sigma);
+    //Hartree-Fock diagrams with the bare interaction W0, in R
+    void SigmaDeltaT_FirstOrder(Field& G, Field& W0, Field& SigmaDeltaT);
+    //bubble diagram, in R and T
+    void Polar_FirstOrder(Field& G, Field& Polar);
+    /**
+    *  W=(1-W0*Polar)^-1*W0*Polar*W0 and ChiTensor=-(1-W0*Polar)^-1*Polar, in K and W
+    *
+    *  @return the minimum of the determinants of the denominators
+    */
+    Complex W_Dyson(Field& W0, Field& Polar, Field& W, Field& ChiTensor);
+    /**
+    *  G=(1-G0*Sigma)^-1*G0, where Sigma has the smooth part and the delta part, in K and W
+    *
+    *  @return the minimum of the determinants of the denominators
+    */
+    Complex G_Dyson(Field& G0, Field& SigmaDeltaT, Field& Sigma, Field& G);
+    //add G(tau=0^-, r=0)G(tau=0^-, r=0), in R and T
+    void Add_ChiTensor_ZerothOrder(Field& ChiTensor, Field& G);
+    //SzSz correlation of ChiTensor, in the domains of ChiTensor
+    void Calculate_Chi(Field& ChiTensor, Field& Chi);
+
+private:
+    BatchedLU _LU;
+    Complex _Solve(const std::vector<Complex>& Denorm, uint Rank, uint NPoint,
+                   const std::vector<std::pair<const Complex*, Field*> >& Equations);
+};
+
+int TestDyson();
+}
+
+#endif /* defined(__Feynman_Simulator__dyson__) */
@@ -0,0 +1,233 @@
+//
+//  dyson_test.cpp
+//  Feynman_Simulator
+//
+//  Created by Kun Chen on 3/5/15.
+//  Copyright (c) 2015 Kun Chen. All rights reserved.
+//
+
+#include "dyson.h"
+#include "utility/sput.h"
+#include "utility/rng.h"
+#include "utility/dictionary.h"
+#include "module/parameter/parameter.h"
+#include <math.h>
+#include <functional>
+
+using namespace std;
+using namespace weight;
+using namespace dyson;
+
+void Test_FieldFFT();
+void Test_GDyson();
+void Test_WDyson();
+void Test_TouchZero();
+
+int dyson::TestDyson()
+{
+    sput_start_testing();
+    sput_enter_suite("Test Dyson:");
+    sput_run_test(Test_FieldFFT);
+    sput_run_test(Test_GDyson);
+    sput_run_test(Test_WDyson);
+    sput_run_test(Test_TouchZero);
+    sput_finish_testing();
+    return sput_get_return_value();
+}
+
+void FillRandom(Field& f, RandomFactory& rng, real scale = 1.0)
+{
+    for (uint i = 0; i < f.Size; i++)
+        f.Data()[i] = Complex(scale * (rng.urn() - 0.5), scale * (rng.urn() - 0.5));
+}
+
+bool IsSame(const Field& a, const Field& b, real eps = 1.0e-10)
+{
+    bool same = a.Size == b.Size;
+    for (uint i = 0; same && i < a.Size; i++)
+        same &= Equal(a.Data()[i], b.Data()[i], eps);
+    return same;
+}
+
+/**
+*  the residual of A(p)*X(p)=B(p) at every point, where A=I-c(p)*L(p)*R(p)
+*/
+real Residual(Field& L, Field& R, Field& X, Field& B, const function<real(uint)>& c)
+{
+    uint Rank = X.Rank(), NPoint = X.NPoint();
+    //a DeltaT field is the same at all tau
+    auto at = [&](Field& f, uint i, uint j, uint p) {
+        return f.Data()[(i * Rank + j) * f.NPoint() + (f.HasTau() ? p : p / X.NT)];
+    };
+    real residual = 0.0;
+    for (uint p = 0; p < NPoint; p++)
+        for (uint i = 0; i < Rank; i++)
+            for (uint j = 0; j < Rank; j++) {
+                Complex r = X.Data()[(i * Rank + j) * NPoint + p] - at(B, i, j, p);
+                for (uint k = 0; k < Rank; k++)
+                    for (uint m = 0; m < Rank; m++)
+                        r -= c(p) * at(L, i, k, p) * at(R, k, m, p) * at(X, m, j, p);
+                residual = max(residual, mod(r));
+            }
+    return residual;
+}
+
+void Test_FieldFFT()
+{
+    para::ParaDyson Para;
+    Para.SetTest();
+    RandomFactory rng;
+    rng.Reset(519180543);
+
+    Field G(SMOOTH, Para, SPIN, TauAntiSymmetric), Old(SMOOTH, Para, SPIN, TauAntiSymmetric);
+    FillRandom(G, rng);
+    Old.Copy(G);
+    G.FFT("KW", 4);
+    sput_fail_unless(G.SpaceDomain == 'K' && G.TimeDomain == 'W', "G is transformed to K and W");
+    G.FFT("RT", 4);
+    sput_fail_unless(IsSame(G, Old), "FFT back and forth of an anti-symmetric SmoothT function");
+
+    //a point at r=(1,2) and tau_n, in the same conventions as dyson/weight.py
+    G.Assign(Complex(0.0, 0.0));
+    uint n = 3, L0 = Para.Lat.Size[0], L1 = Para.Lat.Size[1], NT = Para.MaxTauBin;
+    G(UP, 1, UP, 0, 1 * L1 + 2, n) = 1.0;
+    G.FFT("KW");
+    bool IsRight = true;
+    for (uint k0 = 0; k0 < L0; k0++)
+        for (uint k1 = 0; k1 < L1; k1++)
+            for (uint w = 0; w < NT; w++) {
+                real phase = -2.0 * PI * (1.0 * k0 / L0 + 2.0 * k1 / L1) - PI * (n + 0.5) / NT
+                             - 2.0 * PI * n * w / NT - PI * w / NT;
+                IsRight &= Equal(G(UP, 1, UP, 0, k0 * L1 + k1, w), polar(1.0, phase), 1.0e-10);
+            }
+    sput_fail_unless(IsRight, "FFT of a single point");
+
+    //lattices which are not powers of 2
+    int size[2] = { 3, 5 };
+    Para.Lat = Lattice(Vec<int>(size), Para.NSublat);
+    Field W0(DELTA, Para, ::SPIN2, TauSymmetric), W0Old(DELTA, Para, ::SPIN2, TauSymmetric);
+    FillRandom(W0, rng);
+    W0Old.Copy(W0);
+    W0.FFT("K");
+    W0.FFT("R");
+    sput_fail_unless(IsSame(W0, W0Old), "FFT back and forth on a 3x5 lattice");
+
+    Dictionary dict = W0.ToDict();
+    W0Old.Assign(Complex(0.0, 0.0));
+    W0Old.FromDict(dict);
+    sput_fail_unless(IsSame(W0, W0Old), "Field to and from dict");
+}
+
+void Test_GDyson()
+{
+    para::ParaDyson Para;
+    Para.SetTest();
+    RandomFactory rng;
+    rng.Reset(519180543);
+    Field G0(SMOOTH, Para, SPIN, TauAntiSymmetric), G(SMOOTH, Para, SPIN, TauAntiSymmetric);
+    Field SigmaDeltaT(DELTA, Para, SPIN, TauAntiSymmetric), Sigma(SMOOTH, Para, SPIN, TauAntiSymmetric);
+    FillRandom(G0, rng);
+    Field Old(SMOOTH, Para, SPIN, TauAntiSymmetric);
+    Old.Copy(G0);
+
+    Calculator calc(2);
+    calc.G_Dyson(G0, SigmaDeltaT, Sigma, G);
+    G.FFT("RT");
+    sput_fail_unless(IsSame(G, Old), "G=G0 without Sigma");
+
+    FillRandom(Sigma, rng, 0.5);
+    FillRandom(SigmaDeltaT, rng, 0.5);
+    Complex Determ = calc.G_Dyson(G0, SigmaDeltaT, Sigma, G);
+    sput_fail_unless(G.SpaceDomain == 'K' && G.TimeDomain == 'W', "G is in K and W");
+    sput_fail_unless(Determ.Re > 0.0, "Denominator does not touch zero");
+    real dBeta = Para.Beta / Para.MaxTauBin;
+    uint NT = Para.MaxTauBin;
+    //G=G0+G0*Sigma*G, with both the smooth and the delta part of Sigma
+    real residual = 0.0;
+    uint Rank = G.Rank(), NPoint = G.NPoint();
+    for (uint p = 0; p < NPoint; p++)
+        for (uint i = 0; i < Rank; i++)
+            for (uint j = 0; j < Rank; j++) {
+                Complex r = G.Data()[(i * Rank + j) * NPoint + p] - G0.Data()[(i * Rank + j) * NPoint + p];
+                for (uint k = 0; k < Rank; k++)
+                    for (uint m = 0; m < Rank; m++) {
+                        Complex s = dBeta * Sigma.Data()[(k * Rank + m) * NPoint + p]
+                                    + SigmaDeltaT.Data()[(k * Rank + m) * Para.Lat.Vol + p / NT] * cos(PI * (p % NT + 0.5) / NT);
+                        r -= dBeta * G0.Data()[(i * Rank + k) * NPoint + p] * s * G.Data()[(m * Rank + j) * NPoint + p];
+                    }
+                residual = max(residual, mod(r));
+            }
+    sput_fail_unless(residual < 1.0e-10, "G=G0+G0*Sigma*G");
+
+    Calculator serial(1);
+    Field G1(SMOOTH, Para, SPIN, TauAntiSymmetric);
+    serial.G_Dyson(G0, SigmaDeltaT, Sigma, G1);
+    bool IsExact = true;
+    for (uint i = 0; i < G.Size; i++)
+        IsExact &= (G.Data()[i].Re == G1.Data()[i].Re && G.Data()[i].Im == G1.Data()[i].Im);
+    sput_fail_unless(IsExact, "Threads do not change G");
+}
+
+void Test_WDyson()
+{
+    para::ParaDyson Para;
+    Para.SetTest();
+    RandomFactory rng;
+    rng.Reset(519180543);
+    Field W0(DELTA, Para, ::SPIN2, TauSymmetric), Polar(SMOOTH, Para, ::SPIN2, TauSymmetric);
+    Field W(SMOOTH, Para, ::SPIN2, TauSymmetric), ChiTensor(SMOOTH, Para, ::SPIN2, TauSymmetric);
+    FillRandom(W0, rng, 0.1);
+    FillRandom(Polar, rng, 0.1);
+
+    Calculator calc(3);
+    calc.W_Dyson(W0, Polar, W, ChiTensor);
+    sput_fail_unless(W.SpaceDomain == 'K' && W.TimeDomain == 'W' && W0.SpaceDomain == 'K', "W is in K and W");
+    real dBeta = Para.Beta / Para.MaxTauBin;
+    uint NT = Para.MaxTauBin;
+    auto c = [&](uint p) { return dBeta * cos((p % NT) * PI / NT); };
+
+    //W=W0*Polar*W0+c*W0*Polar*W
+    Field W0PW0(SMOOTH, Para, ::SPIN2, TauSymmetric);
+    uint Rank = W.Rank(), NPoint = W.NPoint(), Vol = Para.Lat.Vol;
+    for (uint p = 0; p < NPoint; p++)
+        for (uint i = 0; i < Rank; i++)
+            for (uint j = 0; j < Rank; j++)
+                for (uint k = 0; k < Rank; k++)
+                    for (uint m = 0; m < Rank; m++)
+                        W0PW0.Data()[(i * Rank + j) * NPoint + p] += W0.Data()[(i * Rank + k) * Vol + p / NT]
+                                                                     * Polar.Data()[(k * Rank + m) * NPoint + p]
+                                                                     * W0.Data()[(m * Rank + j) * Vol + p / NT];
+    sput_fail_unless(Residual(W0, Polar, W, W0PW0, c) < 1.0e-10, "W=W0*Polar*W0+W0*Polar*W");
+
+    Field MinusPolar(SMOOTH, Para, ::SPIN2, TauSymmetric);
+    MinusPolar.Copy(Polar);
+    Scale(MinusPolar.Data(), -1.0, MinusPolar.Size);
+    sput_fail_unless(Residual(W0, Polar, ChiTensor, MinusPolar, c) < 1.0e-10, "ChiTensor=-Polar+W0*Polar*ChiTensor");
+}
+
+void Test_TouchZero()
+{
+    para::ParaDyson Para;
+    Para.SetTest();
+    Field W0(DELTA, Para, ::SPIN2, TauSymmetric, "K"), Polar(SMOOTH, Para, ::SPIN2, TauSymmetric, "KW");
+    Field W(SMOOTH, Para, ::SPIN2, TauSymmetric), ChiTensor(SMOOTH, Para, ::SPIN2, TauSymmetric);
+    uint Rank = W0.Rank();
+    for (uint i = 0; i < Rank; i++)
+        for (uint v = 0; v < W0.Vol; v++)
+            W0.Data()[(i * Rank + i) * W0.Vol + v] = 1.0;
+    //1-W0*Polar*Beta/MaxTauBin is -1 for the first element at omega=0
+    for (uint p = 0; p < Polar.NPoint(); p++)
+        Polar.Data()[p] = 2.0 * Para.MaxTauBin / Para.Beta;
+    W.Assign(Complex(1.0, 0.0));
+
+    Calculator calc(2);
+    bool IsThrown = false;
+    try {
+        calc.W_Dyson(W0, Polar, W, ChiTensor);
+    }
+    catch (ValueInvalid e) {
+        IsThrown = true;
+    }
+    sput_fail_unless(IsThrown, "Denominator touches zero");
+    sput_fail_unless(Equal(W.Data()[0], Complex(1.0, 0.0)) && W.SpaceDomain == 'R', "W is not touched");
+}
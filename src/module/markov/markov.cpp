@@ -7,6 +7,7 @@
 //
 
 #include <stdio.h>
+#include <chrono>
 #include "markov.h"
 #include "math.h"
 #include "utility/utility.h"
@@ -24,26 +25,88 @@ using namespace mc;
 
 #define SIGN(x) ((x) == IN ? 1 : -1)
 #define NAME(x) #x
+//leave an update before the Metropolis test, the reason is counted by the probe
+#define REJECT(reason)                \
+    do {                              \
+        PROBE_REJECT(_Probe, reason); \
+        return;                       \
+    } while (0)
 
 bool CanNotMoveWorm(int dspin, spin sin, spin sout);
 bool CanNotMoveWorm(int dspin, spin sin, int dir);
 
+Markov::Markov()
+{
+    InitialArray(ProbofCall, 0.0, NUpdates);
+    InitialArray(SumofProbofCall, 0.0, NUpdates);
+    InitialArray(_AliasProb, 1.0, NUpdates);
+    InitialArray(_BaseProbofCall, 0.0, NUpdates);
+    InitialArray(_TuneSeconds, 0.0, NUpdates);
+    InitialArray(_TuneAccepted, 0.0, NUpdates);
+    for (int i = 0; i < NUpdates; i++) {
+        _Update[i] = nullptr;
+        _Alias[i] = i;
+        _Partner[i] = i;
+    }
+    _IsTuning = false;
+}
+
 bool Markov::BuildNew(ParaMC &para, Diagram &diag, weight::Weight &weight)
 {
     Reset(para, diag, weight);
     ASSERT_ALLWAYS(NUpdates >= (int)Operations::END, "NUpdates " << NUpdates << " should larger than " << (int)Operations::END);
 
-    InitialArray(ProbofCall, 0.0, NUpdates);
-    InitialArray(SumofProbofCall, 0.0, NUpdates);
-
-    for (int i = 0; i < NUpdates; i++) {
-        ProbofCall[i] = 1.0 / real(NUpdates);
-        for (int j = i; j < NUpdates; j++)
-            SumofProbofCall[j] += ProbofCall[i];
+    //CHANGE_R_VERTEX and CHANGE_SPIN_VERTEX are not used for now,
+    //they get zero probability so that no hop is wasted on them
+    InitialArray(ProbofCall, 1.0, NUpdates);
+    ProbofCall[CHANGE_R_VERTEX] = 0.0;
+    ProbofCall[CHANGE_SPIN_VERTEX] = 0.0;
+
+    _Update[CREATE_WORM] = &Markov::CreateWorm;
+    _Update[DELETE_WORM] = &Markov::DeleteWorm;
+    _Update[MOVE_WORM_G] = &Markov::MoveWormOnG;
+    _Update[MOVE_WORM_W] = &Markov::MoveWormOnW;
+    _Update[RECONNECT] = &Markov::Reconnect;
+    _Update[ADD_INTERACTION] = &Markov::AddInteraction;
+    _Update[DEL_INTERACTION] = &Markov::DeleteInteraction;
+    _Update[ADD_DELTA_INTERACTION] = &Markov::AddDeltaInteraction;
+    _Update[DEL_DELTA_INTERACTION] = &Markov::DeleteDeltaInteraction;
+    _Update[CHANGE_TAU_VERTEX] = &Markov::ChangeTauOnVertex;
+    _Update[CHANGE_R_VERTEX] = &Markov::ChangeROnVertex;
+    _Update[CHANGE_R_LOOP] = &Markov::ChangeRLoop;
+    _Update[CHANGE_MEASURE_G2W] = &Markov::ChangeMeasureFromGToW;
+    _Update[CHANGE_MEASURE_W2G] = &Markov::ChangeMeasureFromWToG;
+    _Update[CHANGE_DELTA2CONTINUS] = &Markov::ChangeDeltaToContinuous;
+    _Update[CHANGE_CONTINUS2DELTA] = &Markov::ChangeContinuousToDelta;
+    _Update[CHANGE_SPIN_VERTEX] = &Markov::ChangeSpinOnVertex;
+    _Update[JUMP_TO_ORDER0] = &Markov::JumpToOrder0;
+    _Update[JUMP_BACK_TO_ORDER1] = &Markov::JumpBackToOrder1;
+    _BuildDispatchTable();
+    std::copy(ProbofCall, ProbofCall + NUpdates, _BaseProbofCall);
+    _IsTuning = false;
+
+    //the acceptance ratio of these updates contains the ratio of ProbofCall of the pair
+    int Pairs[][2] = { { CREATE_WORM, DELETE_WORM },
+                       { ADD_INTERACTION, DEL_INTERACTION },
+                       { ADD_DELTA_INTERACTION, DEL_DELTA_INTERACTION },
+                       { CHANGE_MEASURE_G2W, CHANGE_MEASURE_W2G },
+                       { CHANGE_DELTA2CONTINUS, CHANGE_CONTINUS2DELTA },
+                       { JUMP_TO_ORDER0, JUMP_BACK_TO_ORDER1 } };
+    for (auto &pair : Pairs) {
+        _Partner[pair[0]] = pair[1];
+        _Partner[pair[1]] = pair[0];
     }
 
-    InitialArray(&Accepted[0][0], 0.0, NUpdates * MAX_ORDER);
-    InitialArray(&Proposed[0][0], 0.0, NUpdates * MAX_ORDER);
+    Accepted.assign(NUpdates, vector<real>(Order + 1, 0.0));
+    Proposed.assign(NUpdates, vector<real>(Order + 1, 0.0));
+    _LoopVer.assign(2 * Order + 1, nullptr);
+    _LoopFlagVer.assign(2 * Order, false);
+    _LoopFlagW.assign(Order, 0);
+    _LoopGWeight.assign(2 * Order, Complex(1.0, 0.0));
+    _LoopWWeight.assign(2 * Order, Complex(1.0, 0.0));
+#ifdef MARKOV_PROBE
+    _Probe.Clear();
+#endif
 
     OperationName[CREATE_WORM] = NAME(CREATE_WORM);
     OperationName[DELETE_WORM] = NAME(DELETE_WORM);
@@ -83,6 +146,63 @@ void Markov::Reset(ParaMC &para, Diagram &diag, weight::Weight &weight)
     G = weight.G;
     W = weight.W;
     RNG = &para.RNG;
+    if (_Update[0] != nullptr)
+        _BuildDispatchTable();
+}
+
+/**
+*  \brief normalize ProbofCall and build the alias table used by Hop;
+*  has to be called whenever ProbofCall is changed
+*/
+void Markov::_BuildDispatchTable()
+{
+    real Total = 0.0;
+    for (int i = 0; i < NUpdates; i++) {
+        ASSERT_ALLWAYS(ProbofCall[i] >= 0.0, OperationName[i] << " has negative ProbofCall!");
+        Total += ProbofCall[i];
+    }
+    ASSERT_ALLWAYS(Total > 0.0, "At least one update should be enabled!");
+
+    real Scaled[NUpdates];
+    int Small[NUpdates], Large[NUpdates];
+    int NSmall = 0, NLarge = 0;
+    real Sum = 0.0;
+    for (int i = 0; i < NUpdates; i++) {
+        ProbofCall[i] /= Total;
+        Sum += ProbofCall[i];
+        SumofProbofCall[i] = Sum;
+        Scaled[i] = ProbofCall[i] * NUpdates;
+        _Alias[i] = i;
+        if (Scaled[i] < 1.0)
+            Small[NSmall++] = i;
+        else
+            Large[NLarge++] = i;
+    }
+    while (NSmall > 0 && NLarge > 0) {
+        int s = Small[--NSmall], l = Large[--NLarge];
+        _AliasProb[s] = Scaled[s];
+        _Alias[s] = l;
+        Scaled[l] -= 1.0 - Scaled[s];
+        if (Scaled[l] < 1.0)
+            Small[NSmall++] = l;
+        else
+            Large[NLarge++] = l;
+    }
+    //whatever is left over only differs from 1 by rounding errors
+    while (NLarge > 0)
+        _AliasProb[Large[--NLarge]] = 1.0;
+    while (NSmall > 0)
+        _AliasProb[Small[--NSmall]] = 1.0;
+    //a disabled update must never be picked, not even through rounding errors
+    int Enabled = 0;
+    while (ProbofCall[Enabled] == 0.0)
+        Enabled++;
+    for (int i = 0; i < NUpdates; i++) {
+        if (ProbofCall[_Alias[i]] == 0.0)
+            _Alias[i] = Enabled;
+        if (ProbofCall[i] == 0.0)
+            _AliasProb[i] = 0.0;
+    }
 }
 
 std::string Markov::_DetailBalanceStr(Operations op)
@@ -191,6 +311,10 @@ void Markov::PrintDetailBalanceInfo()
     Output += _CheckBalance(CHANGE_MEASURE_G2W, CHANGE_MEASURE_W2G);
     Output += _CheckBalance(CHANGE_CONTINUS2DELTA, CHANGE_DELTA2CONTINUS);
     //    Output += _CheckBalance(JUMP_TO_ORDER0, JUMP_BACK_TO_ORDER1);
+#ifdef MARKOV_PROBE
+    Output += string(60, '-') + "\n";
+    Output += _Probe.Report(OperationName);
+#endif
     Output += string(60, '=') + "\n";
     LOG_INFO(Output);
 }
@@ -200,92 +324,151 @@ void Markov::PrintDetailBalanceInfo()
 *
 *  @param Steps
 */
+int Markov::UpdateIndex(const std::string &Name) const
+{
+    for (int op = 0; op < NUpdates; op++)
+        if (OperationName[op] == Name)
+            return op;
+    return -1;
+}
+
+real Markov::ProposedOf(int op) const
+{
+    real sum = 0.0;
+    for (auto p : Proposed[op])
+        sum += p;
+    return sum;
+}
+
+real Markov::AcceptedOf(int op) const
+{
+    real sum = 0.0;
+    for (auto a : Accepted[op])
+        sum += a;
+    return sum;
+}
+
+inline int Markov::_RandomPickUpdate()
+{
+    double x = RNG->urn() * NUpdates;
+    int op = int(x);
+    if (op >= NUpdates)
+        op = NUpdates - 1;
+    if (x - op >= _AliasProb[op])
+        op = _Alias[op];
+    return op;
+}
+
 void Markov::Hop(int sweep)
 {
     for (int i = 0; i < sweep; i++) {
-        double x = RNG->urn();
-        if (x < SumofProbofCall[CREATE_WORM])
-            CreateWorm();
-        //            ;
-        else if (x < SumofProbofCall[DELETE_WORM])
-            DeleteWorm();
-        //            ;
-        else if (x < SumofProbofCall[MOVE_WORM_G])
-            MoveWormOnG();
-        //            ;
-        else if (x < SumofProbofCall[MOVE_WORM_W])
-            MoveWormOnW();
-        //            ;
-        else if (x < SumofProbofCall[RECONNECT])
-            Reconnect();
-        //            ;
-        else if (x < SumofProbofCall[ADD_INTERACTION])
-            AddInteraction();
-        //            ;
-        else if (x < SumofProbofCall[DEL_INTERACTION])
-            DeleteInteraction();
-        //            ;
-        else if (x < SumofProbofCall[ADD_DELTA_INTERACTION])
-            AddDeltaInteraction();
-        //            ;
-        else if (x < SumofProbofCall[DEL_DELTA_INTERACTION])
-            DeleteDeltaInteraction();
-        //            ;
-        else if (x < SumofProbofCall[CHANGE_TAU_VERTEX])
-            ChangeTauOnVertex();
-        //            ;
-        else if (x < SumofProbofCall[CHANGE_R_VERTEX])
-            ;
-        //                    ChangeROnVertex();
-        else if (x < SumofProbofCall[CHANGE_R_LOOP])
-            ChangeRLoop();
-        //            ;
-        else if (x < SumofProbofCall[CHANGE_MEASURE_G2W])
-            ChangeMeasureFromGToW();
-        //            ;
-        else if (x < SumofProbofCall[CHANGE_MEASURE_W2G])
-            ChangeMeasureFromWToG();
-        //            ;
-        else if (x < SumofProbofCall[CHANGE_DELTA2CONTINUS])
-            ChangeDeltaToContinuous();
-        //            ;
-        else if (x < SumofProbofCall[CHANGE_CONTINUS2DELTA])
-            ChangeContinuousToDelta();
-        //            ;
-        else if (x < SumofProbofCall[CHANGE_SPIN_VERTEX])
-            ;
-        //            ChangeSpinOnVertex();
-        else if (x < SumofProbofCall[JUMP_TO_ORDER0])
-            JumpToOrder0();
-        //        ;
-        else if (x < SumofProbofCall[JUMP_BACK_TO_ORDER1])
-            JumpBackToOrder1();
-        //        ;
+        int op = _RandomPickUpdate();
+        PROBE_BEGIN(_Probe, op, Diag->Order);
+        (this->*_Update[op])();
+        PROBE_END(_Probe);
+        (*Counter)++;
+    }
+}
 
+/**
+*  \brief the same as Hop, but the time spent in every update is accumulated for AdaptProbofCall;
+*  only meant for the toss, where the timer costs nothing we care about
+*/
+void Markov::Tune(int sweep)
+{
+    if (!_IsTuning) {
+        for (int op = 0; op < NUpdates; op++) {
+            _TuneSeconds[op] = 0.0;
+            _TuneAccepted[op] = AcceptedOf(op);
+        }
+        _IsTuning = true;
+    }
+    for (int i = 0; i < sweep; i++) {
+        int op = _RandomPickUpdate();
+        auto start = chrono::steady_clock::now();
+        (this->*_Update[op])();
+        _TuneSeconds[op] += chrono::duration<double>(chrono::steady_clock::now() - start).count();
         (*Counter)++;
     }
 }
 
+/**
+*  \brief scale ProbofCall of every pair of updates by the accepted hops per second of the pair,
+*  relative to the average over all updates. The factor is bounded to [1/4, 4] of the probability
+*  given in BuildNew, so that no update is ever switched off and the chain stays ergodic.
+*  Both updates of a pair get the same factor, their ratio in the acceptance ratio does not change.
+*/
+void Markov::AdaptProbofCall()
+{
+    if (!_IsTuning)
+        return;
+    const real MinFactor = 0.25, MaxFactor = 4.0;
+    real Yield[NUpdates];
+    real Average = 0.0, Total = 0.0;
+    for (int op = 0; op < NUpdates; op++) {
+        Yield[op] = 0.0;
+        int partner = _Partner[op];
+        real Seconds = _TuneSeconds[op] + (partner == op ? 0.0 : _TuneSeconds[partner]);
+        if (Equal(Seconds, 0.0))
+            continue;
+        real Accepted = AcceptedOf(op) - _TuneAccepted[op];
+        if (partner != op)
+            Accepted += AcceptedOf(partner) - _TuneAccepted[partner];
+        Yield[op] = Accepted / Seconds;
+        Average += _BaseProbofCall[op] * Yield[op];
+        Total += _BaseProbofCall[op];
+    }
+    if (Equal(Total, 0.0) || Equal(Average, 0.0))
+        return;
+    Average /= Total;
+    for (int op = 0; op < NUpdates; op++) {
+        real Factor = Yield[op] / Average;
+        Factor = Factor < MinFactor ? MinFactor : (Factor > MaxFactor ? MaxFactor : Factor);
+        ProbofCall[op] = _BaseProbofCall[op] * Factor;
+    }
+    _BuildDispatchTable();
+}
+
+void Markov::FreezeProbofCall()
+{
+    AdaptProbofCall();
+    _IsTuning = false;
+    string Output = "ProbofCall is frozen to:\n";
+    char temp[80];
+    for (int op = 0; op < NUpdates; op++) {
+        sprintf(temp, "\t%25s:%15g%15g\n", OperationName[op].c_str(), _BaseProbofCall[op], ProbofCall[op]);
+        Output += temp;
+    }
+    LOG_INFO(Output);
+}
+
+void Markov::CopyProbofCall(const Markov &source)
+{
+    std::copy(source.ProbofCall, source.ProbofCall + NUpdates, ProbofCall);
+    _BuildDispatchTable();
+}
+
 /**
  *  Create Ira and Masha on a wline
  */
 void Markov::CreateWorm()
 {
     if (Diag->Order == 0 || Worm->Exist)
-        return;
+        REJECT(REJECT_STATE);
 
     wLine w = Diag->W.RandomPick(*RNG);
     vertex vin = w->NeighVer(IN);
     vertex vout = w->NeighVer(OUT);
 
-    Momentum kWorm = RandomPickK();
-    Momentum kW = w->K - kWorm;
-    if (Diag->WHashCheck(kW))
-        return;
+    int NFree = Diag->WFreeCount();
+    if (NFree == 0)
+        REJECT(REJECT_HASH);
+    Momentum kW = RandomPickFreeWK(NFree);
+    Momentum kWorm = w->K - kW;
 
     int dspin = RandomPickDeltaSpin();
     if (CanNotMoveWorm(dspin, vin->Spin(IN), vin->Spin(OUT)) && CanNotMoveWorm(-dspin, vout->Spin(IN), vout->Spin(OUT)))
-        return;
+        REJECT(REJECT_SPIN);
 
     Complex wWeight = W->Weight(vin->R, vout->R, vin->Tau, vout->Tau,
                                 vin->Spin(), vout->Spin(),
@@ -298,7 +481,7 @@ void Markov::CreateWorm()
 
     real wormWeight = weight::Worm::Weight(vin->R, vout->R, vin->Tau, vout->Tau);
 
-    prob *= ProbofCall[DELETE_WORM] / ProbofCall[CREATE_WORM] * (*WormSpaceReweight) * wormWeight * Diag->Order * 2.0;
+    prob *= ProbofCall[DELETE_WORM] / ProbofCall[CREATE_WORM] * (*WormSpaceReweight) * wormWeight * Diag->Order * 2.0 / ProbFreeWK(NFree);
 
     Proposed[CREATE_WORM][Diag->Order] += 1.0;
     if (prob >= 1.0 || RNG->urn() < prob) {
@@ -326,16 +509,16 @@ void Markov::CreateWorm()
 void Markov::DeleteWorm()
 {
     if (Diag->Order == 0 || !Worm->Exist)
-        return;
+        REJECT(REJECT_STATE);
     vertex &Ira = Worm->Ira;
     vertex &Masha = Worm->Masha;
 
     wLine w = Ira->NeighW();
     if (!(w == Masha->NeighW()))
-        return;
+        REJECT(REJECT_TOPOLOGY);
     Momentum k = w->K + SIGN(Ira->Dir) * Worm->K;
     if (Diag->WHashCheck(k))
-        return;
+        REJECT(REJECT_HASH);
 
     Complex wWeight = W->Weight(Ira->Dir, Ira->R, Masha->R, Ira->Tau, Masha->Tau,
                                 Ira->Spin(), Masha->Spin(),
@@ -346,7 +529,8 @@ void Markov::DeleteWorm()
     real prob = mod(weightRatio);
     Complex sgn = phase(weightRatio);
 
-    prob *= ProbofCall[CREATE_WORM] / (ProbofCall[DELETE_WORM] * (*WormSpaceReweight) * Worm->Weight * Diag->Order * 2.0);
+    //the number of free W momenta is the same before and after
+    prob *= ProbofCall[CREATE_WORM] * ProbFreeWK(Diag->WFreeCount()) / (ProbofCall[DELETE_WORM] * (*WormSpaceReweight) * Worm->Weight * Diag->Order * 2.0);
 
     Proposed[DELETE_WORM][Diag->Order] += 1.0;
     if (prob >= 1.0 || RNG->urn() < prob) {
@@ -369,7 +553,7 @@ void Markov::DeleteWorm()
 void Markov::MoveWormOnG()
 {
     if (Diag->Order == 0 || !Worm->Exist)
-        return;
+        REJECT(REJECT_STATE);
 
     vertex &Ira = Worm->Ira;
     vertex &Masha = Worm->Masha;
@@ -378,11 +562,13 @@ void Markov::MoveWormOnG()
     gLine g = Ira->NeighG(dir);
     vertex v2 = g->NeighVer(dir);
 
-    if (v2 == Ira || v2 == Masha || CanNotMoveWorm(Worm->dSpin, g->Spin(), dir))
-        return;
+    if (v2 == Ira || v2 == Masha)
+        REJECT(REJECT_TOPOLOGY);
+    if (CanNotMoveWorm(Worm->dSpin, g->Spin(), dir))
+        REJECT(REJECT_SPIN);
     Momentum k = g->K - SIGN(dir) * Worm->K;
     if (Diag->GHashCheck(k))
-        return;
+        REJECT(REJECT_HASH);
 
     wLine w1 = Ira->NeighW();
     vertex vW1 = w1->NeighVer(INVERSE(Ira->Dir));
@@ -450,7 +636,7 @@ void Markov::MoveWormOnG()
 void Markov::MoveWormOnW()
 {
     if (Diag->Order == 0 || !Worm->Exist)
-        return;
+        REJECT(REJECT_STATE);
 
     vertex &Ira = Worm->Ira;
     vertex &Masha = Worm->Masha;
@@ -458,10 +644,10 @@ void Markov::MoveWormOnW()
     wLine w = Ira->NeighW();
     vertex v2 = w->NeighVer(INVERSE(Ira->Dir));
     if (v2 == Ira || v2 == Masha)
-        return;
+        REJECT(REJECT_TOPOLOGY);
     Momentum k = w->K + SIGN(Ira->Dir) * Worm->K;
     if (Diag->WHashCheck(k))
-        return;
+        REJECT(REJECT_HASH);
 
     Complex wWeight = W->Weight(Ira->Dir, Ira->R, v2->R, Ira->Tau, v2->Tau, Ira->Spin(),
                                 v2->Spin(), w->IsWorm, w->IsMeasure, w->IsDelta);
@@ -494,18 +680,18 @@ void Markov::MoveWormOnW()
 void Markov::Reconnect()
 {
     if (Diag->Order == 0 || !Worm->Exist)
-        return;
+        REJECT(REJECT_STATE);
 
     vertex Ira = Worm->Ira;
     vertex Masha = Worm->Masha;
 
     if (!(Ira->R == Masha->R))
-        return;
+        REJECT(REJECT_TOPOLOGY);
     int dir = RandomPickDir();
     gLine GIA = Ira->NeighG(dir);
     gLine GMB = Masha->NeighG(dir);
     if (GIA->Spin() != GMB->Spin())
-        return;
+        REJECT(REJECT_SPIN);
 
     Momentum k = Worm->K + SIGN(dir) * (GMB->K - GIA->K);
 
@@ -549,14 +735,15 @@ void Markov::Reconnect()
 void Markov::AddInteraction()
 {
     if (!Worm->Exist)
-        return;
+        REJECT(REJECT_STATE);
     if (Diag->Order == 0 || Diag->Order >= Order)
-        return;
+        REJECT(REJECT_ORDER);
     vertex Ira = Worm->Ira, Masha = Worm->Masha;
 
-    Momentum kW = RandomPickK();
-    if (Diag->WHashCheck(kW))
-        return;
+    int NFree = Diag->WFreeCount();
+    if (NFree == 0)
+        REJECT(REJECT_HASH);
+    Momentum kW = RandomPickFreeWK(NFree);
 
     int dir = RandomPickDir();
     int dirW = RandomPickDir();
@@ -566,11 +753,11 @@ void Markov::AddInteraction()
     Momentum kMB = GMD->K + SIGN(dir) * SIGN(dirW) * kW;
     Momentum kWorm = Worm->K - SIGN(dirW) * kW;
     if (Diag->GHashCheck(kIA))
-        return;
+        REJECT(REJECT_HASH);
     if (Diag->GHashCheck(kMB))
-        return;
+        REJECT(REJECT_HASH);
     if (kIA == kMB)
-        return;
+        REJECT(REJECT_HASH);
 
     real tauA = RandomPickTau(), tauB = RandomPickTau();
 
@@ -603,7 +790,7 @@ void Markov::AddInteraction()
     real prob = mod(weightRatio);
     Complex sgn = phase(weightRatio);
 
-    prob *= OrderReWeight[Diag->Order + 1] * ProbofCall[DEL_INTERACTION] / (ProbofCall[ADD_INTERACTION] * OrderReWeight[Diag->Order] * ProbTau(tauA) * ProbTau(tauB));
+    prob *= OrderReWeight[Diag->Order + 1] * ProbofCall[DEL_INTERACTION] / (ProbofCall[ADD_INTERACTION] * OrderReWeight[Diag->Order] * ProbTau(tauA) * ProbTau(tauB) * ProbFreeWK(NFree));
 
     Proposed[ADD_INTERACTION][Diag->Order] += 1.0;
     if (prob >= 1.0 || RNG->urn() < prob) {
@@ -669,41 +856,41 @@ void Markov::AddInteraction()
 void Markov::DeleteInteraction()
 {
     if (!Worm->Exist)
-        return;
+        REJECT(REJECT_STATE);
     if (Diag->Order <= 1)
-        return;
+        REJECT(REJECT_ORDER);
     vertex Ira = Worm->Ira, Masha = Worm->Masha;
 
     int dir = RandomPickDir();
     gLine GIA = Ira->NeighG(dir), GMB = Masha->NeighG(dir);
     if (GIA->IsMeasure)
-        return;
+        REJECT(REJECT_TOPOLOGY);
     if (GMB->IsMeasure)
-        return;
+        REJECT(REJECT_TOPOLOGY);
 
     vertex vA = GIA->NeighVer(dir), vB = GMB->NeighVer(dir);
     if (vA->Spin(IN) != vA->Spin(OUT))
-        return;
+        REJECT(REJECT_SPIN);
     if (vB->Spin(IN) != vB->Spin(OUT))
-        return;
+        REJECT(REJECT_SPIN);
 
     if (vA->NeighW() != vB->NeighW())
-        return;
+        REJECT(REJECT_TOPOLOGY);
 
     wLine wAB = vA->NeighW();
     if (wAB->IsMeasure)
-        return;
+        REJECT(REJECT_TOPOLOGY);
     if (wAB->IsWorm)
-        return;
+        REJECT(REJECT_TOPOLOGY);
     if (wAB->IsDelta)
-        return;
+        REJECT(REJECT_TOPOLOGY);
 
     gLine GAC = vA->NeighG(dir), GBD = vB->NeighG(dir);
     vertex vC = GAC->NeighVer(dir), vD = GBD->NeighVer(dir);
     if (vA->R != vC->R)
-        return;
+        REJECT(REJECT_TOPOLOGY);
     if (vB->R != vD->R)
-        return;
+        REJECT(REJECT_TOPOLOGY);
 
     Momentum kWorm = Worm->K + SIGN(vA->Dir) * wAB->K;
 
@@ -718,7 +905,8 @@ void Markov::DeleteInteraction()
     real prob = mod(weightRatio);
     Complex sgn = phase(weightRatio);
 
-    prob *= OrderReWeight[Diag->Order - 1] * ProbofCall[ADD_INTERACTION] * ProbTau(vA->Tau) * ProbTau(vB->Tau) / (ProbofCall[DEL_INTERACTION] * OrderReWeight[Diag->Order]);
+    //wAB is gone after the update, its k and -k become free
+    prob *= OrderReWeight[Diag->Order - 1] * ProbofCall[ADD_INTERACTION] * ProbTau(vA->Tau) * ProbTau(vB->Tau) * ProbFreeWK(Diag->WFreeCount() + 2) / (ProbofCall[DEL_INTERACTION] * OrderReWeight[Diag->Order]);
 
     Proposed[DEL_INTERACTION][Diag->Order] += 1.0;
     if (prob >= 1.0 || RNG->urn() < prob) {
@@ -760,14 +948,15 @@ void Markov::DeleteInteraction()
 void Markov::AddDeltaInteraction()
 {
     if (!Worm->Exist)
-        return;
+        REJECT(REJECT_STATE);
     if (Diag->Order == 0 || Diag->Order >= Order)
-        return;
+        REJECT(REJECT_ORDER);
     vertex Ira = Worm->Ira, Masha = Worm->Masha;
 
-    Momentum kW = RandomPickK();
-    if (Diag->WHashCheck(kW))
-        return;
+    int NFree = Diag->WFreeCount();
+    if (NFree == 0)
+        REJECT(REJECT_HASH);
+    Momentum kW = RandomPickFreeWK(NFree);
 
     int dir = RandomPickDir();
     int dirW = RandomPickDir();
@@ -777,11 +966,11 @@ void Markov::AddDeltaInteraction()
     Momentum kMB = GMD->K + SIGN(dir) * SIGN(dirW) * kW;
     Momentum kWorm = Worm->K - SIGN(dirW) * kW;
     if (Diag->GHashCheck(kIA))
-        return;
+        REJECT(REJECT_HASH);
     if (Diag->GHashCheck(kMB))
-        return;
+        REJECT(REJECT_HASH);
     if (kIA == kMB)
-        return;
+        REJECT(REJECT_HASH);
 
     real tauA = RandomPickTau();
 
@@ -814,7 +1003,7 @@ void Markov::AddDeltaInteraction()
     real prob = mod(weightRatio);
     Complex sgn = phase(weightRatio);
 
-    prob *= OrderReWeight[Diag->Order + 1] * ProbofCall[DEL_DELTA_INTERACTION] / (ProbofCall[ADD_DELTA_INTERACTION] * OrderReWeight[Diag->Order] * ProbTau(tauA));
+    prob *= OrderReWeight[Diag->Order + 1] * ProbofCall[DEL_DELTA_INTERACTION] / (ProbofCall[ADD_DELTA_INTERACTION] * OrderReWeight[Diag->Order] * ProbTau(tauA) * ProbFreeWK(NFree));
 
     Proposed[ADD_DELTA_INTERACTION][Diag->Order] += 1.0;
     if (prob >= 1.0 || RNG->urn() < prob) {
@@ -880,41 +1069,41 @@ void Markov::AddDeltaInteraction()
 void Markov::DeleteDeltaInteraction()
 {
     if (!Worm->Exist)
-        return;
+        REJECT(REJECT_STATE);
     if (Diag->Order <= 1)
-        return;
+        REJECT(REJECT_ORDER);
     vertex Ira = Worm->Ira, Masha = Worm->Masha;
 
     int dir = RandomPickDir();
     gLine GIA = Ira->NeighG(dir), GMB = Masha->NeighG(dir);
     if (GIA->IsMeasure)
-        return;
+        REJECT(REJECT_TOPOLOGY);
     if (GMB->IsMeasure)
-        return;
+        REJECT(REJECT_TOPOLOGY);
 
     vertex vA = GIA->NeighVer(dir), vB = GMB->NeighVer(dir);
     if (vA->Spin(IN) != vA->Spin(OUT))
-        return;
+        REJECT(REJECT_SPIN);
     if (vB->Spin(IN) != vB->Spin(OUT))
-        return;
+        REJECT(REJECT_SPIN);
 
     if (vA->NeighW() != vB->NeighW())
-        return;
+        REJECT(REJECT_TOPOLOGY);
 
     wLine wAB = vA->NeighW();
     if (wAB->IsMeasure)
-        return;
+        REJECT(REJECT_TOPOLOGY);
     if (wAB->IsWorm)
-        return;
+        REJECT(REJECT_TOPOLOGY);
     if (!wAB->IsDelta)
-        return;
+        REJECT(REJECT_TOPOLOGY);
 
     gLine GAC = vA->NeighG(dir), GBD = vB->NeighG(dir);
     vertex vC = GAC->NeighVer(dir), vD = GBD->NeighVer(dir);
     if (vA->R != vC->R)
-        return;
+        REJECT(REJECT_TOPOLOGY);
     if (vB->R != vD->R)
-        return;
+        REJECT(REJECT_TOPOLOGY);
 
     Momentum kWorm = Worm->K + SIGN(vA->Dir) * wAB->K;
 
@@ -929,7 +1118,8 @@ void Markov::DeleteDeltaInteraction()
     real prob = mod(weightRatio);
     Complex sgn = phase(weightRatio);
 
-    prob *= OrderReWeight[Diag->Order - 1] * ProbofCall[ADD_DELTA_INTERACTION] * ProbTau(vA->Tau) / (ProbofCall[DEL_DELTA_INTERACTION] * OrderReWeight[Diag->Order]);
+    //wAB is gone after the update, its k and -k become free
+    prob *= OrderReWeight[Diag->Order - 1] * ProbofCall[ADD_DELTA_INTERACTION] * ProbTau(vA->Tau) * ProbFreeWK(Diag->WFreeCount() + 2) / (ProbofCall[DEL_DELTA_INTERACTION] * OrderReWeight[Diag->Order]);
 
     Proposed[DEL_DELTA_INTERACTION][Diag->Order] += 1.0;
     if (prob >= 1.0 || RNG->urn() < prob) {
@@ -969,11 +1159,11 @@ void Markov::DeleteDeltaInteraction()
 void Markov::ChangeTauOnVertex()
 {
     if (Diag->Order == 0 || Worm->Exist)
-        return;
+        REJECT(REJECT_STATE);
     vertex ver = Diag->Ver.RandomPick(*RNG);
     wLine w = ver->NeighW();
     if (w->IsDelta)
-        return;
+        REJECT(REJECT_TOPOLOGY);
 
     real tau = RandomPickTau();
 
@@ -1039,7 +1229,7 @@ void Markov::ChangeSpinOnVertex()
 {
     //TODO: If W is spin conserved, return;
     if (Diag->Order == 0 || Worm->Exist)
-        return;
+        REJECT(REJECT_STATE);
     vertex v1 = Diag->Ver.RandomPick(*RNG);
     wLine w1 = v1->NeighW();
     int dir = RandomPickDir();
@@ -1114,7 +1304,7 @@ void Markov::ChangeSpinOnVertex()
 void Markov::ChangeROnVertex()
 {
     if (Diag->Order == 0 || Worm->Exist)
-        return;
+        REJECT(REJECT_STATE);
     //TODO: Return if G is local
     vertex ver = Diag->Ver.RandomPick(*RNG);
     Site site = RandomPickSite();
@@ -1179,13 +1369,13 @@ void Markov::ChangeROnVertex()
 void Markov::ChangeRLoop()
 {
     if (Diag->Order == 0 || Worm->Exist)
-        return;
+        REJECT(REJECT_STATE);
     //TODO: If G is not a local function, return;
-    //TODO: use key word 'static' here to save time
-    ASSERT_ALLWAYS(Order <= MAX_ORDER, "Order is too high!");
-    vertex v[2 * MAX_ORDER] = {nullptr};
-    bool flagVer[2 * MAX_ORDER] = {false};
-    int flagW[MAX_ORDER] = {0};
+    vertex* v = _LoopVer.data();
+    char* flagVer = _LoopFlagVer.data();
+    int* flagW = _LoopFlagW.data();
+    std::fill(flagVer, flagVer + Diag->Ver.HowMany(), false);
+    std::fill(flagW, flagW + Diag->W.HowMany(), 0);
     int n = 0;
     v[0] = Diag->Ver.RandomPick(*RNG);
     Site oldR = v[0]->R;
@@ -1196,7 +1386,7 @@ void Markov::ChangeRLoop()
         v[n + 1] = v[n]->NeighG(OUT)->NeighVer(OUT);
 
         if (v[n + 1]->R != oldR)
-            return;
+            REJECT(REJECT_TOPOLOGY);
         n++;
     }
 
@@ -1205,9 +1395,9 @@ void Markov::ChangeRLoop()
     gLine g = nullptr;
     wLine w = nullptr;
 
-    //TODO: use key word 'static' here to save time
-    Complex GWeight[2 * MAX_ORDER] = {Complex(1.0, 0.0)};
-    Complex WWeight[2 * MAX_ORDER] = {Complex(1.0, 0.0)};
+    //every GWeight[i]/WWeight[i] with i<n is set below
+    Complex* GWeight = _LoopGWeight.data();
+    Complex* WWeight = _LoopWWeight.data();
 
     Complex oldWeight(1.0, 0.0);
     Complex newWeight(1.0, 0.0);
@@ -1271,11 +1461,11 @@ void Markov::ChangeRLoop()
 void Markov::ChangeMeasureFromGToW()
 {
     if (Diag->Order == 0 || Worm->Exist || !Diag->MeasureGLine)
-        return;
+        REJECT(REJECT_STATE);
 
     wLine w = Diag->W.RandomPick(*RNG);
     if (w->IsDelta)
-        return;
+        REJECT(REJECT_TOPOLOGY);
 
     gLine g = Diag->GMeasure;
     Complex gWeight = G->Weight(g->NeighVer(IN)->R, g->NeighVer(OUT)->R,
@@ -1321,13 +1511,13 @@ void Markov::ChangeMeasureFromGToW()
 void Markov::ChangeMeasureFromWToG()
 {
     if (Diag->Order == 0 || Worm->Exist || Diag->MeasureGLine)
-        return;
+        REJECT(REJECT_STATE);
 
     gLine g = Diag->G.RandomPick(*RNG);
 
     wLine w = Diag->WMeasure;
     if (w->IsDelta)
-        return;
+        REJECT(REJECT_TOPOLOGY);
 
     Complex gWeight = G->Weight(g->NeighVer(IN)->R, g->NeighVer(OUT)->R,
                                 g->NeighVer(IN)->Tau, g->NeighVer(OUT)->Tau,
@@ -1371,10 +1561,10 @@ void Markov::ChangeMeasureFromWToG()
 void Markov::ChangeDeltaToContinuous()
 {
     if (Diag->Order < 2 || Worm->Exist)
-        return;
+        REJECT(REJECT_STATE);
     wLine w = Diag->W.RandomPick(*RNG);
     if ((!w->IsDelta) || w->IsMeasure)
-        return;
+        REJECT(REJECT_TOPOLOGY);
     vertex vin = w->NeighVer(IN), vout = w->NeighVer(OUT);
     gLine G1 = vout->NeighG(IN), G2 = vout->NeighG(OUT);
     real tau = RandomPickTau();
@@ -1430,11 +1620,11 @@ void Markov::ChangeDeltaToContinuous()
 void Markov::ChangeContinuousToDelta()
 {
     if (Diag->Order < 2 || Worm->Exist)
-        return;
+        REJECT(REJECT_STATE);
 
     wLine w = Diag->W.RandomPick(*RNG);
     if (w->IsDelta || w->IsMeasure)
-        return;
+        REJECT(REJECT_TOPOLOGY);
 
     vertex vin = w->NeighVer(IN), vout = w->NeighVer(OUT);
     gLine G1 = vout->NeighG(IN), G2 = vout->NeighG(OUT);
@@ -1487,12 +1677,12 @@ void Markov::ChangeContinuousToDelta()
 void Markov::JumpToOrder0()
 {
     if (Worm->Exist || Diag->Order != 1)
-        return;
+        REJECT(REJECT_STATE);
 
     vertex Ver1 = &Diag->Ver[0];
     vertex Ver2 = &Diag->Ver[1];
     if (Ver1->R != Ver2->R)
-        return;
+        REJECT(REJECT_TOPOLOGY);
 
     Complex weightRatio;
     weightRatio = weight::Norm::Weight() / Diag->Weight;
@@ -1514,7 +1704,7 @@ void Markov::JumpToOrder0()
 void Markov::JumpBackToOrder1()
 {
     if (Worm->Exist || Diag->Order != 0)
-        return;
+        REJECT(REJECT_STATE);
 
     Site R = RandomPickSite();
     real Tau1 = RandomPickTau();
@@ -1567,6 +1757,30 @@ Momentum Markov::RandomPickK()
     return (Momentum)(RNG->irn(-MAX_K, MAX_K));
 }
 
+/**
+*  \brief uniform over the NFree momenta not occupied by any W line, drawn directly from the free slots
+*  of WHash, so the cost does not depend on how many of them are taken
+*
+*  @param NFree Diag->WFreeCount(), which has to be positive
+*/
+Momentum Markov::RandomPickFreeWK(int NFree)
+{
+    //every free slot abs(k)>0 of WHash gives k and -k, the slot of k=0 is never free
+    int n = RNG->irn(0, NFree - 1);
+    int slot = Diag->WHash.SelectFree(n / 2 + !Diag->WHash.Test(0));
+    return Momentum(n % 2 == 0 ? slot : -slot);
+}
+
+/**
+*  \brief probability of RandomPickFreeWK relative to RandomPickK, which the weights are normalized to
+*
+*  @param NFree number of free W momenta in the diagram without the new W line
+*/
+real Markov::ProbFreeWK(int NFree)
+{
+    return real(2 * MAX_K + 1) / NFree;
+}
+
 int Markov::RandomPickDeltaSpin()
 {
     return RNG->irn(0, 1) * 2 - 1;
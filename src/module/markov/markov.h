@@ -10,9 +10,13 @@
 #define __Feynman_Simulator__markov__
 
 #include <string>
+#include <vector>
 #include "utility/convention.h"
+#include "utility/complex.h"
+#include "markov_probe.h"
 
 namespace diag {
+class Vertex;
 class WormClass;
 class Diagram;
 }
@@ -36,6 +40,7 @@ namespace mc {
 const int NUpdates = 19;
 class Markov {
 public:
+    Markov();
     long long* Counter;
     real Beta;
     int Order;
@@ -54,7 +59,20 @@ public:
     bool BuildNew(para::ParaMC&, diag::Diagram&, weight::Weight&);
     void Reset(para::ParaMC&, diag::Diagram&, weight::Weight&);
     void Hop(int);
+    //adaptive ProbofCall for the toss: Tune hops like Hop and times every update,
+    //AdaptProbofCall reweights updates by accepted hops per second, FreezeProbofCall ends the tuning
+    void Tune(int);
+    void AdaptProbofCall();
+    void FreezeProbofCall();
+    void CopyProbofCall(const Markov&);
     void PrintDetailBalanceInfo();
+    //index of an update by its name in OperationName, -1 if there is no such update
+    int UpdateIndex(const std::string& Name) const;
+    //number of proposed/accepted calls of an update, summed over all orders
+    real ProposedOf(int op) const;
+    real AcceptedOf(int op) const;
+    //normalized probability to pick an update in a hop
+    real ProbabilityOf(int op) const { return ProbofCall[op]; }
 
     void CreateWorm();
     void DeleteWorm();
@@ -80,12 +98,39 @@ private:
     real ProbofCall[NUpdates];
     real SumofProbofCall[NUpdates];
     std::string OperationName[NUpdates];
-    real Accepted[NUpdates][MAX_ORDER];
-    real Proposed[NUpdates][MAX_ORDER];
+    //[update][order], sized by Order in BuildNew
+    std::vector<std::vector<real> > Accepted;
+    std::vector<std::vector<real> > Proposed;
+
+    //dispatch table: Walker's alias method over Operations, one urn per hop
+    typedef void (Markov::*Update)();
+    Update _Update[NUpdates];
+    real _AliasProb[NUpdates];
+    int _Alias[NUpdates];
+    void _BuildDispatchTable();
+    int _RandomPickUpdate();
+
+    //each update and its reverse update are tuned by the same factor, to keep their ratio of ProbofCall
+    int _Partner[NUpdates];
+    real _BaseProbofCall[NUpdates];
+    real _TuneSeconds[NUpdates];
+    real _TuneAccepted[NUpdates]; //AcceptedOf when the tuning started
+    bool _IsTuning;
+
+    //scratch buffers of ChangeRLoop, sized by Order in BuildNew
+    std::vector<diag::Vertex*> _LoopVer;
+    std::vector<char> _LoopFlagVer;
+    std::vector<int> _LoopFlagW;
+    std::vector<Complex> _LoopGWeight, _LoopWWeight;
+#ifdef MARKOV_PROBE
+    MarkovProbe<NUpdates> _Probe;
+#endif
 
     int RandomPickDeltaSpin();
     spin RandomPickSpin();
     Momentum RandomPickK();
+    Momentum RandomPickFreeWK(int NFree);
+    real ProbFreeWK(int NFree);
     int RandomPickDir();
     real RandomPickTau();
     real ProbTau(real);
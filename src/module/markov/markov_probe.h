@@ -0,0 +1,139 @@
+//
+//  markov_probe.h
+//  Feynman_Simulator
+//
+//  Created by Kun Chen on 3/4/15.
+//  Copyright (c) 2015 Kun Chen. All rights reserved.
+//
+
+#ifndef __Feynman_Simulator__markov_probe__
+#define __Feynman_Simulator__markov_probe__
+
+/**
+*  Instrumentation of Markov::Hop, only compiled in with MARKOV_PROBE (see utility/convention.h).
+*  For every update and every order it records the number of calls, the ticks spent in the update,
+*  the number of G/W weight lookups and why the update returned before the Metropolis test.
+*  Without MARKOV_PROBE all PROBE_* macros expand to nothing.
+*/
+
+#include "utility/convention.h"
+
+namespace mc {
+//why an update returned before it proposed anything
+enum RejectReason {
+    REJECT_STATE = 0, //worm or order of the diagram does not allow the update
+    REJECT_ORDER, //the new diagram would leave [1, Order]
+    REJECT_HASH, //momentum conflicts with an existing line
+    REJECT_SPIN, //spin of the vertices does not allow the update
+    REJECT_TOPOLOGY, //lines/vertices picked are not of the right kind
+    NREJECT
+};
+}
+
+#ifdef MARKOV_PROBE
+
+#include <string>
+#include <stdio.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+namespace weight {
+//counted in GClass::Weight and WClass::Weight
+extern thread_local long long NWeightLookup;
+}
+
+namespace mc {
+template <int NOp>
+class MarkovProbe {
+public:
+    MarkovProbe() { Clear(); }
+    void Clear()
+    {
+        for (int op = 0; op < NOp; op++)
+            for (int i = 0; i < MAX_ORDER; i++) {
+                Calls[op][i] = Ticks[op][i] = Lookups[op][i] = 0;
+                for (int r = 0; r < NREJECT; r++)
+                    Rejected[op][i][r] = 0;
+            }
+        _Op = -1;
+    }
+    //rdtsc where it is available, otherwise nanoseconds
+    static long long Tick()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return (long long)__rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+    void Begin(int op, int order)
+    {
+        _Op = op;
+        _Order = order;
+        _Lookup = weight::NWeightLookup;
+        _Tick = Tick();
+    }
+    void End()
+    {
+        Ticks[_Op][_Order] += Tick() - _Tick;
+        Lookups[_Op][_Order] += weight::NWeightLookup - _Lookup;
+        Calls[_Op][_Order]++;
+        _Op = -1;
+    }
+    //updates called outside of Begin/End are not recorded
+    void Reject(RejectReason reason)
+    {
+        if (_Op >= 0)
+            Rejected[_Op][_Order][reason]++;
+    }
+    std::string Report(const std::string* OperationName) const
+    {
+        std::string Output = "Probe: calls, ticks/call, lookups/call, rejected by state/order/hash/spin/topology\n";
+        char temp[160];
+        for (int op = 0; op < NOp; op++) {
+            std::string Lines;
+            for (int i = 0; i < MAX_ORDER; i++) {
+                if (Calls[op][i] == 0)
+                    continue;
+                const long long* r = Rejected[op][i];
+                sprintf(temp, "\t%8s%2i:%12lld%12.1f%8.2f%12lld%12lld%12lld%12lld%12lld\n", "Order", i,
+                        Calls[op][i], double(Ticks[op][i]) / Calls[op][i], double(Lookups[op][i]) / Calls[op][i],
+                        r[REJECT_STATE], r[REJECT_ORDER], r[REJECT_HASH], r[REJECT_SPIN], r[REJECT_TOPOLOGY]);
+                Lines += temp;
+            }
+            if (!Lines.empty())
+                Output += OperationName[op] + ":\n" + Lines;
+        }
+        return Output;
+    }
+
+    long long Calls[NOp][MAX_ORDER];
+    long long Ticks[NOp][MAX_ORDER];
+    long long Lookups[NOp][MAX_ORDER];
+    long long Rejected[NOp][MAX_ORDER][NREJECT];
+
+private:
+    int _Op, _Order;
+    long long _Tick, _Lookup;
+};
+}
+
+#define PROBE_BEGIN(probe, op, order) (probe).Begin(op, order)
+#define PROBE_END(probe) (probe).End()
+#define PROBE_REJECT(probe, reason) (probe).Reject(reason)
+#define PROBE_LOOKUP() weight::NWeightLookup++
+
+#else
+
+#define PROBE_BEGIN(probe, op, order)
+#define PROBE_END(probe)
+#define PROBE_REJECT(probe, reason)
+#define PROBE_LOOKUP()
+
+#endif
+
+#endif /* defined(__Feynman_Simulator__markov_probe__) */
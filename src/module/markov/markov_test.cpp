@@ -16,12 +16,14 @@ using namespace std;
 using namespace mc;
 
 void Test_Updates();
+void Test_Tune();
 
 int mc::TestMarkov()
 {
     sput_start_testing();
     sput_enter_suite("Test Updates:");
     sput_run_test(Test_Updates);
+    sput_run_test(Test_Tune);
     sput_finish_testing();
     return sput_get_return_value();
 }
@@ -41,6 +43,7 @@ void Test_Updates()
     system("mkdir diagram");
     sput_fail_unless(Diag.CheckDiagram(), "Check diagram G,W,Ver and Weight");
     sput_fail_if(Equal(Diag.Weight, Complex(0.0, 0.0)), "Initialize diagram has nonzero weight");
+    long long Counter = Para.Counter;
     for (int i = 0; i < 100; i++) {
         markov.Hop(100);
 
@@ -48,5 +51,54 @@ void Test_Updates()
         //        Diag.WriteDiagram2gv("diagram/" + ToString(Para.Counter) + ".gv");
         //        markov.PrintDetailBalanceInfo();
     }
+    sput_fail_unless(Para.Counter == Counter + 100 * 100, "Every hop is counted once");
     LOG_INFO("Updates Check are done!");
 }
+
+void Test_Tune()
+{
+    para::ParaMC Para;
+    Para.SetTest();
+    weight::Weight Weight(true);
+    Weight.SetTest(Para);
+    diag::Diagram Diag;
+    Diag.SetTest(Para.Lat, *Weight.G, *Weight.W);
+    Markov markov;
+    markov.BuildNew(Para, Diag, Weight);
+
+    real Base[NUpdates];
+    for (int op = 0; op < NUpdates; op++)
+        Base[op] = markov.ProbabilityOf(op);
+    for (int i = 0; i < 50; i++) {
+        markov.Tune(100);
+        markov.AdaptProbofCall();
+    }
+    markov.FreezeProbofCall();
+    sput_fail_unless(markov.Diag->CheckDiagram(), "Check diagram after tuning");
+
+    int Create = markov.UpdateIndex("CREATE_WORM"), Delete = markov.UpdateIndex("DELETE_WORM");
+    int Add = markov.UpdateIndex("ADD_INTERACTION"), Del = markov.UpdateIndex("DEL_INTERACTION");
+    sput_fail_unless(Equal(markov.ProbabilityOf(Create) / markov.ProbabilityOf(Delete), Base[Create] / Base[Delete], 1e-10),
+                     "CREATE_WORM/DELETE_WORM keep their ratio");
+    sput_fail_unless(Equal(markov.ProbabilityOf(Add) / markov.ProbabilityOf(Del), Base[Add] / Base[Del], 1e-10),
+                     "ADD_INTERACTION/DEL_INTERACTION keep their ratio");
+
+    real Sum = 0.0, MinFactor = 1e10, MaxFactor = 0.0;
+    bool IsDisabledKept = true;
+    for (int op = 0; op < NUpdates; op++) {
+        real p = markov.ProbabilityOf(op);
+        Sum += p;
+        if (Equal(Base[op], 0.0)) {
+            IsDisabledKept &= Equal(p, 0.0);
+            continue;
+        }
+        MinFactor = min(MinFactor, p / Base[op]);
+        MaxFactor = max(MaxFactor, p / Base[op]);
+    }
+    sput_fail_unless(Equal(Sum, 1.0, 1e-10), "ProbofCall is normalized");
+    sput_fail_unless(IsDisabledKept, "Disabled updates stay disabled");
+    sput_fail_unless(MinFactor > 0.0 && MaxFactor / MinFactor <= 16.0 + 1e-10, "No update is switched off");
+
+    markov.Hop(1000);
+    sput_fail_unless(markov.Diag->CheckDiagram(), "Check diagram after hopping with frozen ProbofCall");
+}
@@ -82,8 +82,18 @@ bool ParaMC::FromDict(const Dictionary& Para)
     GET_WITH_DEFAULT(_para, Seed, 0);
     if (_para.HasKey("RNG"))
         GET(_para, RNG);
-    else
-        RNG.Reset(Seed);
+    else {
+        //a new job, its engine is kept in the state of RNG afterwards
+        string Engine = _para.HasKey("RNGEngine") ? _para.Get<string>("RNGEngine") : "MT19937";
+        if (Engine == "Philox")
+            RNG.Reset((unsigned int)Seed, 0);
+        else if (Engine == "MT19937") {
+            RNG.SetEngine(MT19937);
+            RNG.Reset(Seed);
+        }
+        else
+            ABORT("I don't know what is RNGEngine " << Engine << "?");
+    }
     ASSERT_ALLWAYS(Order < MAX_ORDER, "Order can not be bigger than " << MAX_ORDER);
     ASSERT_ALLWAYS(OrderReWeight.size() >= Order + 1, "OrderReWeight should have Order+1 elementes!");
 
@@ -138,3 +148,41 @@ void ParaMC::SetTest()
     Counter = 0;
     MaxTauBin = 32;
 }
+
+bool ParaDyson::FromDict(const Dictionary& Para)
+{
+    Parameter::_FromDict(Para);
+    Order = 1;
+    NThread = 0;
+    if (Para.HasKey("Dyson")) {
+        auto _para = Para.Get<Dictionary>("Dyson");
+        GET_WITH_DEFAULT(_para, Order, 1);
+        GET_WITH_DEFAULT(_para, NThread, 0);
+    }
+    return true;
+}
+
+Dictionary ParaDyson::ToDict()
+{
+    Dictionary _para;
+    SET(_para, Order);
+    SET(_para, NThread);
+    Dictionary Para;
+    Para["Dyson"] = _para;
+    Para.Update(Parameter::_ToDict());
+    return Para;
+}
+
+void ParaDyson::SetTest()
+{
+    Version = 0;
+    int size[2] = { 4, 4 };
+    NSublat = 2;
+    L = Vec<int>(size);
+    Lat = Lattice(L, NSublat);
+    Beta = 1.0;
+    T = 1.0 / Beta;
+    Order = 1;
+    MaxTauBin = 16;
+    NThread = 2;
+}
@@ -63,5 +63,14 @@ public:
     Dictionary ToDict();
     void SetTest();
 };
+
+class ParaDyson : public Parameter {
+public:
+    int NThread; //threads of the Dyson solver, 0 for all cores
+
+    bool FromDict(const Dictionary&);
+    Dictionary ToDict();
+    void SetTest();
+};
 }
 #endif /* defined(__Feynman_Simulator__state__) */
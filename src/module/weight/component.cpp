@@ -48,11 +48,21 @@ bool GClass::FromDict(const Dictionary& dict)
     return _SmoothTWeight.FromDict(dict);
 }
 
+bool GClass::FromCheckpoint(const CheckpointReader& reader, const string& Path)
+{
+    return _SmoothTWeight.FromCheckpoint(reader, Path);
+}
+
 Dictionary GClass::ToDict()
 {
     return _SmoothTWeight.ToDict();
 }
 
+void GClass::TakeDirty(DirtyMap& Dirty, const string& Path)
+{
+    Dirty[Path + "/" + SMOOTH] = _SmoothTWeight.TakeDirty();
+}
+
 WClass::WClass(const Lattice& lat, real Beta, uint MaxTauBin)
     : _Map(IndexMapSPIN4(Beta, MaxTauBin, lat, TauSymmetric))
 {
@@ -90,6 +100,11 @@ bool WClass::FromDict(const Dictionary& dict)
     return _SmoothTWeight.FromDict(dict) && _DeltaTWeight.FromDict(dict);
 }
 
+bool WClass::FromCheckpoint(const CheckpointReader& reader, const string& Path)
+{
+    return _SmoothTWeight.FromCheckpoint(reader, Path) && _DeltaTWeight.FromCheckpoint(reader, Path);
+}
+
 Dictionary WClass::ToDict()
 {
     auto dict = _SmoothTWeight.ToDict();
@@ -97,6 +112,12 @@ Dictionary WClass::ToDict()
     return dict;
 }
 
+void WClass::TakeDirty(DirtyMap& Dirty, const string& Path)
+{
+    Dirty[Path + "/" + SMOOTH] = _SmoothTWeight.TakeDirty();
+    Dirty[Path + "/" + DELTA] = _DeltaTWeight.TakeDirty();
+}
+
 SigmaClass::SigmaClass(const Lattice& lat, real Beta, uint MaxTauBin,
              int MaxOrder, TauSymmetry Symmetry, real Norm)
     : _Map(IndexMapSPIN2(Beta, MaxTauBin, lat, Symmetry))
@@ -132,6 +153,11 @@ Dictionary SigmaClass::ToDict()
     return dict;
 }
 
+void SigmaClass::TakeDirty(DirtyMap& Dirty, const string& Path)
+{
+    Estimator.TakeDirty(Dirty, Path + "/Histogram/SmoothT");
+}
+
 PolarClass::PolarClass(const Lattice& lat, real Beta, uint MaxTauBin, int MaxOrder, real Norm)
     : _Map(IndexMapSPIN4(Beta, MaxTauBin, lat, TauSymmetric))
 {
@@ -165,3 +191,8 @@ Dictionary PolarClass::ToDict()
     dict["Histogram"] = Dictionary("SmoothT", Estimator.ToDict());
     return dict;
 }
+
+void PolarClass::TakeDirty(DirtyMap& Dirty, const string& Path)
+{
+    Estimator.TakeDirty(Dirty, Path + "/Histogram/SmoothT");
+}
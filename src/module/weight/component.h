@@ -43,7 +43,9 @@ class GClass{
     void BuildTest();
     void Reset(real Beta);
     bool FromDict(const Dictionary &);
+    bool FromCheckpoint(const CheckpointReader &, const std::string &Path);
     Dictionary ToDict();
+    void TakeDirty(DirtyMap &, const std::string &Path);
 
     Complex Weight(const Site &, const Site &, real, real, spin, spin, bool) const;
     Complex Weight(int, const Site &, const Site &, real, real, spin, spin, bool) const;
@@ -65,7 +67,9 @@ class WClass {
     void WriteBareToASCII();
     void Reset(real Beta);
     bool FromDict(const Dictionary &);
+    bool FromCheckpoint(const CheckpointReader &, const std::string &Path);
     Dictionary ToDict();
+    void TakeDirty(DirtyMap &, const std::string &Path);
 
     Complex Weight(const Site &, const Site &, real, real, spin *, spin *, bool, bool, bool) const;
     Complex Weight(int, const Site &, const Site &, real, real, spin *, spin *, bool, bool, bool) const;
@@ -87,6 +91,7 @@ class SigmaClass {
     void Reset(real Beta);
     bool FromDict(const Dictionary &);
     Dictionary ToDict();
+    void TakeDirty(DirtyMap &, const std::string &Path);
 
     void Measure(const Site &, const Site &, real, real, spin, spin,
                  int Order, const Complex &);
@@ -105,6 +110,7 @@ class PolarClass {
     void Reset(real Beta);
     bool FromDict(const Dictionary &);
     Dictionary ToDict();
+    void TakeDirty(DirtyMap &, const std::string &Path);
 
     void Measure(const Site &, const Site &, real, real, spin *, spin *,
                  int Order, const Complex &);
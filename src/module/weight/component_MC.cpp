@@ -7,14 +7,20 @@
 //
 
 #include "component.h"
+#include "module/markov/markov_probe.h"
 
 using namespace weight;
 using namespace std;
 
 const spin SPINUPUP[2] = { UP, UP };
 
+#ifdef MARKOV_PROBE
+thread_local long long weight::NWeightLookup = 0;
+#endif
+
 Complex GClass::Weight(const Site& rin, const Site& rout, real tin, real tout, spin SpinIn, spin SpinOut, bool IsMeasure) const
 {
+    PROBE_LOOKUP();
     uint Index = _Map.GetIndex(SpinIn, SpinOut, rin, rout, tin, tout);
     if (IsMeasure)
         return _MeasureWeight(Index);
@@ -24,7 +30,8 @@ Complex GClass::Weight(const Site& rin, const Site& rout, real tin, real tout, s
 
 Complex GClass::Weight(int dir, const Site& r1, const Site& r2, real t1, real t2, spin Spin1, spin Spin2, bool IsMeasure) const
 {
-    static uint Index;
+    PROBE_LOOKUP();
+    uint Index;
     int symmetryfactor;
     if (dir == IN) {
         Index = _Map.GetIndex(Spin1, Spin2, r1, r2, t1, t2);
@@ -43,7 +50,8 @@ Complex GClass::Weight(int dir, const Site& r1, const Site& r2, real t1, real t2
 
 Complex WClass::Weight(const Site& rin, const Site& rout, real tin, real tout, spin* SpinIn, spin* SpinOut, bool IsWorm, bool IsMeasure, bool IsDelta) const
 {
-    static uint index;
+    PROBE_LOOKUP();
+    uint index;
     if (IsWorm) {
         //it is safe to reassign pointer here, the original spins pointed by SpinIn and SpinOut pointers will not change
         SpinIn = (spin*)SPINUPUP;
@@ -62,7 +70,8 @@ Complex WClass::Weight(const Site& rin, const Site& rout, real tin, real tout, s
 
 Complex WClass::Weight(int dir, const Site& r1, const Site& r2, real t1, real t2, spin* Spin1, spin* Spin2, bool IsWorm, bool IsMeasure, bool IsDelta) const
 {
-    static uint index;
+    PROBE_LOOKUP();
+    uint index;
     if (IsWorm) {
         Spin1 = (spin*)SPINUPUP;
         Spin2 = (spin*)SPINUPUP;
@@ -88,14 +97,12 @@ Complex WClass::Weight(int dir, const Site& r1, const Site& r2, real t1, real t2
 
 void SigmaClass::Measure(const Site& rin, const Site& rout, real tin, real tout, spin SpinIn, spin SpinOut, int order, const Complex& weight)
 {
-    static uint index;
-    index = _Map.GetIndex(SpinIn, SpinOut, rin, rout, tin, tout);
+    uint index = _Map.GetIndex(SpinIn, SpinOut, rin, rout, tin, tout);
     Estimator.Measure(index, order, weight * _Map.GetTauSymmetryFactor(tin, tout));
 }
 
 void PolarClass::Measure(const Site& rin, const Site& rout, real tin, real tout, spin* SpinIn, spin* SpinOut, int order, const Complex& weight)
 {
-    static uint index;
-    index = _Map.GetIndex(SpinIn, SpinOut, rin, rout, tin, tout);
+    uint index = _Map.GetIndex(SpinIn, SpinOut, rin, rout, tin, tout);
     Estimator.Measure(index, order, weight);
 }
@@ -26,6 +26,20 @@ IndexMap::IndexMap(real Beta_, uint MaxTauBin_, const Lattice& lat, TauSymmetry
     _Shape[SUB2] = (uint)Lat.SublatVol;
     _Shape[VOL] = (uint)Lat.Vol;
     _Shape[TAU] = MaxTauBin;
+    _BuildCoordiTable();
+}
+
+void IndexMap::_BuildCoordiTable()
+{
+    int Stride = 1;
+    for (int i = D - 1; i >= 0; i--) {
+        int Size = Lat.Size[i];
+        _CoordiOffset[i] = Size - 1;
+        _CoordiTable[i].resize(2 * Size - 1);
+        for (int d = -(Size - 1); d < Size; d++)
+            _CoordiTable[i][d + _CoordiOffset[i]] = (d < 0 ? d + Size : d) * Stride;
+        Stride *= Size;
+    }
 }
 
 int IndexMap::GetTauSymmetryFactor(real t_in, real t_out) const
@@ -40,8 +54,11 @@ int IndexMap::TauIndex(real tau) const
                         << -Beta << "," << Beta << ")");
     //TODO: mapping between tau and bin
 
-    int bin = tau < 0 ? floor(tau * _dBetaInverse) + MaxTauBin
-                      : floor(tau * _dBetaInverse);
+    //floor without a call or branch, identical to floor() within the range of int
+    real x = tau * _dBetaInverse;
+    int bin = int(x);
+    bin -= (x < bin);
+    bin += (tau < 0) * MaxTauBin;
     if (DEBUGMODE && (bin < 0 || bin >= MaxTauBin)) {
         LOG_INFO("tau=" << tau << " is out of the range ["
                         << -Beta << "," << Beta << ")");
@@ -102,7 +119,7 @@ bool IndexMapSPIN2::IsSameSpin(int spindex)
 uint IndexMapSPIN2::GetIndex(spin in, spin out, const Site& rin, const Site& rout,
                              real tin, real tout) const
 {
-    auto coord = Lat.CoordiIndex(rin, rout);
+    auto coord = CoordiIndex(rin, rout);
     uint Index = in * _CacheSmoothT[SP1] + rin.Sublattice * _CacheSmoothT[SUB1]
                  + out * _CacheSmoothT[SP2] + rout.Sublattice * _CacheSmoothT[SUB2]
                  + coord * _CacheSmoothT[VOL] + TauIndex(tin, tout);
@@ -114,7 +131,7 @@ uint IndexMapSPIN2::GetIndex(spin in, spin out, const Site& rin, const Site& rou
 uint IndexMapSPIN2::GetIndex(spin in, spin out,
                              const Site& rin, const Site& rout) const
 {
-    auto coord = Lat.CoordiIndex(rin, rout);
+    auto coord = CoordiIndex(rin, rout);
     uint Index = in * _CacheDeltaT[SP1] + rin.Sublattice * _CacheDeltaT[SUB1]
                  + out * _CacheDeltaT[SP2] + rout.Sublattice * _CacheDeltaT[SUB2]
                  + coord;
@@ -149,7 +166,7 @@ int IndexMapSPIN4::SpinIndex(const spin* Spin)
 
 uint IndexMapSPIN4::GetIndex(const spin* SpinIn, const spin* SpinOut, const Site& rin, const Site& rout, real tin, real tout) const
 {
-    auto coord = Lat.CoordiIndex(rin, rout);
+    auto coord = CoordiIndex(rin, rout);
     uint Index = SpinIndex(SpinIn) * _CacheSmoothT[SP1] + rin.Sublattice * _CacheSmoothT[SUB1]
                  + SpinIndex(SpinOut) * _CacheSmoothT[SP2] + rout.Sublattice * _CacheSmoothT[SUB2] + coord * _CacheSmoothT[VOL] + TauIndex(tin, tout);
     if (DEBUGMODE && Index >= _SizeSmoothT)
@@ -159,7 +176,7 @@ uint IndexMapSPIN4::GetIndex(const spin* SpinIn, const spin* SpinOut, const Site
 
 uint IndexMapSPIN4::GetIndex(const spin* SpinIn, const spin* SpinOut, const Site& rin, const Site& rout) const
 {
-    auto coord = Lat.CoordiIndex(rin, rout);
+    auto coord = CoordiIndex(rin, rout);
     uint Index = SpinIndex(SpinIn) * _CacheDeltaT[SP1] + rin.Sublattice * _CacheDeltaT[SUB1]
                  + SpinIndex(SpinOut) * _CacheDeltaT[SP2] + rout.Sublattice * _CacheDeltaT[SUB2]
                  + coord;
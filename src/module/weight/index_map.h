@@ -11,6 +11,7 @@
 
 #include "utility/convention.h"
 #include "lattice/lattice.h"
+#include <vector>
 
 namespace weight {
 
@@ -46,9 +47,21 @@ public:
     int TauIndex(real tau) const;
     int TauIndex(real t_in, real t_out) const;
     real IndexToTau(int TauIndex) const;
+    //the same as Lat.CoordiIndex, summed from tables of wrapped coordinate differences of each dimension
+    int CoordiIndex(const Site& rin, const Site& rout) const
+    {
+        int Index = 0;
+        for (int i = 0; i < D; i++)
+            Index += _CoordiTable[i][rout.Coordinate[i] - rin.Coordinate[i] + _CoordiOffset[i]];
+        return Index;
+    }
 
 protected:
     void _UpdateCache();
+    void _BuildCoordiTable();
+    //_CoordiTable[i][d+_CoordiOffset[i]] is the contribution of the difference d in the i-th dimension to Lat.CoordiIndex
+    std::vector<int> _CoordiTable[D];
+    int _CoordiOffset[D];
     uint _Shape[SMOOTH_T_SIZE];
     uint _CacheDeltaT[DELTA_T_SIZE];
     uint _CacheSmoothT[SMOOTH_T_SIZE];
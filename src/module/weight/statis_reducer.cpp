@@ -0,0 +1,214 @@
+//
+//  statis_reducer.cpp
+//  Feynman_Simulator
+//
+//  Created by Kun Chen on 3/5/15.
+//  Copyright (c) 2015 Kun Chen. All rights reserved.
+//
+
+#include "statis_reducer.h"
+#include "utility/checkpoint.h"
+#include "utility/dictionary.h"
+#include "utility/parallel.h"
+#include "utility/abort.h"
+#include <algorithm>
+#include <string.h>
+#include <dirent.h>
+
+using namespace std;
+using namespace weight;
+
+const string StatisFilePattern = "_statis";
+
+StatisReducer::StatisReducer(const vector<string>& Names_, uint ChunkSize_)
+    : Names(Names_)
+    , ChunkSize(max(1u, ChunkSize_))
+{
+}
+
+static bool ReadScalar(const CheckpointReader& reader, const string& Path, real& value)
+{
+    const CheckpointEntry* entry = reader.Find(Path);
+    if (entry == nullptr)
+        return false;
+    if (entry->Type == CK_REAL && entry->Size == sizeof(double)) {
+        double v;
+        memcpy(&v, reader.Payload(*entry), sizeof(v));
+        value = v;
+        return true;
+    }
+    if (entry->Type == CK_INT && entry->Size == sizeof(int64_t)) {
+        int64_t v;
+        memcpy(&v, reader.Payload(*entry), sizeof(v));
+        value = v;
+        return true;
+    }
+    return false;
+}
+
+/**
+*  read Norm, NormAccu and the shape of every histogram into Header, return why the file can not be merged,
+*  or an empty string
+*/
+string StatisReducer::_Check(const CheckpointReader& reader, vector<Histogram>& Header) const
+{
+    Header.resize(Names.size());
+    for (uint i = 0; i < Names.size(); i++) {
+        string path = Names[i] + "/Histogram/SmoothT/";
+        Histogram& hist = Header[i];
+        if (!ReadScalar(reader, path + "Norm", hist.Norm) || !ReadScalar(reader, path + "NormAccu", hist.NormAccu))
+            return "no Norm/NormAccu of " + Names[i];
+        const CheckpointEntry* accu = reader.Find(path + "WeightAccu");
+        if (accu == nullptr || accu->Type != CK_ARRAY || accu->DType != "<c16")
+            return "no complex WeightAccu of " + Names[i];
+        hist.Shape.assign(accu->Shape.begin(), accu->Shape.end());
+        uint64_t size = 1;
+        for (auto n : accu->Shape)
+            size *= n;
+        if (accu->Size != size * sizeof(Complex))
+            return "broken WeightAccu of " + Names[i];
+    }
+    return "";
+}
+
+/**
+*  add the histograms of a checked file into Sum, WeightAccu is streamed chunk by chunk from the mapping
+*  of the reader, whose pages are dropped once they are added, so that a file never stays in memory;
+*  the file is never opened again by name, so it can be replaced by a newer one in the meantime
+*/
+void StatisReducer::_Add(const CheckpointReader& reader, vector<Histogram>& Sum, vector<Complex>& Chunk) const
+{
+    for (uint i = 0; i < Names.size(); i++) {
+        real NormAccu;
+        ReadScalar(reader, Names[i] + "/Histogram/SmoothT/NormAccu", NormAccu);
+        Sum[i].NormAccu += NormAccu;
+        const CheckpointEntry* accu = reader.Find(Names[i] + "/Histogram/SmoothT/WeightAccu");
+        const char* payload = reader.Payload(*accu);
+        Complex* target = Sum[i].WeightAccu.data();
+        uint64_t Left = Sum[i].WeightAccu.size();
+        while (Left > 0) {
+            uint n = (uint)min<uint64_t>(Left, ChunkSize);
+            memcpy(Chunk.data(), payload, n * sizeof(Complex));
+            reader.DropPages(payload, payload + n * sizeof(Complex));
+            payload += n * sizeof(Complex);
+            for (uint j = 0; j < n; j++)
+                target[j] += Chunk[j];
+            target += n;
+            Left -= n;
+        }
+    }
+}
+
+uint StatisReducer::Reduce(const vector<string>& FileList, int NThread)
+{
+    _Total.clear();
+    Failure.clear();
+    uint NFile = FileList.size();
+    vector<string> Reason(NFile);
+
+    //the first file which can be read decides Norm and the shape, as in MergeFromDict
+    uint First = 0;
+    for (; First < NFile; First++) {
+        try {
+            CheckpointReader reader;
+            reader.Open(FileList[First]);
+            reader.ReplayDelta(FileList[First]);
+            Reason[First] = _Check(reader, _Total);
+        }
+        catch (IOInvalid& e) {
+            Reason[First] = e.what();
+        }
+        if (Reason[First].empty())
+            break;
+    }
+    if (First == NFile) {
+        for (uint f = 0; f < NFile; f++)
+            Failure.push_back(make_pair(FileList[f], Reason[f]));
+        _Total.clear();
+        return 0;
+    }
+    for (auto& hist : _Total) {
+        uint64_t size = 1;
+        for (auto n : hist.Shape)
+            size *= n;
+        hist.NormAccu = 0.0;
+        hist.WeightAccu.assign(size, Complex(0.0, 0.0));
+    }
+
+    uint NSlice = min((uint)ThreadNumber(NThread), NFile - First);
+    vector<vector<Histogram> > Partial(NSlice, _Total);
+    ParallelFor(NSlice, NSlice, [&](uint begin, uint end) {
+        vector<Complex> Chunk(ChunkSize);
+        vector<Histogram> Header;
+        for (uint s = begin; s < end; s++)
+            for (uint f = First + (NFile - First) * s / NSlice; f < First + (NFile - First) * (s + 1) / NSlice; f++) {
+                CheckpointReader reader;
+                try {
+                    reader.Open(FileList[f]);
+                    reader.ReplayDelta(FileList[f]);
+                }
+                catch (IOInvalid& e) {
+                    Reason[f] = e.what();
+                    continue;
+                }
+                Reason[f] = _Check(reader, Header);
+                for (uint i = 0; i < Header.size() && Reason[f].empty(); i++) {
+                    if (Header[i].Shape != _Total[i].Shape)
+                        Reason[f] = "shape of " + Names[i] + " does not match";
+                    else if (Header[i].Norm != _Total[i].Norm)
+                        Reason[f] = "Norm of " + Names[i] + " has to be the same to merge statistics";
+                }
+                if (Reason[f].empty())
+                    _Add(reader, Partial[s], Chunk);
+            }
+    });
+    for (auto& partial : Partial)
+        for (uint i = 0; i < _Total.size(); i++) {
+            _Total[i].NormAccu += partial[i].NormAccu;
+            Complex* target = _Total[i].WeightAccu.data();
+            const Complex* source = partial[i].WeightAccu.data();
+            for (uint64_t j = 0; j < _Total[i].WeightAccu.size(); j++)
+                target[j] += source[j];
+        }
+    uint Success = 0;
+    for (uint f = 0; f < NFile; f++) {
+        if (Reason[f].empty())
+            Success++;
+        else
+            Failure.push_back(make_pair(FileList[f], Reason[f]));
+    }
+    return Success;
+}
+
+Dictionary StatisReducer::ToDict()
+{
+    ASSERT_ALLWAYS(_Total.size() == Names.size(), "No statistics is reduced!");
+    Dictionary dict;
+    for (uint i = 0; i < Names.size(); i++) {
+        Dictionary hist;
+        hist["Norm"] = _Total[i].Norm;
+        hist["NormAccu"] = _Total[i].NormAccu;
+        hist["WeightAccu"] = Python::ArrayObject("<c16", _Total[i].Shape, _Total[i].WeightAccu.data());
+        dict[Names[i]] = Dictionary("Histogram", Dictionary("SmoothT", hist));
+    }
+    return dict;
+}
+
+vector<string> weight::GetStatisFileList(const string& Dir)
+{
+    vector<string> FileList;
+    DIR* dir = opendir(Dir.c_str());
+    if (dir == nullptr)
+        THROW_ERROR(IOInvalid, "Fail to open directory " << Dir << "!");
+    while (dirent* entry = readdir(dir)) {
+        string name = entry->d_name;
+        uint n = CHECKPOINT_SUFFIX.size();
+        if (name.empty() || name[0] == '_' || name.find(StatisFilePattern) == string::npos)
+            continue;
+        if (name.size() > n && name.compare(name.size() - n, n, CHECKPOINT_SUFFIX) == 0)
+            FileList.push_back(Dir + "/" + name.substr(0, name.size() - n));
+    }
+    closedir(dir);
+    sort(FileList.begin(), FileList.end());
+    return FileList;
+}
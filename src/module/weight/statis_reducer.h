@@ -0,0 +1,60 @@
+//
+//  statis_reducer.h
+//  Feynman_Simulator
+//
+//  Created by Kun Chen on 3/5/15.
+//  Copyright (c) 2015 Kun Chen. All rights reserved.
+//
+
+#ifndef __Feynman_Simulator__statis_reducer__
+#define __Feynman_Simulator__statis_reducer__
+
+#include "utility/complex.h"
+#include <string>
+#include <vector>
+
+class Dictionary;
+class CheckpointReader;
+
+namespace weight {
+
+/**
+*  \brief sum the Sigma/Polar histograms of many statistics checkpoints, the native version of
+*  collect.CollectStatis. WeightAccu of a file is streamed from its mapping ChunkSize elements at a time
+*  and the pages read are dropped, so only the totals and one chunk per thread stay in memory however
+*  many files there are.
+*  Files are split into NThread contiguous slices which are summed separately and then added in
+*  the order of the slices, so the result only depends on the list of files and NThread.
+*  As WeightEstimator.MergeFromDict, every file has to have the Norm of the first one; a file which is
+*  broken, or has another Norm or shape, is skipped as a whole.
+*/
+class StatisReducer {
+public:
+    StatisReducer(const std::vector<std::string>& Names = { "Sigma", "Polar" }, uint ChunkSize = 1 << 16);
+    std::vector<std::string> Names;
+    uint ChunkSize;
+
+    //FileName without CHECKPOINT_SUFFIX, NThread<=0 uses all cores; return the number of files merged
+    uint Reduce(const std::vector<std::string>& FileList, int NThread = 0);
+    //files skipped in the last Reduce, with the reason
+    std::vector<std::pair<std::string, std::string> > Failure;
+    //{Name: {"Histogram": {"SmoothT": {"Norm", "NormAccu", "WeightAccu"}}}}, the same as collect.py
+    Dictionary ToDict();
+
+private:
+    struct Histogram {
+        real Norm;
+        real NormAccu;
+        std::vector<uint> Shape;
+        std::vector<Complex> WeightAccu;
+    };
+    std::vector<Histogram> _Total;
+    std::string _Check(const CheckpointReader&, std::vector<Histogram>& Header) const;
+    void _Add(const CheckpointReader&, std::vector<Histogram>& Sum, std::vector<Complex>& Chunk) const;
+};
+
+//statistics checkpoints of the MC jobs in Dir, the same files as collect.GetFileList
+std::vector<std::string> GetStatisFileList(const std::string& Dir);
+}
+
+#endif /* defined(__Feynman_Simulator__statis_reducer__) */
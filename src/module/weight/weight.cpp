@@ -21,14 +21,20 @@ weight::Weight::Weight(bool IsAllSymmetric)
     Polar = nullptr;
     G = nullptr;
     W = nullptr;
+    _IsGWShared = false;
+    _IsSigmaPolarShared = false;
 }
 
 weight::Weight::~Weight()
 {
-    delete Sigma;
-    delete Polar;
-    delete G;
-    delete W;
+    if (!_IsSigmaPolarShared) {
+        delete Sigma;
+        delete Polar;
+    }
+    if (!_IsGWShared) {
+        delete G;
+        delete W;
+    }
 }
 /**
 *  Build G, W, Sigma, Polar from file, you may use flag weight::GW and weight::SigmaPolar to control which group to load. Notice those in unflaged group will remain the same.
@@ -55,12 +61,17 @@ bool weight::Weight::BuildNew(flag _flag, const ParaMC &para)
     return true;
 }
 
+//borrowed components are annealed by their owner
 void weight::Weight::Anneal(const ParaMC &para)
 {
-    G->Reset(para.Beta);
-    W->Reset(para.Beta);
-    Sigma->Reset(para.Beta);
-    Polar->Reset(para.Beta);
+    if (!_IsGWShared) {
+        G->Reset(para.Beta);
+        W->Reset(para.Beta);
+    }
+    if (!_IsSigmaPolarShared) {
+        Sigma->Reset(para.Beta);
+        Polar->Reset(para.Beta);
+    }
 }
 
 bool weight::Weight::FromDict(const Dictionary &dict, flag _flag, const para::ParaMC &para)
@@ -80,6 +91,13 @@ bool weight::Weight::FromDict(const Dictionary &dict, flag _flag, const para::Pa
     }
     return true;
 }
+bool weight::Weight::MapGW(const CheckpointReader &reader, const ParaMC &para)
+{
+    Norm::NormFactor = para.Lat.Vol * para.Lat.SublatVol;
+    _AllocateGW(para);
+    return G->FromCheckpoint(reader, "G") && W->FromCheckpoint(reader, "W");
+}
+
 Dictionary weight::Weight::ToDict(flag _flag)
 {
     Dictionary dict;
@@ -94,6 +112,26 @@ Dictionary weight::Weight::ToDict(flag _flag)
     return dict;
 }
 
+DirtyMap weight::Weight::TakeDirty(flag _flag)
+{
+    DirtyMap Dirty;
+    if (_flag & weight::GW) {
+        G->TakeDirty(Dirty, "G");
+        W->TakeDirty(Dirty, "W");
+    }
+    if (_flag & weight::SigmaPolar) {
+        Sigma->TakeDirty(Dirty, "Sigma");
+        Polar->TakeDirty(Dirty, "Polar");
+    }
+    return Dirty;
+}
+
+void weight::Weight::TrackDirty(bool flag)
+{
+    Sigma->Estimator.TrackDirty(flag);
+    Polar->Estimator.TrackDirty(flag);
+}
+
 void weight::Weight::SetTest(const ParaMC &para)
 {
     _AllocateGW(para);
@@ -110,8 +148,36 @@ void weight::Weight::SetDiagCounter(const ParaMC &para)
     W->BuildTest();
 }
 
+void weight::Weight::ShareGW(const Weight &weight)
+{
+    if (!_IsGWShared) {
+        delete G;
+        delete W;
+    }
+    G = weight.G;
+    W = weight.W;
+    _IsGWShared = true;
+}
+
+void weight::Weight::ShareSigmaPolar(const Weight &weight)
+{
+    if (!_IsSigmaPolarShared) {
+        delete Sigma;
+        delete Polar;
+    }
+    Sigma = weight.Sigma;
+    Polar = weight.Polar;
+    _IsSigmaPolarShared = true;
+}
+
 void weight::Weight::_AllocateGW(const ParaMC &para)
 {
+    //shared G/W belong to somebody else, never release them here
+    if (_IsGWShared) {
+        G = nullptr;
+        W = nullptr;
+        _IsGWShared = false;
+    }
     //make sure old Sigma/Polar/G/W are released before assigning new memory
     delete G;
     auto symmetry = _IsAllSymmetric ? TauSymmetric : TauAntiSymmetric;
@@ -122,6 +188,11 @@ void weight::Weight::_AllocateGW(const ParaMC &para)
 
 void weight::Weight::_AllocateSigmaPolar(const ParaMC &para)
 {
+    if (_IsSigmaPolarShared) {
+        Sigma = nullptr;
+        Polar = nullptr;
+        _IsSigmaPolarShared = false;
+    }
     auto symmetry = _IsAllSymmetric ? TauSymmetric : TauAntiSymmetric;
     delete Sigma;
     Sigma = new weight::SigmaClass(para.Lat, para.Beta, para.MaxTauBin, para.Order, symmetry);
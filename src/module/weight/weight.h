@@ -12,6 +12,7 @@
 //#include "weight_inherit.h"
 #include <string>
 #include "utility/convention.h"
+#include "utility/checkpoint.h"
 
 class Dictionary;
 namespace para {
@@ -44,9 +45,21 @@ public:
     bool BuildNew(flag, const para::ParaMC&);
     bool FromDict(const Dictionary&, flag, const para::ParaMC&);
     Dictionary ToDict(flag);
+    //flags of the blocks of the arrays in ToDict(flag) changed since the last call, by their paths in ToDict
+    DirtyMap TakeDirty(flag);
+    //whether the estimators of Sigma and Polar flag their changed blocks, set it if the delta checkpoints are saved
+    void TrackDirty(bool);
+    //G and W use the arrays of a mapped weight checkpoint in place, false if they do not match para
+    bool MapGW(const CheckpointReader&, const para::ParaMC&);
     void Anneal(const para::ParaMC&);
+    //borrow G and W from another Weight instead of owning a copy, they are read-only in MC
+    void ShareGW(const Weight&);
+    //borrow Sigma and Polar from another Weight, their estimators have to be set to a concurrent Accumulation
+    void ShareSigmaPolar(const Weight&);
 
 private:
+    bool _IsGWShared;
+    bool _IsSigmaPolarShared;
     void _AllocateGW(const para::ParaMC&);
     void _AllocateSigmaPolar(const para::ParaMC&);
 };
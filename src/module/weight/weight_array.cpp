@@ -10,7 +10,9 @@
 #include "utility/logger.h"
 #include "utility/dictionary.h"
 #include "index_map.h"
+#include "utility/checkpoint.h"
 #include <math.h>
+#include <stdint.h>
 
 using namespace std;
 
@@ -19,25 +21,31 @@ template <uint DIM>
 void WeightArray<DIM>::Assign(const Complex& c)
 {
     ASSERT_ALLWAYS(IsAllocated, "Array should be allocated first!");
+    ASSERT_ALLWAYS(!IsMapped(), "Mapped array is read-only!");
     for (uint i = 0; i < _Size; i++)
         _Data[i] = c;
+    MarkAllDirty();
 }
 template <uint DIM>
 void WeightArray<DIM>::Assign(const Complex* source)
 {
     ASSERT_ALLWAYS(IsAllocated, "Array should be allocated first!");
+    ASSERT_ALLWAYS(!IsMapped(), "Mapped array is read-only!");
     if (_Data == source)
         return;
     std::copy(source, source + _Size, _Data);
+    MarkAllDirty();
 }
 
 template <uint DIM>
 void WeightArray<DIM>::Assign(const Complex* source, uint size)
 {
     ASSERT_ALLWAYS(IsAllocated, "Array should be allocated first!");
+    ASSERT_ALLWAYS(!IsMapped(), "Mapped array is read-only!");
     if (_Data == source)
         return;
     std::copy(source, source + size, _Data);
+    MarkAllDirty();
 }
 
 template <uint DIM>
@@ -51,19 +59,24 @@ void WeightArray<DIM>::Allocate(const uint* Shape_, const std::string Name)
     for (auto i = 0; i < DIM; i++) {
         _Size *= _Shape[i];
     }
-    _Data = new Complex[_Size];
-    if (_Data == nullptr) {
+    shared_ptr<Complex> storage(new (nothrow) Complex[_Size], default_delete<Complex[]>());
+    if (storage == nullptr)
         THROW_ERROR(MemoryException, "Fail to allocate array!");
-        IsAllocated = false;
-    }
+    _Data = storage.get();
+    _Owner = shared_ptr<const char>(storage, reinterpret_cast<const char*>(_Data));
+    _IsMapped = false;
     IsAllocated = true;
+    _Dirty.assign((_Size + DIRTY_BLOCK - 1) / DIRTY_BLOCK, 1);
 }
 
 template <uint DIM>
 void WeightArray<DIM>::Free()
 {
     if (IsAllocated) {
-        delete[] _Data;
+        //the memory is released by its last owner, which may be a numpy array
+        _Owner.reset();
+        _Data = nullptr;
+        _IsMapped = false;
         IsAllocated = false;
     }
 }
@@ -74,18 +87,83 @@ bool WeightArray<DIM>::FromDict(const Dictionary& dict)
     ASSERT_ALLWAYS(IsAllocated, "Array should be allocated first!");
     Python::ArrayObject arr = dict.Get<Python::ArrayObject>(_Name);
     ASSERT_ALLWAYS(Equal(arr.Shape().data(), GetShape(), GetDim()), "Shape should match!");
-    Assign(arr.Data<Complex>());
+    if (!Adopt(arr))
+        Assign(arr.Data<Complex>());
     return true;
 }
 
+/**
+*  After adoption _Data and arr are the same memory, so that a change of one is seen by the other.
+*  The buffer is released when both the array and arr are gone.
+*/
+template <uint DIM>
+bool WeightArray<DIM>::Adopt(Python::ArrayObject& arr)
+{
+    ASSERT_ALLWAYS(IsAllocated, "Array should be allocated first!");
+    if (arr.DType() != "<c16" || sizeof(Complex) != 16 || !arr.IsWritable())
+        return false;
+    if (arr.Dim() != DIM || !Equal(arr.Shape().data(), GetShape(), GetDim()))
+        return false;
+    if (reinterpret_cast<uintptr_t>(arr.Bytes()) % alignof(Complex) != 0)
+        return false;
+    shared_ptr<char> buffer = arr.Share();
+    Free();
+    _Data = reinterpret_cast<Complex*>(buffer.get());
+    _Owner = buffer;
+    IsAllocated = true;
+    MarkAllDirty();
+    return true;
+}
+
+/**
+*  Instead of a private copy, _Data points into the mmap of the checkpoint, which is shared
+*  by all processes mapping the same file. The mapping is released when the array is freed.
+*/
+template <uint DIM>
+bool WeightArray<DIM>::FromCheckpoint(const CheckpointReader& reader, const std::string& Path)
+{
+    ASSERT_ALLWAYS(IsAllocated, "Array should be allocated first!");
+    const CheckpointEntry* entry = reader.Find(Path + "/" + _Name);
+    if (entry == nullptr || entry->Type != CK_ARRAY || entry->DType != "<c16" || sizeof(Complex) != 16)
+        return false;
+    if (entry->Shape.size() != DIM || entry->Size != _Size * sizeof(Complex))
+        return false;
+    for (uint i = 0; i < DIM; i++)
+        if (entry->Shape[i] != _Shape[i])
+            return false;
+    Free();
+    _Data = reinterpret_cast<Complex*>(const_cast<char*>(reader.Payload(*entry)));
+    _Owner = reader.Mapping();
+    _IsMapped = true;
+    IsAllocated = true;
+    MarkAllDirty();
+    return true;
+}
+
+template <uint DIM>
+vector<uint8_t> WeightArray<DIM>::TakeDirty()
+{
+    vector<uint8_t> dirty(_Dirty.size());
+    for (uint b = 0; b < _Dirty.size(); b++)
+        dirty[b] = __atomic_exchange_n(&_Dirty[b], 0, __ATOMIC_RELAXED);
+    return dirty;
+}
+
 template <uint DIM>
 Dictionary WeightArray<DIM>::ToDict()
 {
     Dictionary dict;
-    dict[_Name] = Python::ArrayObject(_Data, GetShape(), GetDim());
+    dict[_Name] = ToArray();
     return dict;
 }
 
+template <uint DIM>
+Python::ArrayObject WeightArray<DIM>::ToArray()
+{
+    ASSERT_ALLWAYS(IsAllocated, "Array should be allocated first!");
+    return Python::ArrayObject(_Data, GetShape(), GetDim(), _Owner);
+}
+
 template class WeightArray<DELTA_T_SIZE>;
 template class WeightArray<SMOOTH_T_SIZE>;
 template class WeightArray<SMOOTH_T_SIZE + 1>;
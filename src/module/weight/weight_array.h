@@ -10,9 +10,17 @@
 #define __Feynman_Simulator__weight_basic__
 
 #include "utility/complex.h"
+#include "utility/checkpoint.h"
 #include <string>
+#include <memory>
+#include <vector>
+#include <algorithm>
 
 class Dictionary;
+class CheckpointReader;
+namespace Python {
+class ArrayObject;
+}
 namespace weight {
 
 enum SpinNum {
@@ -22,12 +30,16 @@ enum SpinNum {
 
 const std::string SMOOTH = "SmoothT";
 const std::string DELTA = "DeltaT";
+//elements of a block of the dirty flags, which is a block of the delta checkpoints
+const uint DIRTY_BLOCK = DELTA_BLOCK / sizeof(Complex);
 
 template <uint DIM>
 class WeightArray {
 public:
     WeightArray()
-        : _Data(nullptr){};
+        : _Data(nullptr)
+        , IsAllocated(false)
+        , _IsMapped(false){};
     //copy sematics everywhere
     WeightArray(const WeightArray& source) = delete;
     WeightArray& operator=(const WeightArray& c) = delete;
@@ -46,14 +58,30 @@ public:
     const Complex& operator()(uint Index) const { return _Data[Index]; }
     Complex* Data() { return _Data; }
 
+    //use the array of dict in place if possible, otherwise copy it
     bool FromDict(const Dictionary&);
     Dictionary ToDict();
+    //a numpy view of _Data, which keeps _Data alive even after the array is freed
+    Python::ArrayObject ToArray();
+    //share the buffer of arr instead of a private copy, false if its type, shape or alignment does not match
+    bool Adopt(Python::ArrayObject& arr);
+    //use the array Path/_Name of a mapped checkpoint read-only in place, false if it does not match the shape
+    bool FromCheckpoint(const CheckpointReader&, const std::string& Path);
+    bool IsMapped() const { return _IsMapped; }
+
+    //blocks of DIRTY_BLOCK elements changed since the last TakeDirty, for the delta checkpoints.
+    //All members which change the whole array mark it, a write through operator[] or Data() has to be marked by the caller
+    void MarkDirty(uint Index) { __atomic_store_n(&_Dirty[Index / DIRTY_BLOCK], 1, __ATOMIC_RELAXED); }
+    void MarkAllDirty() { std::fill(_Dirty.begin(), _Dirty.end(), 1); }
+    //the flags of all blocks, which are cleared
+    std::vector<uint8_t> TakeDirty();
 
     template <typename T>
     WeightArray& operator+=(const T& rhs)
     {
         for (uint i = 0; i < _Size; i++)
             _Data[i] += rhs;
+        MarkAllDirty();
         return *this;
     }
     template <typename T>
@@ -61,20 +89,38 @@ public:
     {
         for (uint i = 0; i < _Size; i++)
             _Data[i] -= rhs;
+        MarkAllDirty();
         return *this;
     }
-    template <typename T>
-    WeightArray& operator*=(const T& rhs)
+    WeightArray& operator*=(real rhs)
     {
-        for (uint i = 0; i < _Size; i++)
-            _Data[i] *= rhs;
+        Scale(_Data, rhs, _Size);
+        MarkAllDirty();
         return *this;
     }
-    template <typename T>
-    WeightArray& operator/=(const T& rhs)
+    WeightArray& operator*=(const Complex& rhs)
     {
-        for (uint i = 0; i < _Size; i++)
-            _Data[i] /= rhs;
+        Scale(_Data, rhs, _Size);
+        MarkAllDirty();
+        return *this;
+    }
+    WeightArray& operator/=(real rhs)
+    {
+        Scale(_Data, 1.0 / rhs, _Size);
+        MarkAllDirty();
+        return *this;
+    }
+    WeightArray& operator/=(const Complex& rhs)
+    {
+        Scale(_Data, 1.0 / rhs, _Size);
+        MarkAllDirty();
+        return *this;
+    }
+    //element-wise, the shapes should be the same
+    WeightArray& operator+=(const WeightArray& rhs)
+    {
+        Add(_Data, rhs._Data, _Size);
+        MarkAllDirty();
         return *this;
     }
 
@@ -84,6 +130,10 @@ protected:
     uint _Shape[DIM];
     uint _Size;
     std::string _Name;
+    bool _IsMapped;
+    //owns _Data, which is either allocated, borrowed from a mmap, or borrowed from a numpy array
+    std::shared_ptr<const char> _Owner;
+    std::vector<uint8_t> _Dirty;
 };
 }
 
@@ -10,14 +10,110 @@
 #include "utility/scopeguard.h"
 #include "utility/dictionary.h"
 #include "weight_estimator.h"
+#include <stdlib.h>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
 
 using namespace std;
 using namespace weight;
 
+const int CACHE_LINE = 64;
+const int SHARD_HEADER = CACHE_LINE / sizeof(Complex);
+
+/**
+*  Every running thread gets a different id the first time it measures, the id is given back when the
+*  thread exits, so a job which starts new walker threads again and again never runs out of shards.
+*  A thread which takes over an id also adds into the shards left by the old one, which is the same sum.
+*/
+class ThreadIDPool {
+public:
+    ThreadIDPool()
+        : _Next(0)
+    {
+    }
+    int Acquire()
+    {
+        lock_guard<mutex> lock(_Mutex);
+        if (_Free.empty())
+            return _Next++;
+        //the smallest free id, so that the ids stay below MAX_SHARD as long as possible
+        auto it = min_element(_Free.begin(), _Free.end());
+        int id = *it;
+        _Free.erase(it);
+        return id;
+    }
+    void Release(int id)
+    {
+        lock_guard<mutex> lock(_Mutex);
+        _Free.push_back(id);
+    }
+
+private:
+    mutex _Mutex;
+    int _Next;
+    vector<int> _Free;
+};
+
+static ThreadIDPool& IDPool()
+{
+    static ThreadIDPool pool;
+    return pool;
+}
+
+struct ThreadIDHolder {
+    int ID;
+    ThreadIDHolder()
+        : ID(IDPool().Acquire())
+    {
+    }
+    ~ThreadIDHolder() { IDPool().Release(ID); }
+};
+
+static int ThreadID()
+{
+    thread_local ThreadIDHolder Holder;
+    return Holder.ID;
+}
+
+inline void AtomicAdd(real* target, real value)
+{
+    real expected, desired;
+    __atomic_load(target, &expected, __ATOMIC_RELAXED);
+    do {
+        desired = expected + value;
+    } while (!__atomic_compare_exchange(target, &expected, &desired, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+/**
+*  flag the blocks of target in which source has a nonzero element, before source is added into it
+*/
+static void MarkChanged(WeightArray<SMOOTH_T_SIZE + 1>& target, const Complex* source)
+{
+    uint size = target.GetSize();
+    for (uint begin = 0; begin < size; begin += DIRTY_BLOCK) {
+        uint end = min(begin + DIRTY_BLOCK, size);
+        for (uint i = begin; i < end; i++)
+            if (source[i].Re != 0.0 || source[i].Im != 0.0) {
+                target.MarkDirty(begin);
+                break;
+            }
+    }
+}
+
 /**********************   Weight Needs measuring  **************************/
 
 WeightEstimator::WeightEstimator()
 {
+    _Accumulation = SERIAL;
+    _TrackDirty = false;
+    for (int i = 0; i < MAX_SHARD; i++)
+        _Shards[i] = nullptr;
+}
+
+WeightEstimator::~WeightEstimator()
+{
+    _FreeShards();
 }
 
 void WeightEstimator::Allocate(const IndexMap& map, int order, real Norm)
@@ -30,21 +126,116 @@ void WeightEstimator::Allocate(const IndexMap& map, int order, real Norm)
     std::copy(map.GetShape(), map.GetShape() + SMOOTH_T_SIZE, &MeaShape[1]);
     _WeightAccu.Allocate(MeaShape, SMOOTH);
     _WeightSize = _WeightAccu.GetSize() / order;
+    //shards have the shape of the old histogram
+    _FreeShards();
     ClearStatistics();
 }
 
+void WeightEstimator::SetAccumulation(Accumulation mode)
+{
+    _CollectShards();
+    if (mode != SHARDED)
+        _FreeShards();
+    if (mode == BATCHED)
+        _Batch.reserve(BATCH_CAPACITY);
+    else
+        std::vector<std::pair<uint, Complex> >().swap(_Batch);
+    _Accumulation = mode;
+}
+
+void WeightEstimator::TrackDirty(bool flag)
+{
+    //blocks changed while untracked are unknown, so the next delta has to carry the whole histogram
+    if (flag && !_TrackDirty)
+        _WeightAccu.MarkAllDirty();
+    _TrackDirty = flag;
+}
+
+/**
+*  the shard of the calling thread, allocated the first time the thread measures
+*/
+Complex* WeightEstimator::_Shard()
+{
+    int id = ThreadID();
+    ASSERT_ALLWAYS(id < MAX_SHARD, "Too many threads to measure, at most " << MAX_SHARD << " are allowed!");
+    Complex* shard = _Shards[id];
+    if (shard != nullptr)
+        return shard;
+    uint size = SHARD_HEADER + _WeightAccu.GetSize();
+    //round up to whole cache lines, so that two shards never share a cache line
+    size_t bytes = (size * sizeof(Complex) + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+    void* memory = nullptr;
+    if (posix_memalign(&memory, CACHE_LINE, bytes) != 0)
+        THROW_ERROR(MemoryException, "Fail to allocate shard!");
+    shard = static_cast<Complex*>(memory);
+    for (uint i = 0; i < size; i++)
+        new (shard + i) Complex(0.0, 0.0);
+    _Shards[id] = shard;
+    return shard;
+}
+
+/**
+*  add the buffered measurements into _WeightAccu with a sweep in the order of their index, instead of
+*  a random access per measurement. The sort is stable, so every bin sums up its weights in the order
+*  they were measured, and _WeightAccu is exactly the same as the one of a SERIAL estimator.
+*/
+void WeightEstimator::_FlushBatch()
+{
+    std::stable_sort(_Batch.begin(), _Batch.end(),
+                     [](const pair<uint, Complex>& a, const pair<uint, Complex>& b) { return a.first < b.first; });
+    for (auto& measure : _Batch) {
+        _WeightAccu[measure.first] += measure.second;
+        if (_TrackDirty)
+            _WeightAccu.MarkDirty(measure.first);
+    }
+    _Batch.clear();
+}
+
+/**
+*  add the batch and all shards into _NormAccu and _WeightAccu, then clear them
+*/
+void WeightEstimator::_CollectShards()
+{
+    _FlushBatch();
+    uint size = _WeightAccu.GetSize();
+    for (int i = 0; i < MAX_SHARD; i++) {
+        Complex* shard = _Shards[i];
+        if (shard == nullptr)
+            continue;
+        _NormAccu += shard[0].Re;
+        shard[0].Re = 0.0;
+        if (_TrackDirty)
+            MarkChanged(_WeightAccu, shard + SHARD_HEADER);
+        Accumulate(_WeightAccu.Data(), shard + SHARD_HEADER, size);
+    }
+}
+
+void WeightEstimator::_FreeShards()
+{
+    for (int i = 0; i < MAX_SHARD; i++) {
+        free(_Shards[i]);
+        _Shards[i] = nullptr;
+    }
+}
+
 void WeightEstimator::Anneal(real Beta)
 {
     //make sure
     //real NormFactor = 1.0 / _NormAccu * _Norm;
     //has the same value before Beta is changed
     //so that GetWeightArray will give a same weight function
+    _CollectShards();
     _NormAccu *= pow((Beta / _Beta), 2.0);
 }
 
 void WeightEstimator::MeasureNorm(real weight)
 {
-    _NormAccu += weight;
+    if (_Accumulation == SERIAL || _Accumulation == BATCHED)
+        _NormAccu += weight;
+    else if (_Accumulation == SHARDED)
+        _Shard()[0].Re += weight;
+    else
+        AtomicAdd(&_NormAccu, weight);
 }
 
 void WeightEstimator::Measure(uint WeightIndex, int Order, Complex weight)
@@ -52,42 +243,90 @@ void WeightEstimator::Measure(uint WeightIndex, int Order, Complex weight)
     if (DEBUGMODE && Order < 1)
         LOG_ERROR("Too small order=" << Order);
     uint Index = (Order - 1) * _WeightSize + WeightIndex;
-    _WeightAccu[Index] += weight;
+    if (_Accumulation == SERIAL) {
+        _WeightAccu[Index] += weight;
+        if (_TrackDirty)
+            _WeightAccu.MarkDirty(Index);
+    }
+    else if (_Accumulation == SHARDED)
+        _Shard()[SHARD_HEADER + Index] += weight;
+    else if (_Accumulation == BATCHED) {
+        _Batch.push_back(make_pair(Index, weight));
+        if (_Batch.size() == BATCH_CAPACITY)
+            _FlushBatch();
+    }
+    else {
+        AtomicAdd(&_WeightAccu[Index].Re, weight.Re);
+        AtomicAdd(&_WeightAccu[Index].Im, weight.Im);
+        //after the add, so that a TakeDirty in between leaves the block flagged
+        if (_TrackDirty)
+            _WeightAccu.MarkDirty(Index);
+    }
 }
 
 void WeightEstimator::ClearStatistics()
 {
     _NormAccu = 0.0;
+    _Batch.clear();
     _WeightAccu.Assign(0.0);
+    for (int i = 0; i < MAX_SHARD; i++)
+        if (_Shards[i] != nullptr)
+            std::fill(_Shards[i], _Shards[i] + SHARD_HEADER + _WeightAccu.GetSize(), Complex(0.0, 0.0));
 }
 //TODO: you may have to replace int with size_t here
 
 void WeightEstimator::SqueezeStatistics(real factor)
 {
     ASSERT_ALLWAYS(factor > 0, "factor=" << factor << "<=0!");
+    _CollectShards();
     _NormAccu /= factor;
     _WeightAccu *= 1.0 / factor;
 }
 
+void WeightEstimator::Merge(WeightEstimator& source)
+{
+    ASSERT_ALLWAYS(source._WeightAccu.GetSize() == _WeightAccu.GetSize(), "Only estimators with the same shape can be merged!");
+    _CollectShards();
+    source._CollectShards();
+    _NormAccu += source._NormAccu;
+    //only the blocks the source has measured are changed, a sparse walker does not flag the whole histogram
+    if (_TrackDirty)
+        MarkChanged(_WeightAccu, source._WeightAccu.Data());
+    Add(_WeightAccu.Data(), source._WeightAccu.Data(), _WeightAccu.GetSize());
+    source.ClearStatistics();
+}
+
 /**********************   Weight IO ****************************************/
 
 bool WeightEstimator::FromDict(const Dictionary& dict)
 {
     _Norm = dict.Get<real>("Norm");
+    //statistics in shards are dropped as well
+    ClearStatistics();
     _NormAccu = dict.Get<real>("NormAccu");
     auto arr = dict.Get<Python::ArrayObject>("WeightAccu");
     //assert estimator shape except order dimension
     ASSERT_ALLWAYS(Equal(arr.Shape().data() + 1, _WeightAccu.GetShape() + 1, _WeightAccu.GetDim() - 1), "Shape should match!");
-    _WeightAccu.Assign(0.0);
-    _WeightAccu.Assign(arr.Data<Complex>(), arr.Size());
+    //the histogram of the same order is used in place, the one of another order is copied
+    if (!_WeightAccu.Adopt(arr)) {
+        _WeightAccu.Assign(0.0);
+        _WeightAccu.Assign(arr.Data<Complex>(), arr.Size());
+    }
     return true;
 }
 
 Dictionary WeightEstimator::ToDict()
 {
+    _CollectShards();
     Dictionary dict;
     dict["Norm"] = _Norm;
     dict["NormAccu"] = _NormAccu;
-    dict["WeightAccu"] = Python::ArrayObject(_WeightAccu.Data(), _WeightAccu.GetShape(), _WeightAccu.GetDim());
+    dict["WeightAccu"] = _WeightAccu.ToArray();
     return dict;
 }
+
+void WeightEstimator::TakeDirty(DirtyMap& Dirty, const std::string& Path)
+{
+    _CollectShards();
+    Dirty[Path + "/WeightAccu"] = _WeightAccu.TakeDirty();
+}
@@ -12,15 +12,34 @@
 #include "estimator/estimator.h"
 #include "index_map.h"
 #include "weight_array.h"
+#include <vector>
 
 class Dictionary;
 namespace weight {
 
+//accumulation modes of WeightEstimator::Measure and MeasureNorm
+enum Accumulation {
+    SERIAL, //plain +=, only one thread can measure
+    SHARDED, //every thread accumulates into its own cache-line-aligned shard, shards are merged lazily
+    ATOMIC, //all threads add into the same histogram with atomic operations, for sparse histograms
+    BATCHED //only one thread can measure, measurements are buffered and added in the order of their index
+};
+//maximum number of different threads which can measure a SHARDED estimator
+const int MAX_SHARD = 256;
+//number of measurements buffered by a BATCHED estimator before they are added into the histogram
+const int BATCH_CAPACITY = 4096;
+
 class IndexMap;
 class WeightEstimator {
 public:
     WeightEstimator();
+    ~WeightEstimator();
     void Allocate(const IndexMap& map, int order, real Norm);
+    //shards of other threads are only read by ToDict, SqueezeStatistics, Anneal, Merge and ClearStatistics,
+    //make sure no thread is measuring when you call them
+    void SetAccumulation(Accumulation);
+    //flag the blocks changed by Measure and Merge for TakeDirty, only needed by the delta checkpoints
+    void TrackDirty(bool);
 
     //The internal _Beta will be changed, so do _WeightAccu, _DeltaWeightAccu and _NormAccu
     //all changed will be done to make sure GetWeightArray returns the reweighted weight function
@@ -32,9 +51,13 @@ public:
 
     void ClearStatistics();
     void SqueezeStatistics(real factor);
+    //add the statistics of another estimator with the same shape into this one, then clear it
+    void Merge(WeightEstimator&);
     //    std::string PrettyString();
     bool FromDict(const Dictionary&);
     Dictionary ToDict();
+    //flags of the blocks of WeightAccu changed since the last call, as Path/WeightAccu
+    void TakeDirty(DirtyMap&, const std::string& Path);
 
 protected:
     real _Beta;
@@ -44,6 +67,18 @@ protected:
     //final weight of each bin = (final weight of each bin)/MAX_BIN*Beta
     WeightArray<SMOOTH_T_SIZE + 1> _WeightAccu; //dim=0 is order
     uint _WeightSize;
+
+    Accumulation _Accumulation;
+    bool _TrackDirty;
+    //the first cache line of a shard keeps its NormAccu in Re of the first element,
+    //the rest of the shard is the histogram with the same layout as _WeightAccu
+    Complex* _Shards[MAX_SHARD];
+    Complex* _Shard();
+    void _CollectShards();
+    void _FreeShards();
+    //measurements of a BATCHED estimator which are not in _WeightAccu yet, as (index, weight)
+    std::vector<std::pair<uint, Complex> > _Batch;
+    void _FlushBatch();
 };
 }
 #endif /* defined(__Feynman_Simulator__weight_estimator__) */
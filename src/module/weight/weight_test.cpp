@@ -0,0 +1,348 @@
+//
+//  weight_test.cpp
+//  Feynman_Simulator
+//
+//  Created by Kun Chen on 3/2/15.
+//  Copyright (c) 2015 Kun Chen. All rights reserved.
+//
+
+#include "weight.h"
+#include "component.h"
+#include "statis_reducer.h"
+#include "utility/sput.h"
+#include "utility/dictionary.h"
+#include "module/parameter/parameter.h"
+#include "utility/checkpoint.h"
+#include <stdio.h>
+#include <math.h>
+#include <thread>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+
+using namespace std;
+using namespace weight;
+
+void Test_Accumulation();
+void Test_MapGW();
+void Test_IndexMap();
+void Test_ComplexKernel();
+void Test_ZeroCopy();
+void Test_StatisReducer();
+void Test_DirtyBlock();
+void Test_ShardReuse();
+
+int weight::TestWeight()
+{
+    sput_start_testing();
+    sput_enter_suite("Test Weight Estimator:");
+    sput_run_test(Test_Accumulation);
+    sput_run_test(Test_MapGW);
+    sput_run_test(Test_IndexMap);
+    sput_run_test(Test_ComplexKernel);
+    sput_run_test(Test_ZeroCopy);
+    sput_run_test(Test_StatisReducer);
+    sput_run_test(Test_DirtyBlock);
+    sput_run_test(Test_ShardReuse);
+    sput_finish_testing();
+    return sput_get_return_value();
+}
+
+const int NThread = 4;
+const int NMeasure = 20000;
+
+//integer weights, so that the totals do not depend on the order of summation
+void MeasureSome(WeightEstimator* estimator, int thread, uint size)
+{
+    for (int i = thread; i < NMeasure; i += NThread) {
+        estimator->Measure((i * 7919) % size, 1, Complex(i % 13, -(i % 5)));
+        estimator->MeasureNorm(1.0);
+    }
+}
+
+void Test_Accumulation()
+{
+    para::ParaMC Para;
+    Para.SetTest();
+    weight::Weight Serial, Sharded, Atomic, Batched;
+    Serial.SetTest(Para);
+    Batched.SetTest(Para);
+    Sharded.SetTest(Para);
+    Atomic.SetTest(Para);
+    Sharded.Sigma->Estimator.SetAccumulation(SHARDED);
+    Atomic.Sigma->Estimator.SetAccumulation(ATOMIC);
+    Batched.Sigma->Estimator.SetAccumulation(BATCHED);
+    uint size = Serial.Sigma->Estimator.ToDict().Get<Python::ArrayObject>("WeightAccu").Size();
+
+    for (int t = 0; t < NThread; t++) {
+        MeasureSome(&Serial.Sigma->Estimator, t, size);
+        MeasureSome(&Batched.Sigma->Estimator, t, size);
+    }
+    vector<thread> threads;
+    for (int t = 0; t < NThread; t++) {
+        threads.push_back(thread(MeasureSome, &Sharded.Sigma->Estimator, t, size));
+        threads.push_back(thread(MeasureSome, &Atomic.Sigma->Estimator, t, size));
+    }
+    for (auto& t : threads)
+        t.join();
+
+    Dictionary serial = Serial.Sigma->Estimator.ToDict();
+    Dictionary sharded = Sharded.Sigma->Estimator.ToDict();
+    Dictionary atomic = Atomic.Sigma->Estimator.ToDict();
+    sput_fail_unless(serial.Get<real>("NormAccu") == NMeasure, "Check NormAccu");
+    sput_fail_unless(sharded.Get<real>("NormAccu") == NMeasure && atomic.Get<real>("NormAccu") == NMeasure,
+                     "Concurrent NormAccu is the same as the serial one");
+    Complex* s = serial.Get<Python::ArrayObject>("WeightAccu").Data<Complex>();
+    Complex* sh = sharded.Get<Python::ArrayObject>("WeightAccu").Data<Complex>();
+    Complex* at = atomic.Get<Python::ArrayObject>("WeightAccu").Data<Complex>();
+    bool IsSame = true;
+    for (uint i = 0; i < size; i++)
+        IsSame &= (s[i].Re == sh[i].Re && s[i].Im == sh[i].Im && s[i].Re == at[i].Re && s[i].Im == at[i].Im);
+    sput_fail_unless(IsSame, "Concurrent WeightAccu is the same as the serial one");
+
+    //real weights, which are only the same if every bin sums up in the same order
+    for (int i = 0; i < NMeasure; i++) {
+        Complex weight(1.0 / (i + 3), cos(i));
+        Serial.Sigma->Estimator.Measure((i * 7919) % size, 1, weight);
+        Batched.Sigma->Estimator.Measure((i * 7919) % size, 1, weight);
+    }
+    s = Serial.Sigma->Estimator.ToDict().Get<Python::ArrayObject>("WeightAccu").Data<Complex>();
+    Dictionary batched = Batched.Sigma->Estimator.ToDict();
+    Complex* b = batched.Get<Python::ArrayObject>("WeightAccu").Data<Complex>();
+    IsSame = batched.Get<real>("NormAccu") == NMeasure;
+    for (uint i = 0; i < size; i++)
+        IsSame &= (s[i].Re == b[i].Re && s[i].Im == b[i].Im);
+    sput_fail_unless(IsSame, "Batched WeightAccu is the same as the serial one");
+
+    //shards are emptied by the merge, so measuring again does not count twice
+    MeasureSome(&Sharded.Sigma->Estimator, 0, size);
+    Sharded.Sigma->Estimator.SqueezeStatistics(2.0);
+    sput_fail_unless(Equal(Sharded.Sigma->Estimator.ToDict().Get<real>("NormAccu"), (NMeasure + NMeasure / NThread) / 2.0),
+                     "Shards are merged before squeezing");
+}
+
+void Test_MapGW()
+{
+    para::ParaMC Para;
+    Para.SetTest();
+    weight::Weight Source;
+    Source.SetTest(Para);
+    Source.ToDict(GW).BigSave("test_weight");
+
+    weight::Weight Mapped;
+    CheckpointReader reader;
+    reader.Open("test_weight");
+    sput_fail_unless(Mapped.MapGW(reader, Para), "Map G/W from a checkpoint");
+    Complex* g = Mapped.G->ToDict().Get<Python::ArrayObject>("SmoothT").Data<Complex>();
+    sput_fail_unless((const char*)g == reader.Payload(*reader.Find("G/SmoothT")), "G is used in place");
+    reader.Close();
+    Python::ArrayObject source = Source.W->ToDict().Get<Python::ArrayObject>("SmoothT");
+    Python::ArrayObject mapped = Mapped.W->ToDict().Get<Python::ArrayObject>("SmoothT");
+    bool IsSame = true;
+    for (uint i = 0; i < source.Size(); i++)
+        IsSame &= Equal(source.Data<Complex>()[i], mapped.Data<Complex>()[i]);
+    sput_fail_unless(IsSame, "Mapped W survives closing the reader");
+
+    para::ParaMC Other = Para;
+    Other.MaxTauBin *= 2;
+    reader.Open("test_weight");
+    sput_fail_if(Mapped.MapGW(reader, Other), "G/W of a different shape can not be mapped");
+    remove(("test_weight" + CHECKPOINT_SUFFIX).c_str());
+}
+
+void Test_IndexMap()
+{
+    Lattice Lat(Vec<int>({ 4, 6 }), 2);
+    real Beta = 1.7;
+    uint MaxTauBin = 64;
+    IndexMapSPIN2 Map(Beta, MaxTauBin, Lat, TauAntiSymmetric);
+    bool IsSame = true;
+    for (int i = 0; i < Lat.Vol; i++)
+        for (int j = 0; j < Lat.Vol; j++) {
+            Site rin(0, Lat.Index2Vec(i)), rout(1, Lat.Index2Vec(j));
+            IsSame &= (Map.CoordiIndex(rin, rout) == Lat.CoordiIndex(rin, rout));
+        }
+    sput_fail_unless(IsSame, "CoordiIndex from tables is the same as Lattice::CoordiIndex");
+
+    RandomFactory RNG;
+    IsSame = true;
+    real dBetaInverse = MaxTauBin / Beta;
+    for (int i = 0; i < 100000; i++) {
+        real tau = RNG.urn() * 2 * Beta - Beta;
+        //boundaries of bins are the most likely to differ
+        if (i % 2 == 1)
+            tau = (RNG.irn(0, 2 * MaxTauBin) - int(MaxTauBin)) / dBetaInverse;
+        int bin = tau < 0 ? floor(tau * dBetaInverse) + MaxTauBin : floor(tau * dBetaInverse);
+        IsSame &= (Map.TauIndex(tau) == bin);
+    }
+    sput_fail_unless(IsSame, "TauIndex is the same as binning with floor");
+}
+
+void Test_ComplexKernel()
+{
+    Complex c(1.0, 2.0);
+    sput_fail_unless(Equal(c + 1.0, 2.0, 2.0) && Equal(1.0 - c, 0.0, -2.0) && Equal(c - 1.0, 0.0, 2.0),
+                     "A real only changes the real part");
+    sput_fail_unless(Equal(2.0 / c, 0.4, -0.8) && Equal(c / c, 1.0, 0.0), "Check division");
+
+    const uint n = 101;
+    Complex x[n], y[n];
+    for (uint i = 0; i < n; i++) {
+        x[i] = Complex(i, -1.0 * i);
+        y[i] = Complex(1.0, i);
+    }
+    Scale(x, 2.0, n);
+    Add(x, y, n);
+    AddScaled(x, -1.0, y, n);
+    Scale(x, Complex(0.0, 1.0), n);
+    bool IsSame = true;
+    for (uint i = 0; i < n; i++)
+        IsSame &= Equal(x[i], Complex(2.0 * i, 2.0 * i));
+    sput_fail_unless(IsSame, "Bulk kernels agree with Complex arithmetic");
+    Accumulate(x, y, n);
+    sput_fail_unless(Equal(x[n - 1], Complex(2.0 * n - 1.0, 3.0 * n - 3.0)) && IsZero(y[n - 1]),
+                     "Accumulate empties the source");
+}
+
+void Test_ZeroCopy()
+{
+    para::ParaMC Para;
+    Para.SetTest();
+    Dictionary dict;
+    {
+        weight::Weight Source;
+        Source.SetTest(Para);
+        Source.Sigma->Estimator.Measure(3, 1, Complex(1.0, -2.0));
+        dict = Source.Sigma->Estimator.ToDict();
+    }
+    auto arr = dict.Get<Python::ArrayObject>("WeightAccu");
+    sput_fail_unless(Equal(arr.Data<Complex>()[3], Complex(1.0, -2.0)),
+                     "The array of ToDict outlives the estimator");
+
+    weight::Weight Target;
+    Target.SetTest(Para);
+    Target.Sigma->Estimator.FromDict(dict);
+    auto loaded = Target.Sigma->Estimator.ToDict().Get<Python::ArrayObject>("WeightAccu");
+    sput_fail_unless(loaded.Bytes() == arr.Bytes(), "FromDict uses the array in place");
+    Target.Sigma->Estimator.Measure(3, 1, Complex(1.0, 0.0));
+    Target.Sigma->Estimator.ToDict();
+    sput_fail_unless(Equal(arr.Data<Complex>()[3], Complex(2.0, -2.0)), "Measurements go into the adopted array");
+}
+
+//a statistics file of Sigma/Polar with WeightAccu[i]=Complex(i%Base, -Seed)
+void SaveStatis(const string& FileName, real Norm, real NormAccu, uint Order, int Seed, int Base = 11)
+{
+    vector<uint> shape = { Order, 2, 1, 2, 1, 4, 8 };
+    vector<Complex> accu(Order * 2 * 2 * 4 * 8);
+    for (uint i = 0; i < accu.size(); i++)
+        accu[i] = Complex(i % Base, -Seed);
+    Dictionary hist;
+    hist["Norm"] = Norm;
+    hist["NormAccu"] = NormAccu;
+    hist["WeightAccu"] = Python::ArrayObject("<c16", shape, accu.data());
+    Dictionary statis;
+    statis["Sigma"] = Dictionary("Histogram", Dictionary("SmoothT", hist));
+    statis["Polar"] = Dictionary("Histogram", Dictionary("SmoothT", hist));
+    statis.BigSave(FileName);
+}
+
+void Test_StatisReducer()
+{
+    vector<string> FileList = { "test_reduce_0_statis", "test_reduce_1_statis", "test_reduce_2_statis",
+                                "test_reduce_3_statis", "test_reduce_4_statis", "test_reduce_5_statis" };
+    ofstream(FileList[0] + CHECKPOINT_SUFFIX) << "broken";
+    SaveStatis(FileList[1], 2.0, 10.0, 3, 1);
+    SaveStatis(FileList[2], 2.0, 20.0, 3, 2, 7);
+    SaveStatis(FileList[3], 4.0, 30.0, 3, 3);
+    SaveStatis(FileList[4], 2.0, 40.0, 2, 4);
+    SaveStatis(FileList[5], 2.0, 50.0, 3, 5);
+    FileList.push_back("test_reduce_missing_statis");
+    SaveStatis("_test_reduce_statis", 2.0, 50.0, 3, 5);
+
+    vector<string> Found = GetStatisFileList(".");
+    sput_fail_unless(find(Found.begin(), Found.end(), "./" + FileList[5]) != Found.end()
+                         && find(Found.begin(), Found.end(), "./_test_reduce_statis") == Found.end(),
+                     "Statistics files are found as collect.GetFileList");
+
+    StatisReducer Reducer({ "Sigma", "Polar" }, 7);
+    uint Success = Reducer.Reduce(FileList, 3);
+    sput_fail_unless(Success == 3 && Reducer.Failure.size() == 4, "Broken, missing, other Norm and other shape are skipped");
+    Dictionary total = Reducer.ToDict();
+    Dictionary sigma = total.Get<Dictionary>("Sigma").Get<Dictionary>("Histogram").Get<Dictionary>("SmoothT");
+    auto accu = sigma.Get<Python::ArrayObject>("WeightAccu");
+    bool IsSame = (accu.Size() == 3 * 2 * 2 * 4 * 8 && accu.Shape()[0] == 3);
+    for (uint i = 0; i < accu.Size() && IsSame; i++)
+        IsSame &= Equal(accu.Data<Complex>()[i], Complex(i % 11 + i % 7 + i % 11, -8.0));
+    sput_fail_unless(IsSame, "WeightAccu is the sum of the merged files");
+    sput_fail_unless(Equal(sigma.Get<real>("NormAccu"), 80.0) && Equal(sigma.Get<real>("Norm"), 2.0),
+                     "NormAccu is the sum and Norm is kept");
+
+    StatisReducer Serial;
+    Serial.Reduce(FileList, 1);
+    auto serial = Serial.ToDict().Get<Dictionary>("Polar").Get<Dictionary>("Histogram").Get<Dictionary>("SmoothT").Get<Python::ArrayObject>("WeightAccu");
+    IsSame = true;
+    for (uint i = 0; i < accu.Size(); i++)
+        IsSame &= (serial.Data<Complex>()[i].Re == accu.Data<Complex>()[i].Re && serial.Data<Complex>()[i].Im == accu.Data<Complex>()[i].Im);
+    sput_fail_unless(IsSame, "Threads and chunks do not change the sum");
+
+    for (auto& f : FileList)
+        remove((f + CHECKPOINT_SUFFIX).c_str());
+    remove(("_test_reduce_statis" + CHECKPOINT_SUFFIX).c_str());
+}
+
+void Test_DirtyBlock()
+{
+    para::ParaMC Para;
+    Para.SetTest();
+    weight::Weight Master, Walker;
+    Master.SetTest(Para);
+    Walker.SetTest(Para);
+    string Sigma = "Sigma/Histogram/SmoothT/WeightAccu", Polar = "Polar/Histogram/SmoothT/WeightAccu";
+    DirtyMap Dirty = Master.TakeDirty(GW | SigmaPolar);
+    vector<uint8_t> flags = Dirty[Sigma];
+    sput_fail_unless(Dirty.size() == 5 && Dirty.count("W/DeltaT") == 1 && flags.size() > 2
+                         && count(flags.begin(), flags.end(), 1) == (int)flags.size(),
+                     "A new weight is dirty everywhere");
+
+    Master.Sigma->Estimator.Measure(DIRTY_BLOCK + 1, 1, Complex(1.0, 0.0));
+    Master.Sigma->Estimator.Merge(Walker.Sigma->Estimator);
+    flags = Master.TakeDirty(SigmaPolar)[Sigma];
+    sput_fail_unless(count(flags.begin(), flags.end(), 1) == 0, "Nothing is flagged unless the blocks are tracked");
+
+    Master.TrackDirty(true);
+    flags = Master.TakeDirty(SigmaPolar)[Sigma];
+    sput_fail_unless(count(flags.begin(), flags.end(), 1) == (int)flags.size(), "Tracking starts with the whole histogram dirty");
+    Master.Sigma->Estimator.Measure(DIRTY_BLOCK + 1, 1, Complex(1.0, 0.0));
+    Walker.Sigma->Estimator.Measure(2 * DIRTY_BLOCK, 1, Complex(1.0, 0.0));
+    Master.Sigma->Estimator.Merge(Walker.Sigma->Estimator);
+    Dirty = Master.TakeDirty(SigmaPolar);
+    flags = Dirty[Sigma];
+    sput_fail_unless(Dirty.size() == 2 && count(flags.begin(), flags.end(), 1) == 2 && flags[1] && flags[2]
+                         && count(Dirty[Polar].begin(), Dirty[Polar].end(), 1) == 0,
+                     "Only the blocks measured or merged are dirty");
+    flags = Master.TakeDirty(SigmaPolar)[Sigma];
+    sput_fail_unless(count(flags.begin(), flags.end(), 1) == 0, "Flags are cleared once they are taken");
+    Master.Sigma->Estimator.SqueezeStatistics(2.0);
+    flags = Master.TakeDirty(SigmaPolar)[Sigma];
+    sput_fail_unless(count(flags.begin(), flags.end(), 1) == (int)flags.size(), "Squeezing makes the whole histogram dirty");
+}
+
+void Test_ShardReuse()
+{
+    para::ParaMC Para;
+    Para.SetTest();
+    weight::Weight Sharded;
+    Sharded.SetTest(Para);
+    Sharded.Sigma->Estimator.SetAccumulation(SHARDED);
+    //more threads than shards over the whole run, but never more than NThread at the same time
+    int NRound = 2 * MAX_SHARD / NThread + 1;
+    for (int r = 0; r < NRound; r++) {
+        vector<thread> threads;
+        for (int t = 0; t < NThread; t++)
+            threads.push_back(thread([&Sharded]() { Sharded.Sigma->Estimator.MeasureNorm(1.0); }));
+        for (auto& t : threads)
+            t.join();
+    }
+    sput_fail_unless(Sharded.Sigma->Estimator.ToDict().Get<real>("NormAccu") == NRound * NThread,
+                     "Ids of exited threads are reused by new ones");
+}
@@ -13,7 +13,11 @@
 #include "lattice/lattice.h"
 #include "estimator/estimator.h"
 #include "module/weight/component.h"
+#include "module/dyson/dyson.h"
 #include "utility/dictionary.h"
+#include "utility/checkpoint.h"
+#include "utility/lu.h"
+#include "utility/fft.h"
 
 using namespace std;
 
@@ -36,6 +40,12 @@ int RunTest()
     //    TEST(TestEstimator);
 
     //    TEST(TestDictionary);
+    //    TEST(TestCheckpoint);
+    //    TEST(TestEnvironment);
+    //    TEST(weight::TestWeight);
+    //    TEST(dyson::TestDyson);
+    //    TEST(TestLU);
+    //    TEST(TestFFT);
 
     return 0;
 }
@@ -0,0 +1,84 @@
+//
+//  reduce_statis.cpp
+//  Feynman_Simulator
+//
+//  Created by Kun Chen on 3/5/15.
+//  Copyright (c) 2015 Kun Chen. All rights reserved.
+//
+
+/**
+*  Sum the Sigma/Polar statistics of all MC jobs of a workspace into one checkpoint, the native version of
+*  running dyson/collect.py directly. Statistics files are the *_statis.ckpt files of Dir which do not start
+*  with "_"; the old .hkl files have to be collected in python.
+*  It fails if less than AcceptRatio of the files can be merged, the same as collect.CollectStatis.
+*
+*  Usage: reduce_statis.exe [-n NThread] [-c ChunkSize] [-o OutputFile] [Dir]
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include "utility/pyglue/pywrapper.h"
+#include "utility/dictionary.h"
+#include "utility/logger.h"
+#include "module/weight/statis_reducer.h"
+
+using namespace std;
+
+const real AcceptRatio = 0.75;
+const string Usage = "Usage: reduce_statis.exe [-n NThread] [-c ChunkSize] [-o OutputFile] [Dir]";
+
+//all python objects are gone when it returns, before Python::Finalize
+int Reduce(const string& Dir, const string& OutputFile, int NThread, uint ChunkSize)
+{
+    vector<string> FileList = weight::GetStatisFileList(Dir);
+    if (FileList.empty()) {
+        LOG_ERROR("No statistics files to read in " << Dir << "!");
+        return EXIT_FAILURE;
+    }
+    LOG_INFO("Collect statistics from " << FileList.size() << " files in " << Dir);
+    weight::StatisReducer Reducer({ "Sigma", "Polar" }, ChunkSize);
+    uint Success = Reducer.Reduce(FileList, NThread);
+    for (auto& failure : Reducer.Failure)
+        LOG_WARNING("Fails to merge " << failure.first << ": " << failure.second);
+    LOG_INFO(Success << "/" << FileList.size() << " statistics files read!");
+    if (Success < AcceptRatio * FileList.size()) {
+        LOG_ERROR("More than " << 100.0 * (1.0 - AcceptRatio) << "% statistics files fail to read!");
+        return EXIT_FAILURE;
+    }
+    Reducer.ToDict().BigSave(OutputFile);
+    LOG_INFO("Statistics are saved in " << OutputFile);
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, const char* argv[])
+{
+    string Dir = ".", OutputFile;
+    int NThread = 0;
+    uint ChunkSize = 1 << 16;
+    int i = 1;
+    for (; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+        if (strcmp(argv[i], "-n") == 0)
+            NThread = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-c") == 0)
+            ChunkSize = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-o") == 0)
+            OutputFile = argv[i + 1];
+        else
+            ABORT("Unknown argument " << argv[i] << "\n" << Usage);
+    }
+    if (i < argc)
+        Dir = argv[i++];
+    ASSERT_ALLWAYS(i == argc, "Unknown argument " << argv[i] << "\n" << Usage);
+    if (OutputFile.empty())
+        OutputFile = Dir + "/statis_total";
+
+    Python::Initialize();
+    Python::ArrayInitialize();
+    LOGGER_CONF("reduce_statis.log", "reduce", Logger::file_on | Logger::screen_on, INFO, INFO);
+    int result = Reduce(Dir, OutputFile, NThread, ChunkSize);
+    Python::Finalize();
+    return result;
+}
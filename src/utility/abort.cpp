@@ -50,6 +50,6 @@ void InterruptHandler::Resume()
     if (__IsDelaying && (__Signal == SIGINT || __Signal == SIGTERM)) {
         __SignalHandler(__Signal);
         __Signal = -1;
-        __IsDelaying = false;
     }
+    __IsDelaying = false;
 }
@@ -0,0 +1,1066 @@
+//
+//  checkpoint.cpp
+//  Feynman_Simulator
+//
+//  Created by Kun Chen on 3/3/15.
+//  Copyright (c) 2015 Kun Chen. All rights reserved.
+//
+
+#include "checkpoint.h"
+#include "utility/complex.h"
+#include "utility/dictionary.h"
+#include "utility/scopeguard.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+
+using namespace std;
+
+const char CHECKPOINT_MAGIC[8] = { 'F', 'S', 'C', 'K', 'P', 'T', 0, 0 };
+const char DELTA_MAGIC[8] = { 'F', 'S', 'D', 'E', 'L', 'T', 'A', 0 };
+const char DELTA_RECORD[8] = { 'F', 'S', 'R', 'E', 'C', 'O', 'R', 'D' };
+const int HEADER_SIZE = 64;
+const uint64_t RECORD_HEADER_SIZE = 24;
+
+inline uint64_t AlignUp(uint64_t offset, int align)
+{
+    return (offset + align - 1) / align * align;
+}
+
+template <typename T>
+void Append(string& buffer, const T& value)
+{
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+/**
+*  the temporary file is in the same directory as the target, with a leading "_", like IO.py does,
+*  so that rename is atomic and collect.py ignores it
+*/
+string TemporaryName(const string& FileName)
+{
+    size_t slash = FileName.rfind('/');
+    if (slash == string::npos)
+        return "_" + FileName;
+    return FileName.substr(0, slash + 1) + "_" + FileName.substr(slash + 1);
+}
+
+/**
+*  write Target through a temporary file, which is synced and then renamed, so Target is always complete
+*/
+static void WriteThroughTemporary(const string& Target, const function<bool(FILE*)>& Body)
+{
+    string Temp = TemporaryName(Target);
+    FILE* file = fopen(Temp.c_str(), "wb");
+    if (file == nullptr)
+        THROW(IOInvalid, "Fail to open " << Temp << " to write!", WARNING);
+    bool IsGood = true;
+    ON_SCOPE_EXIT([&] {
+        if (file != nullptr)
+            fclose(file);
+        if (!IsGood)
+            remove(Temp.c_str());
+    });
+    IsGood = Body(file);
+    IsGood = IsGood && fflush(file) == 0 && fsync(fileno(file)) == 0;
+    IsGood = fclose(file) == 0 && IsGood;
+    file = nullptr;
+    if (!IsGood)
+        THROW(IOInvalid, "Fail to write " << Temp << "!", WARNING);
+    if (rename(Temp.c_str(), Target.c_str()) != 0) {
+        IsGood = false;
+        THROW(IOInvalid, "Fail to rename " << Temp << " to " << Target << "!", WARNING);
+    }
+}
+
+static string EncodeIndex(const vector<CheckpointEntry>& Entries)
+{
+    string Index;
+    for (auto& entry : Entries) {
+        Append(Index, (uint8_t)entry.Type);
+        Append(Index, (uint8_t)entry.DType.size());
+        Append(Index, (uint16_t)entry.Shape.size());
+        Append(Index, (uint32_t)entry.Key.size());
+        Append(Index, (int64_t)entry.Parent);
+        Append(Index, (uint64_t)entry.Offset);
+        Append(Index, (uint64_t)entry.Size);
+        for (auto n : entry.Shape)
+            Append(Index, (uint64_t)n);
+        Index += entry.DType;
+        Index += entry.Key;
+    }
+    return Index;
+}
+
+static uint32_t Checksum(const char* data, uint64_t size)
+{
+    uLong crc = crc32(0L, Z_NULL, 0);
+    while (size > 0) {
+        uInt n = (uInt)min<uint64_t>(size, 1 << 30);
+        crc = crc32(crc, reinterpret_cast<const Bytef*>(data), n);
+        data += n;
+        size -= n;
+    }
+    return crc;
+}
+
+/**
+*  byte k of every 8-byte word goes into the plane k, so that the exponents and the high bytes of
+*  the mantissas of doubles are next to each other for zlib
+*/
+static string Shuffle(const string& data)
+{
+    uint64_t n = data.size() / 8;
+    string planes(data);
+    for (uint64_t w = 0; w < n; w++)
+        for (int k = 0; k < 8; k++)
+            planes[k * n + w] = data[w * 8 + k];
+    return planes;
+}
+
+static string Unshuffle(const string& planes)
+{
+    uint64_t n = planes.size() / 8;
+    string data(planes);
+    for (uint64_t w = 0; w < n; w++)
+        for (int k = 0; k < 8; k++)
+            data[w * 8 + k] = planes[k * n + w];
+    return data;
+}
+
+static string Compress(const string& data)
+{
+    uLongf size = compressBound(data.size());
+    string zipped(size, 0);
+    if (compress2(reinterpret_cast<Bytef*>(&zipped[0]), &size, reinterpret_cast<const Bytef*>(data.data()),
+                  data.size(), Z_BEST_SPEED) != Z_OK)
+        THROW(IOInvalid, "Fail to compress a delta!", WARNING);
+    zipped.resize(size);
+    return zipped;
+}
+
+//data has to have the size of the uncompressed bytes
+static bool Uncompress(const char* zipped, uint64_t size, string& data)
+{
+    uLongf n = data.size();
+    return uncompress(reinterpret_cast<Bytef*>(&data[0]), &n, reinterpret_cast<const Bytef*>(zipped), size) == Z_OK
+           && n == data.size();
+}
+
+/**
+*  the BaseID of a new base, different for every base of every process
+*/
+static uint64_t NewBaseID()
+{
+    static atomic<uint64_t> Counter(0);
+    uint64_t id = chrono::system_clock::now().time_since_epoch().count();
+    id ^= ((uint64_t)getpid() << 40) ^ (++Counter << 20);
+    return id == 0 ? 1 : id;
+}
+
+/**********************   CheckpointWriter  **************************/
+
+CheckpointWriter::CheckpointWriter()
+{
+    Clear();
+}
+
+void CheckpointWriter::Clear()
+{
+    _Entries.clear();
+    _Payload.clear();
+    _Copies.clear();
+    _Arrays.clear();
+    _DoesCopy = false;
+    _DataEnd = HEADER_SIZE;
+    _Tracked = nullptr;
+    _IsDelta = false;
+    _TrackedSize.clear();
+    _Delta.clear();
+}
+
+void CheckpointWriter::_Add(CheckpointEntry& entry, const char* payload, int align)
+{
+    if (entry.Size > 0) {
+        entry.Offset = AlignUp(_DataEnd, align);
+        _DataEnd = entry.Offset + entry.Size;
+    }
+    else
+        entry.Offset = 0;
+    if (_DoesCopy && payload != nullptr) {
+        _Copies.push_back(string(payload, entry.Size));
+        payload = _Copies.back().data();
+    }
+    _Entries.push_back(entry);
+    _Payload.push_back(payload);
+}
+
+void CheckpointWriter::Encode(const Dictionary& dict, bool DoesCopy, const DirtyMap* Tracked, bool IsDelta)
+{
+    Clear();
+    _DoesCopy = DoesCopy;
+    _Tracked = Tracked;
+    _IsDelta = Tracked != nullptr && IsDelta;
+    _EncodeDict(dict, -1, "");
+    _Tracked = nullptr;
+    //python objects are not needed once the payloads have been copied
+    if (_DoesCopy)
+        _Arrays.clear();
+}
+
+void CheckpointWriter::Add(CheckpointEntry entry, const char* payload)
+{
+    _Add(entry, payload, entry.Type == CK_ARRAY ? CHECKPOINT_ALIGN : 8);
+}
+
+void CheckpointWriter::_EncodeDict(const Dictionary& dict, int64_t Parent, const string& Key)
+{
+    CheckpointEntry entry{ CK_DICT, Parent, Key, "", {}, 0, 0 };
+    _Add(entry, nullptr, 1);
+    int64_t self = _Entries.size() - 1;
+    for (auto& item : dict)
+        _EncodeValue(item.second, self, item.first);
+}
+
+void CheckpointWriter::_EncodeValue(const Python::AnyObject& obj, int64_t Parent, const string& Key)
+{
+    CheckpointEntry entry{ CK_NONE, Parent, Key, "", {}, 0, 0 };
+    Dictionary dict;
+    vector<Python::AnyObject> list;
+    Python::ArrayObject array;
+    bool b;
+    long long i;
+    real r;
+    Complex c;
+    string s;
+    //bool has to be checked before int, and int before real, since python converts them implicitly
+    if (dict.FromPy(obj))
+        _EncodeDict(dict, Parent, Key);
+    else if (Python::Convert(obj, list)) {
+        entry.Type = CK_LIST;
+        _Add(entry, nullptr, 1);
+        int64_t self = _Entries.size() - 1;
+        for (auto& item : list)
+            _EncodeValue(item, self, "");
+    }
+    else if (Python::Convert(obj, array)) {
+        entry.Type = CK_ARRAY;
+        entry.DType = array.DType();
+        for (auto n : array.Shape())
+            entry.Shape.push_back(n);
+        entry.Size = array.NBytes();
+        //keep the array alive, it may be a contiguous copy of obj
+        _Arrays.push_back(make_shared<Python::ArrayObject>(array));
+        if (!_EncodeTracked(entry, array.Bytes()))
+            _Add(entry, array.Bytes(), CHECKPOINT_ALIGN);
+    }
+    else {
+        string payload;
+        if (Python::Convert(obj, b)) {
+            entry.Type = CK_BOOL;
+            Append(payload, (uint8_t)b);
+        }
+        else if (Python::Convert(obj, i)) {
+            entry.Type = CK_INT;
+            Append(payload, (int64_t)i);
+        }
+        else if (Python::Convert(obj, r)) {
+            entry.Type = CK_REAL;
+            Append(payload, (double)r);
+        }
+        else if (Python::Convert(obj, c)) {
+            entry.Type = CK_COMPLEX;
+            Append(payload, (double)c.Re);
+            Append(payload, (double)c.Im);
+        }
+        else if (Python::Convert(obj, s)) {
+            entry.Type = CK_STRING;
+            payload = s;
+        }
+        else
+            THROW_ERROR(TypeInvalid, Key << " can not be saved into a checkpoint: " << Python::AnyObject(obj).PrettyString());
+        entry.Size = payload.size();
+        //small payloads are always copied
+        _Copies.push_back(payload);
+        bool DoesCopy = _DoesCopy;
+        _DoesCopy = false;
+        _Add(entry, _Copies.back().data(), 8);
+        _DoesCopy = DoesCopy;
+    }
+}
+
+/**
+*  an array at a tracked path of a delta is added without its payload, and only its flagged blocks are copied;
+*  false if the array has to be encoded as usual
+*/
+bool CheckpointWriter::_EncodeTracked(CheckpointEntry& entry, const char* payload)
+{
+    if (_Tracked == nullptr)
+        return false;
+    string Path = entry.Key;
+    for (int64_t i = entry.Parent; i > 0; i = _Entries[i].Parent)
+        Path = _Entries[i].Key + "/" + Path;
+    auto flags = _Tracked->find(Path);
+    if (flags == _Tracked->end())
+        return false;
+    _TrackedSize[Path] = entry.Size;
+    if (!_IsDelta)
+        return false;
+    DeltaArray delta{ Path, entry.Size, {}, "" };
+    uint64_t NBlock = (entry.Size + DELTA_BLOCK - 1) / DELTA_BLOCK;
+    //flags of another size do not belong to this array, all blocks are taken
+    bool IsAll = flags->second.size() != NBlock;
+    for (uint64_t b = 0; b < NBlock; b++)
+        if (IsAll || flags->second[b]) {
+            delta.Block.push_back(b);
+            delta.Data.append(payload + b * DELTA_BLOCK, min(DELTA_BLOCK, entry.Size - b * DELTA_BLOCK));
+        }
+    _Delta.push_back(move(delta));
+    entry.Size = 0;
+    _Add(entry, nullptr, CHECKPOINT_ALIGN);
+    return true;
+}
+
+/**
+*  pass the bytes of the file to Output in order, return the size of the file, or 0 if Output fails
+*/
+uint64_t CheckpointWriter::_Emit(uint64_t Tag, const function<bool(const char*, uint64_t)>& Output) const
+{
+    string Index = EncodeIndex(_Entries);
+    uint64_t IndexOffset = AlignUp(_DataEnd, 8);
+
+    string Header(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    Append(Header, CHECKPOINT_VERSION);
+    Append(Header, (uint32_t)0);
+    Append(Header, (uint64_t)_Entries.size());
+    Append(Header, IndexOffset);
+    Append(Header, (uint64_t)Index.size());
+    Append(Header, Tag);
+    Header.resize(HEADER_SIZE, 0);
+
+    bool IsGood = true;
+    uint64_t Position = 0;
+    auto WriteAt = [&](uint64_t Offset, const char* data, uint64_t size) {
+        static const char Zeros[CHECKPOINT_ALIGN] = { 0 };
+        while (IsGood && Position < Offset) {
+            uint64_t n = min<uint64_t>(Offset - Position, CHECKPOINT_ALIGN);
+            IsGood = Output(Zeros, n);
+            Position += n;
+        }
+        if (IsGood && size > 0)
+            IsGood = Output(data, size);
+        Position += size;
+    };
+    WriteAt(0, Header.data(), Header.size());
+    for (uint i = 0; i < _Entries.size(); i++)
+        if (_Entries[i].Size > 0)
+            WriteAt(_Entries[i].Offset, _Payload[i], _Entries[i].Size);
+    WriteAt(IndexOffset, Index.data(), Index.size());
+    return IsGood ? Position : 0;
+}
+
+uint64_t CheckpointWriter::Write(const string& FileName, uint64_t Tag)
+{
+    uint64_t Size = 0;
+    WriteThroughTemporary(FileName + CHECKPOINT_SUFFIX, [&](FILE* file) {
+        Size = _Emit(Tag, [file](const char* data, uint64_t size) { return fwrite(data, 1, size, file) == size; });
+        return Size > 0;
+    });
+    return Size;
+}
+
+string CheckpointWriter::Image(uint64_t Tag) const
+{
+    string image;
+    _Emit(Tag, [&image](const char* data, uint64_t size) {
+        image.append(data, size);
+        return true;
+    });
+    return image;
+}
+
+uint64_t CheckpointWriter::AppendDelta(const string& FileName) const
+{
+    string Payload, image = Image();
+    Append(Payload, (uint64_t)image.size());
+    Payload += image;
+    Append(Payload, (uint32_t)_Delta.size());
+    for (auto& delta : _Delta) {
+        Append(Payload, (uint32_t)delta.Path.size());
+        Payload += delta.Path;
+        Append(Payload, delta.Size);
+        Append(Payload, (uint64_t)delta.Block.size());
+        for (auto b : delta.Block)
+            Append(Payload, b);
+        string zipped = delta.Data.empty() ? "" : Compress(Shuffle(delta.Data));
+        Append(Payload, (uint64_t)zipped.size());
+        Payload += zipped;
+    }
+    string Record(DELTA_RECORD, sizeof(DELTA_RECORD));
+    Append(Record, (uint64_t)Payload.size());
+    Append(Record, Checksum(Payload.data(), Payload.size()));
+    Append(Record, (uint32_t)0);
+    Record += Payload;
+
+    string Target = FileName + DELTA_SUFFIX;
+    //without O_CREAT, a record never goes into a log without its header
+    int fd = open(Target.c_str(), O_WRONLY | O_APPEND);
+    if (fd < 0)
+        THROW(IOInvalid, "Fail to open " << Target << " to append!", WARNING);
+    ON_SCOPE_EXIT([&] { close(fd); });
+    const char* p = Record.data();
+    uint64_t Left = Record.size();
+    while (Left > 0) {
+        ssize_t n = write(fd, p, Left);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            THROW(IOInvalid, "Fail to append to " << Target << "!", WARNING);
+        p += n;
+        Left -= n;
+    }
+    if (fsync(fd) != 0)
+        THROW(IOInvalid, "Fail to sync " << Target << "!", WARNING);
+    return Record.size();
+}
+
+void ResetDelta(const string& FileName, uint64_t BaseID)
+{
+    string Header(DELTA_MAGIC, sizeof(DELTA_MAGIC));
+    Append(Header, DELTA_VERSION);
+    Append(Header, (uint32_t)DELTA_BLOCK);
+    Append(Header, BaseID);
+    Header.resize(HEADER_SIZE, 0);
+    WriteThroughTemporary(FileName + DELTA_SUFFIX, [&Header](FILE* file) {
+        return fwrite(Header.data(), 1, Header.size(), file) == Header.size();
+    });
+}
+
+/**********************   CheckpointReader  **************************/
+
+void CheckpointReader::Open(const string& FileName)
+{
+    Close();
+    string Target = FileName + CHECKPOINT_SUFFIX;
+    int fd = open(Target.c_str(), O_RDONLY);
+    if (fd < 0)
+        THROW(IOInvalid, "Fail to open " << Target << "!", WARNING);
+    ON_SCOPE_EXIT([&] { close(fd); });
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < HEADER_SIZE)
+        THROW(IOInvalid, Target << " is not a checkpoint file!", WARNING);
+    uint64_t size = info.st_size;
+    void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED)
+        THROW(IOInvalid, "Fail to map " << Target << "!", WARNING);
+    _Map = shared_ptr<const char>(static_cast<const char*>(addr), [size](const char* p) { munmap((void*)p, size); });
+    _MapSize = size;
+    _Parse(Target);
+}
+
+//number of bytes of one item of a numpy typestr, like 16 for "<c16", 0 if it is not a known one
+static uint64_t ItemSize(const string& DType)
+{
+    if (DType.size() < 3 || (DType[0] != '<' && DType[0] != '|') || strchr("bifuc", DType[1]) == nullptr)
+        return 0;
+    uint64_t n = 0;
+    for (uint i = 2; i < DType.size(); i++) {
+        if (DType[i] < '0' || DType[i] > '9' || n > 64)
+            return 0;
+        n = n * 10 + (DType[i] - '0');
+    }
+    return n;
+}
+
+/**
+*  the payload of a scalar has the size of its type, the one of an array is prod(Shape) items of DType;
+*  an array without a payload is allowed, its payload is in the delta log
+*/
+bool CheckpointReader::_CheckSize(const CheckpointEntry& entry)
+{
+    switch (entry.Type) {
+    case CK_NONE:
+    case CK_DICT:
+    case CK_LIST:
+    case CK_STRING:
+        return true;
+    case CK_BOOL:
+        return entry.Size == 1;
+    case CK_INT:
+    case CK_REAL:
+        return entry.Size == 8;
+    case CK_COMPLEX:
+        return entry.Size == 16;
+    case CK_ARRAY: {
+        uint64_t bytes = ItemSize(entry.DType);
+        if (bytes == 0)
+            return false;
+        if (entry.Size == 0)
+            return true;
+        for (auto n : entry.Shape) {
+            if (n == 0 || bytes > entry.Size / n)
+                return false;
+            bytes *= n;
+        }
+        return bytes == entry.Size;
+    }
+    default:
+        return false;
+    }
+}
+
+/**
+*  read the header and the index of the checkpoint in _Map, which is closed if it is broken
+*/
+void CheckpointReader::_Parse(const string& Name)
+{
+    const char* base = _Map.get();
+    uint64_t size = _MapSize;
+    if (size < HEADER_SIZE) {
+        Close();
+        THROW(IOInvalid, Name << " is not a checkpoint file!", WARNING);
+    }
+    uint32_t Version;
+    uint64_t NEntry, IndexOffset, IndexSize;
+    memcpy(&Version, base + 8, sizeof(Version));
+    memcpy(&NEntry, base + 16, sizeof(NEntry));
+    memcpy(&IndexOffset, base + 24, sizeof(IndexOffset));
+    memcpy(&IndexSize, base + 32, sizeof(IndexSize));
+    memcpy(&_Tag, base + 40, sizeof(_Tag));
+    if (memcmp(base, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0 || Version > CHECKPOINT_VERSION
+        || IndexOffset > size || IndexSize > size - IndexOffset) {
+        Close();
+        THROW(IOInvalid, Name << " is not a valid checkpoint file of version " << CHECKPOINT_VERSION << "!", WARNING);
+    }
+
+    const char* p = base + IndexOffset;
+    const char* end = p + IndexSize;
+    auto Read = [&](void* value, uint64_t n) {
+        if ((uint64_t)(end - p) < n)
+            return false;
+        memcpy(value, p, n);
+        p += n;
+        return true;
+    };
+    bool IsGood = true;
+    for (uint64_t i = 0; i < NEntry && IsGood; i++) {
+        uint8_t Type, DTypeSize;
+        uint16_t NDim;
+        uint32_t KeySize;
+        CheckpointEntry entry;
+        IsGood = Read(&Type, 1) && Read(&DTypeSize, 1) && Read(&NDim, 2) && Read(&KeySize, 4)
+                 && Read(&entry.Parent, 8) && Read(&entry.Offset, 8) && Read(&entry.Size, 8);
+        //the lengths are checked against the rest of the index before anything is allocated
+        IsGood = IsGood && (uint64_t)NDim * 8 + DTypeSize + KeySize <= (uint64_t)(end - p);
+        if (!IsGood)
+            break;
+        entry.Type = CheckpointType(Type);
+        entry.Shape.resize(NDim);
+        for (auto& n : entry.Shape)
+            Read(&n, 8);
+        entry.DType.assign(p, DTypeSize);
+        p += DTypeSize;
+        entry.Key.assign(p, KeySize);
+        p += KeySize;
+        IsGood = entry.Offset <= size && entry.Size <= size - entry.Offset && _CheckSize(entry);
+        IsGood = IsGood && entry.Parent < (int64_t)i && (entry.Parent >= 0 || i == 0);
+        if (IsGood)
+            _Entries.push_back(entry);
+    }
+    if (!IsGood || _Entries.empty() || _Entries[0].Type != CK_DICT) {
+        Close();
+        THROW(IOInvalid, Name << " has a broken index!", WARNING);
+    }
+    _Children.resize(_Entries.size());
+    for (uint64_t i = 1; i < _Entries.size(); i++)
+        _Children[_Entries[i].Parent].push_back(i);
+}
+
+bool CheckpointReader::ReplayDelta(const string& FileName)
+{
+    ASSERT_ALLWAYS(IsOpen(), "Checkpoint has not been opened!");
+    string Target = FileName + DELTA_SUFFIX;
+    ifstream file(Target, ios::in | ios::binary);
+    if (_Tag == 0 || !file.is_open())
+        return false;
+    string Log((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    uint32_t Version, BlockSize;
+    uint64_t BaseID;
+    if (Log.size() < HEADER_SIZE || memcmp(Log.data(), DELTA_MAGIC, sizeof(DELTA_MAGIC)) != 0) {
+        LOG_WARNING(Target << " is not a delta log, it is ignored!");
+        return false;
+    }
+    memcpy(&Version, &Log[8], sizeof(Version));
+    memcpy(&BlockSize, &Log[12], sizeof(BlockSize));
+    memcpy(&BaseID, &Log[16], sizeof(BaseID));
+    if (Version > DELTA_VERSION || BlockSize != DELTA_BLOCK) {
+        LOG_WARNING(Target << " is not a delta log of version " << DELTA_VERSION << ", it is ignored!");
+        return false;
+    }
+    //the log of an older base is left if a compaction is interrupted, the base is already the latest state
+    if (BaseID != _Tag)
+        return false;
+
+    map<string, string> Arrays;
+    string Image;
+    uint64_t p = HEADER_SIZE, NRecord = 0;
+    while (Log.size() - p >= RECORD_HEADER_SIZE) {
+        uint64_t size;
+        uint32_t crc;
+        memcpy(&size, &Log[p + 8], sizeof(size));
+        memcpy(&crc, &Log[p + 16], sizeof(crc));
+        if (memcmp(&Log[p], DELTA_RECORD, sizeof(DELTA_RECORD)) != 0 || size > Log.size() - p - RECORD_HEADER_SIZE)
+            break;
+        const char* record = &Log[p + RECORD_HEADER_SIZE];
+        if (Checksum(record, size) != crc || !_ApplyRecord(record, size, Arrays, Image))
+            break;
+        p += RECORD_HEADER_SIZE + size;
+        NRecord++;
+    }
+    if (p < Log.size())
+        LOG_WARNING("The last " << Log.size() - p << " bytes of " << Target << " are not a complete record, they are dropped!");
+    if (NRecord == 0)
+        return false;
+
+    //the image of the last record with the replayed arrays in place of the empty ones
+    CheckpointReader last;
+    auto image = make_shared<string>(move(Image));
+    last._Map = shared_ptr<const char>(image, image->data());
+    last._MapSize = image->size();
+    last._Parse(Target);
+    CheckpointWriter writer;
+    for (uint64_t i = 0; i < last._Entries.size(); i++) {
+        CheckpointEntry entry = last._Entries[i];
+        auto array = Arrays.find(last._Path(i));
+        if (i > 0 && entry.Type == CK_ARRAY && entry.Size == 0 && array != Arrays.end()) {
+            entry.Size = array->second.size();
+            writer.Add(entry, array->second.data());
+        }
+        else
+            writer.Add(entry, last.Payload(entry));
+    }
+    auto state = make_shared<string>(writer.Image(_Tag));
+    Close();
+    _Map = shared_ptr<const char>(state, state->data());
+    _MapSize = state->size();
+    _Parse(Target);
+    _HasDelta = true;
+    return true;
+}
+
+/**
+*  write the blocks of a record over Arrays, an array is copied from the base when it shows up the first time;
+*  false, with Arrays untouched, if the record does not fit the base
+*/
+bool CheckpointReader::_ApplyRecord(const char* record, uint64_t size, map<string, string>& Arrays,
+                                    string& Image) const
+{
+    const char* p = record;
+    const char* end = record + size;
+    auto Read = [&](void* value, uint64_t n) {
+        if ((uint64_t)(end - p) < n)
+            return false;
+        memcpy(value, p, n);
+        p += n;
+        return true;
+    };
+    uint64_t ImageSize;
+    if (!Read(&ImageSize, 8) || ImageSize > (uint64_t)(end - p))
+        return false;
+    string image(p, ImageSize);
+    p += ImageSize;
+    uint32_t NArray;
+    if (!Read(&NArray, 4))
+        return false;
+    struct Change {
+        string Path;
+        uint64_t Size;
+        vector<uint64_t> Block;
+        string Data;
+    };
+    vector<Change> Changes;
+    for (uint32_t a = 0; a < NArray; a++) {
+        Change change;
+        uint32_t PathSize;
+        uint64_t NBlock, ZipSize, Bytes = 0;
+        if (!Read(&PathSize, 4) || PathSize > (uint64_t)(end - p))
+            return false;
+        change.Path.assign(p, PathSize);
+        p += PathSize;
+        if (!Read(&change.Size, 8) || !Read(&NBlock, 8) || NBlock > (uint64_t)(end - p) / 8)
+            return false;
+        change.Block.resize(NBlock);
+        for (auto& b : change.Block) {
+            Read(&b, 8);
+            if (b >= (change.Size + DELTA_BLOCK - 1) / DELTA_BLOCK)
+                return false;
+            Bytes += min(DELTA_BLOCK, change.Size - b * DELTA_BLOCK);
+        }
+        if (!Read(&ZipSize, 8) || ZipSize > (uint64_t)(end - p) || (Bytes == 0) != (ZipSize == 0))
+            return false;
+        change.Data.resize(Bytes);
+        if (Bytes > 0 && !Uncompress(p, ZipSize, change.Data))
+            return false;
+        p += ZipSize;
+        change.Data = Unshuffle(change.Data);
+        auto array = Arrays.find(change.Path);
+        const CheckpointEntry* entry = Find(change.Path);
+        if (array != Arrays.end() ? array->second.size() != change.Size
+                                  : (entry == nullptr || entry->Type != CK_ARRAY || entry->Size != change.Size))
+            return false;
+        Changes.push_back(move(change));
+    }
+    for (auto& change : Changes) {
+        auto array = Arrays.find(change.Path);
+        if (array == Arrays.end()) {
+            const CheckpointEntry* entry = Find(change.Path);
+            array = Arrays.insert(make_pair(change.Path, string(Payload(*entry), entry->Size))).first;
+        }
+        uint64_t offset = 0;
+        for (auto b : change.Block) {
+            uint64_t n = min(DELTA_BLOCK, change.Size - b * DELTA_BLOCK);
+            memcpy(&array->second[b * DELTA_BLOCK], change.Data.data() + offset, n);
+            offset += n;
+        }
+    }
+    Image.swap(image);
+    return true;
+}
+
+void CheckpointReader::Close()
+{
+    _Map.reset();
+    _MapSize = 0;
+    _Tag = 0;
+    _HasDelta = false;
+    _Entries.clear();
+    _Children.clear();
+}
+
+string CheckpointReader::_Path(int64_t i) const
+{
+    string Path = _Entries[i].Key;
+    for (int64_t p = _Entries[i].Parent; p > 0; p = _Entries[p].Parent)
+        Path = _Entries[p].Key + "/" + Path;
+    return Path;
+}
+
+bool CheckpointReader::IsOpen() const
+{
+    return _Map != nullptr;
+}
+
+const char* CheckpointReader::Payload(const CheckpointEntry& entry) const
+{
+    return _Map.get() + entry.Offset;
+}
+
+void CheckpointReader::DropPages(const char* Begin, const char* End) const
+{
+    if (_HasDelta || !IsOpen())
+        return;
+    const char* base = _Map.get();
+    uintptr_t page = sysconf(_SC_PAGESIZE);
+    //only whole pages inside [Begin, End) are dropped, their neighbours may still be needed
+    uintptr_t first = ((uintptr_t)max(Begin, base) + page - 1) / page * page;
+    uintptr_t last = (uintptr_t)min(End, base + _MapSize) / page * page;
+    if (first < last)
+        madvise((void*)first, last - first, MADV_DONTNEED);
+}
+
+const CheckpointEntry* CheckpointReader::Find(const string& Path) const
+{
+    if (_Entries.empty())
+        return nullptr;
+    int64_t current = 0;
+    size_t start = 0;
+    while (start <= Path.size()) {
+        size_t slash = Path.find('/', start);
+        if (slash == string::npos)
+            slash = Path.size();
+        string key = Path.substr(start, slash - start);
+        int64_t next = -1;
+        for (auto child : _Children[current])
+            if (_Entries[child].Key == key)
+                next = child;
+        if (next < 0)
+            return nullptr;
+        current = next;
+        start = slash + 1;
+    }
+    return &_Entries[current];
+}
+
+Python::AnyObject CheckpointReader::_Decode(int64_t i) const
+{
+    const CheckpointEntry& entry = _Entries[i];
+    const char* payload = Payload(entry);
+    auto Value = [&](int n) {
+        double v;
+        memcpy(&v, payload + n * sizeof(double), sizeof(double));
+        return v;
+    };
+    switch (entry.Type) {
+    case CK_DICT:
+        return Python::AnyObject(_DecodeDict(i));
+    case CK_LIST: {
+        vector<Python::AnyObject> list;
+        for (auto child : _Children[i])
+            list.push_back(_Decode(child));
+        return Python::AnyObject(list);
+    }
+    case CK_BOOL:
+        return Python::AnyObject(bool(payload[0]));
+    case CK_INT: {
+        int64_t v;
+        memcpy(&v, payload, sizeof(v));
+        return Python::AnyObject((long long)v);
+    }
+    case CK_REAL:
+        return Python::AnyObject(Value(0));
+    case CK_COMPLEX:
+        return Python::AnyObject(Complex(Value(0), Value(1)));
+    case CK_STRING:
+        return Python::AnyObject(string(payload, entry.Size));
+    case CK_ARRAY: {
+        vector<uint> shape(entry.Shape.begin(), entry.Shape.end());
+        uint64_t count = 1;
+        for (auto n : entry.Shape)
+            count *= n;
+        if (entry.Size == 0 && count > 0)
+            THROW(IOInvalid, "Array " << entry.Key << " has no payload without its delta log!", WARNING);
+        return Python::AnyObject(Python::ArrayObject(entry.DType, shape, payload));
+    }
+    default:
+        THROW(IOInvalid, "Unknown type " << entry.Type << " of " << entry.Key, WARNING);
+    }
+}
+
+Dictionary CheckpointReader::_DecodeDict(int64_t i) const
+{
+    Dictionary dict;
+    for (auto child : _Children[i])
+        //None has no counterpart in Dictionary, the key is simply left out
+        if (_Entries[child].Type != CK_NONE)
+            dict[_Entries[child].Key] = _Decode(child);
+    return dict;
+}
+
+Dictionary CheckpointReader::ToDict() const
+{
+    ASSERT_ALLWAYS(IsOpen(), "Checkpoint has not been opened!");
+    return _DecodeDict(0);
+}
+
+bool IsCheckpoint(const string& FileName)
+{
+    FILE* file = fopen((FileName + CHECKPOINT_SUFFIX).c_str(), "rb");
+    if (file == nullptr)
+        return false;
+    char magic[sizeof(CHECKPOINT_MAGIC)];
+    bool result = fread(magic, 1, sizeof(magic), file) == sizeof(magic)
+                  && memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) == 0;
+    fclose(file);
+    return result;
+}
+
+/**********************   AsyncCheckpointWriter  **************************/
+
+AsyncCheckpointWriter::AsyncCheckpointWriter()
+{
+    CompactRatio = 1.0;
+    MaxRecord = 64;
+    _Pending = -1;
+    _Writing = -1;
+    _Quit = false;
+    _IsDelta[0] = _IsDelta[1] = false;
+    _Tag[0] = _Tag[1] = 0;
+    _NRecord = 0;
+    _BaseBytes = _LogBytes = 0;
+    _Broken = false;
+}
+
+AsyncCheckpointWriter::~AsyncCheckpointWriter()
+{
+    if (!_Thread.joinable())
+        return;
+    {
+        unique_lock<mutex> lock(_Mutex);
+        _Idle.wait(lock, [this] { return _Pending < 0 && _Writing < 0; });
+        _Quit = true;
+    }
+    _Wake.notify_all();
+    _Thread.join();
+    if (_Error) {
+        try {
+            rethrow_exception(_Error);
+        }
+        catch (std::exception& e) {
+            LOG_WARNING("The last checkpoint is not written: " << e.what());
+        }
+    }
+}
+
+void AsyncCheckpointWriter::_RethrowError()
+{
+    if (_Error) {
+        exception_ptr Error = _Error;
+        _Error = nullptr;
+        rethrow_exception(Error);
+    }
+}
+
+void AsyncCheckpointWriter::Submit(const Dictionary& dict, const string& FileName)
+{
+    int Spare;
+    {
+        lock_guard<mutex> lock(_Mutex);
+        _RethrowError();
+        if (!_Thread.joinable())
+            _Thread = thread(&AsyncCheckpointWriter::_Loop, this);
+        Spare = (_Writing == 0 ? 1 : 0);
+        if (_Pending == Spare)
+            _Pending = -1;
+        //a checkpoint without a Tag ends the delta log of the file
+        _Base.clear();
+    }
+    //the writer thread never touches the spare buffer, so the copy is done without the lock
+    _Buffer[Spare].Encode(dict, true);
+    {
+        lock_guard<mutex> lock(_Mutex);
+        _FileName[Spare] = FileName;
+        _IsDelta[Spare] = false;
+        _Tag[Spare] = 0;
+        _Pending = Spare;
+    }
+    _Wake.notify_all();
+}
+
+void AsyncCheckpointWriter::Submit(const Dictionary& dict, const string& FileName, const DirtyMap& Dirty, bool DoesCompact)
+{
+    int Spare;
+    DirtyMap Flags = Dirty;
+    bool IsBase = DoesCompact || FileName != _Base || _NRecord >= MaxRecord;
+    {
+        lock_guard<mutex> lock(_Mutex);
+        _RethrowError();
+        if (!_Thread.joinable())
+            _Thread = thread(&AsyncCheckpointWriter::_Loop, this);
+        Spare = (_Writing == 0 ? 1 : 0);
+        if (_Pending == Spare) {
+            _Pending = -1;
+            //the blocks of a replaced delta go into this one, a replaced base has to be written again
+            if (_IsDelta[Spare])
+                for (auto& array : _Dirty[Spare]) {
+                    vector<uint8_t>& flags = Flags[array.first];
+                    if (flags.size() != array.second.size())
+                        flags.clear();
+                    else
+                        for (uint64_t b = 0; b < flags.size(); b++)
+                            flags[b] |= array.second[b];
+                }
+            else
+                IsBase = true;
+        }
+        IsBase = IsBase || _Broken || _LogBytes > CompactRatio * _BaseBytes;
+    }
+    if (!IsBase) {
+        _Buffer[Spare].Encode(dict, true, &Flags, true);
+        //blocks can not be written over an array of another size
+        IsBase = _Buffer[Spare].TrackedSize() != _BaseSize;
+    }
+    if (IsBase) {
+        _Buffer[Spare].Encode(dict, true, &Flags, false);
+        _Base = FileName;
+        _BaseSize = _Buffer[Spare].TrackedSize();
+        _NRecord = 0;
+    }
+    else
+        _NRecord++;
+    {
+        lock_guard<mutex> lock(_Mutex);
+        _FileName[Spare] = FileName;
+        _IsDelta[Spare] = !IsBase;
+        _Tag[Spare] = IsBase ? NewBaseID() : 0;
+        _Dirty[Spare] = IsBase ? DirtyMap() : Flags;
+        if (IsBase)
+            _LogBytes = 0;
+        _Pending = Spare;
+    }
+    _Wake.notify_all();
+}
+
+bool AsyncCheckpointWriter::IsBusy()
+{
+    lock_guard<mutex> lock(_Mutex);
+    return _Pending >= 0 || _Writing >= 0;
+}
+
+void AsyncCheckpointWriter::Wait()
+{
+    unique_lock<mutex> lock(_Mutex);
+    _Idle.wait(lock, [this] { return _Pending < 0 && _Writing < 0; });
+    _RethrowError();
+}
+
+void AsyncCheckpointWriter::_Loop()
+{
+    while (true) {
+        int Current;
+        string FileName;
+        bool IsDelta, IsBroken;
+        uint64_t Tag, Bytes = 0;
+        {
+            unique_lock<mutex> lock(_Mutex);
+            _Wake.wait(lock, [this] { return _Quit || _Pending >= 0; });
+            if (_Pending < 0)
+                return;
+            Current = _Writing = _Pending;
+            _Pending = -1;
+            FileName = _FileName[Current];
+            IsDelta = _IsDelta[Current];
+            Tag = _Tag[Current];
+            IsBroken = _Broken;
+        }
+        exception_ptr Error;
+        try {
+            //a delta after a failed write would miss the blocks of the lost one, it waits for the next base
+            if (IsDelta && !IsBroken)
+                Bytes = _Buffer[Current].AppendDelta(FileName);
+            else if (!IsDelta) {
+                Bytes = _Buffer[Current].Write(FileName, Tag);
+                //a crash before the new log leaves the old one, which does not match Tag and is ignored
+                if (Tag != 0)
+                    ResetDelta(FileName, Tag);
+            }
+            _Buffer[Current].Clear();
+        }
+        catch (...) {
+            Error = current_exception();
+        }
+        lock_guard<mutex> lock(_Mutex);
+        if (Error) {
+            _Error = Error;
+            _Broken = true;
+        }
+        else if (IsDelta)
+            _LogBytes += Bytes;
+        else {
+            _BaseBytes = Bytes;
+            _LogBytes = 0;
+            _Broken = false;
+        }
+        _Writing = -1;
+        _Idle.notify_all();
+    }
+}
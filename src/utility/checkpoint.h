@@ -0,0 +1,232 @@
+//
+//  checkpoint.h
+//  Feynman_Simulator
+//
+//  Created by Kun Chen on 3/3/15.
+//  Copyright (c) 2015 Kun Chen. All rights reserved.
+//
+
+#ifndef __Feynman_Simulator__checkpoint__
+#define __Feynman_Simulator__checkpoint__
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <stdint.h>
+
+class Dictionary;
+namespace Python {
+class AnyObject;
+class ArrayObject;
+}
+
+/*
+ *  A checkpoint file is a Dictionary tree in a chunked binary layout, all integers are little endian.
+ *  [Header] 64 bytes: Magic "FSCKPT\0\0", uint32 Version, uint32 zero, uint64 NEntry, uint64 IndexOffset, uint64 IndexSize,
+ *           uint64 Tag, which is the BaseID of the delta log of the checkpoint or zero
+ *  [Data]   payloads of all entries; arrays start at multiples of 64 bytes so that they can be used in place from a mmap
+ *  [Index]  one record per entry in pre-order:
+ *           uint8 Type, uint8 DType length, uint16 NDim, uint32 Key length, int64 Parent,
+ *           uint64 Offset, uint64 Size, uint64 Shape[NDim], DType, Key
+ *  The same layout is read and written by checkpoint.py.
+ *
+ *  A delta log FileName+DELTA_SUFFIX keeps the changes of some arrays since the checkpoint with its Tag:
+ *  [Header] 64 bytes: Magic "FSDELTA\0", uint32 Version, uint32 BlockSize, uint64 BaseID
+ *  [Record] uint64 Magic, uint64 PayloadSize, uint32 crc32 of the payload, uint32 zero, then the payload:
+ *           uint64 ImageSize, a checkpoint image in which the tracked arrays have no payload,
+ *           uint32 NArray, and for every tracked array
+ *           uint32 Path length, Path, uint64 Size, uint64 NBlock, uint64 Block[NBlock],
+ *           uint64 zlib size, zlib stream of the bytes of the blocks, shuffled into 8 planes of byte k of every word
+ *  The blocks of a record are the latest values of the blocks changed since the record before, they are
+ *  written over the arrays of the base in order; the image of the last record gives all other entries.
+ *  A torn record, or one which does not match its crc32, ends the log. checkpoint.py replays it the same way.
+ */
+const std::string CHECKPOINT_SUFFIX = ".ckpt";
+const uint32_t CHECKPOINT_VERSION = 1;
+const int CHECKPOINT_ALIGN = 64;
+const std::string DELTA_SUFFIX = ".dlog";
+const uint32_t DELTA_VERSION = 1;
+//bytes of a block of the delta log
+const uint64_t DELTA_BLOCK = 1024;
+
+//path of an array, like "Sigma/Histogram/SmoothT/WeightAccu" -> one flag per DELTA_BLOCK bytes, true if changed
+typedef std::map<std::string, std::vector<uint8_t> > DirtyMap;
+
+enum CheckpointType {
+    CK_NONE = 0,
+    CK_DICT,
+    CK_LIST,
+    CK_BOOL,
+    CK_INT, //int64
+    CK_REAL, //float64
+    CK_COMPLEX, //two float64
+    CK_STRING,
+    CK_ARRAY
+};
+
+struct CheckpointEntry {
+    CheckpointType Type;
+    int64_t Parent; //index of the parent entry, -1 for the root
+    std::string Key; //empty for items of a list
+    std::string DType; //numpy typestr of an array, like "<c16"
+    std::vector<uint64_t> Shape;
+    uint64_t Offset; //offset of the payload from the beginning of the file
+    uint64_t Size; //number of bytes of the payload
+};
+
+class CheckpointWriter {
+public:
+    CheckpointWriter();
+    /**
+    *  Encode a Dictionary into entries. Payloads are copied if DoesCopy,
+    *  otherwise they are borrowed and dict has to stay alive until Write is done.
+    *  The sizes of the arrays at the paths of Tracked go into TrackedSize; with IsDelta these arrays
+    *  are left without a payload, and only their blocks flagged in Tracked are copied for AppendDelta
+    */
+    void Encode(const Dictionary& dict, bool DoesCopy = false, const DirtyMap* Tracked = nullptr, bool IsDelta = false);
+    //add an entry with a borrowed payload after the ones already there, in pre-order
+    void Add(CheckpointEntry, const char* payload);
+    /**
+    *  write into FileName+CHECKPOINT_SUFFIX through a temporary file and rename, so the file is always complete;
+    *  return the size of the file
+    */
+    uint64_t Write(const std::string& FileName, uint64_t Tag = 0);
+    //the same bytes as Write, in memory
+    std::string Image(uint64_t Tag = 0) const;
+    //append a record of the encoded delta to FileName+DELTA_SUFFIX, return the size of the record
+    uint64_t AppendDelta(const std::string& FileName) const;
+    const std::map<std::string, uint64_t>& TrackedSize() const { return _TrackedSize; }
+    void Clear();
+
+private:
+    struct DeltaArray {
+        std::string Path;
+        uint64_t Size;
+        std::vector<uint64_t> Block;
+        std::string Data; //bytes of the blocks one after another
+    };
+    std::vector<CheckpointEntry> _Entries;
+    std::vector<const char*> _Payload;
+    std::deque<std::string> _Copies; //deque, so that data() of earlier copies stays valid
+    std::vector<std::shared_ptr<Python::ArrayObject> > _Arrays;
+    bool _DoesCopy;
+    uint64_t _DataEnd;
+    const DirtyMap* _Tracked;
+    bool _IsDelta;
+    std::map<std::string, uint64_t> _TrackedSize;
+    std::vector<DeltaArray> _Delta;
+    void _Add(CheckpointEntry&, const char* payload, int align);
+    void _EncodeDict(const Dictionary&, int64_t Parent, const std::string& Key);
+    void _EncodeValue(const Python::AnyObject&, int64_t Parent, const std::string& Key);
+    bool _EncodeTracked(CheckpointEntry&, const char* payload);
+    uint64_t _Emit(uint64_t Tag, const std::function<bool(const char*, uint64_t)>& Output) const;
+};
+
+//write an empty delta log of the checkpoint with Tag BaseID through a temporary file and rename
+void ResetDelta(const std::string& FileName, uint64_t BaseID);
+
+/**
+*  \brief write checkpoints in a background thread. Submit only takes a snapshot of the Dictionary
+*  into one of two buffers, so the caller can go on while the other buffer is being written
+*/
+class AsyncCheckpointWriter {
+public:
+    AsyncCheckpointWriter();
+    ~AsyncCheckpointWriter();
+    //a snapshot which is still waiting to be written is replaced by the newer one
+    void Submit(const Dictionary&, const std::string& FileName);
+    /**
+    *  Submit in the delta mode, Dirty flags the blocks of the tracked arrays changed since the last Submit.
+    *  Only these blocks and the untracked entries are appended to the delta log; the log is compacted into
+    *  a new base checkpoint if DoesCompact, at the first Submit of FileName, after a failed write,
+    *  if the tracked arrays change their sizes, or once the log has MaxRecord records or is larger than
+    *  CompactRatio times the base
+    */
+    void Submit(const Dictionary&, const std::string& FileName, const DirtyMap& Dirty, bool DoesCompact = false);
+    bool IsBusy();
+    //block until all snapshots are written, an error of the writer thread is rethrown here or in the next Submit
+    void Wait();
+    double CompactRatio;
+    uint32_t MaxRecord;
+
+private:
+    CheckpointWriter _Buffer[2];
+    std::string _FileName[2];
+    bool _IsDelta[2];
+    uint64_t _Tag[2];
+    //flags of a waiting delta, which go into the next one if it is replaced
+    DirtyMap _Dirty[2];
+    int _Pending, _Writing; //index of the buffer waiting for/under writing, -1 for none
+    bool _Quit;
+    //the base of the deltas submitted, only used by Submit
+    std::string _Base;
+    std::map<std::string, uint64_t> _BaseSize;
+    uint32_t _NRecord;
+    //the files on the disk, updated by the writer thread; nothing is appended after a failed write until a new base
+    uint64_t _BaseBytes, _LogBytes;
+    bool _Broken;
+    std::exception_ptr _Error;
+    std::thread _Thread;
+    std::mutex _Mutex;
+    std::condition_variable _Wake, _Idle;
+    void _Loop();
+    void _RethrowError();
+};
+
+class CheckpointReader {
+public:
+    CheckpointReader()
+        : _MapSize(0)
+        , _Tag(0)
+        , _HasDelta(false)
+    {
+    }
+    //read-only mmap of FileName+CHECKPOINT_SUFFIX, throw IOInvalid if it is missing or broken
+    void Open(const std::string& FileName);
+    /**
+    *  replay the delta log FileName+DELTA_SUFFIX of the opened checkpoint, the entries are then the latest
+    *  state in memory instead of the mapping; false if there is no log of this checkpoint
+    */
+    bool ReplayDelta(const std::string& FileName);
+    void Close();
+    bool IsOpen() const;
+    bool HasDelta() const { return _HasDelta; }
+    uint64_t Tag() const { return _Tag; }
+    const std::vector<CheckpointEntry>& Entries() const { return _Entries; }
+    const char* Payload(const CheckpointEntry&) const;
+    //give back the pages of the mapping in [Begin, End) to the kernel after a single pass, they are
+    //read from the file again if touched later; nothing to do if the entries are in memory
+    void DropPages(const char* Begin, const char* End) const;
+    //the mapping is released when the reader and all copies of this pointer are gone
+    std::shared_ptr<const char> Mapping() const { return _Map; }
+    //find an entry by its path of keys, like "G/SmoothT", nullptr if there is no such entry
+    const CheckpointEntry* Find(const std::string& Path) const;
+    Dictionary ToDict() const;
+
+private:
+    std::shared_ptr<const char> _Map;
+    uint64_t _MapSize;
+    uint64_t _Tag;
+    bool _HasDelta;
+    std::vector<CheckpointEntry> _Entries;
+    std::vector<std::vector<int64_t> > _Children;
+    void _Parse(const std::string& Name);
+    static bool _CheckSize(const CheckpointEntry&);
+    std::string _Path(int64_t) const;
+    bool _ApplyRecord(const char* record, uint64_t size, std::map<std::string, std::string>& Arrays,
+                      std::string& Image) const;
+    Python::AnyObject _Decode(int64_t) const;
+    Dictionary _DecodeDict(int64_t) const;
+};
+
+bool IsCheckpoint(const std::string& FileName);
+
+int TestCheckpoint();
+#endif /* defined(__Feynman_Simulator__checkpoint__) */
@@ -0,0 +1,242 @@
+//
+//  checkpoint_test.cpp
+//  Feynman_Simulator
+//
+//  Created by Kun Chen on 3/3/15.
+//  Copyright (c) 2015 Kun Chen. All rights reserved.
+//
+
+#include "checkpoint.h"
+#include "utility/sput.h"
+#include "utility/complex.h"
+#include "utility/dictionary.h"
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <limits>
+
+using namespace std;
+using namespace Python;
+
+void Test_RoundTrip();
+void Test_Layout();
+void Test_Async();
+void Test_Delta();
+void Test_Corrupt();
+
+int TestCheckpoint()
+{
+    sput_start_testing();
+    sput_enter_suite("Test Checkpoint:");
+    sput_run_test(Test_RoundTrip);
+    sput_run_test(Test_Layout);
+    sput_run_test(Test_Async);
+    sput_run_test(Test_Delta);
+    sput_run_test(Test_Corrupt);
+    sput_finish_testing();
+    return sput_get_return_value();
+}
+
+Dictionary TestPort(vector<Complex>& vc)
+{
+    Dictionary Port;
+    Port["int"] = numeric_limits<long long>::min();
+    Port["real"] = 0.125;
+    Port["bool"] = true;
+    Port["complex"] = Complex(1.0, -2.0);
+    Port["string"] = string("G/W");
+    Port["list"] = vector<int>({ 1, 2, 3 });
+    Dictionary SubPort;
+    SubPort["b"] = 11;
+    Port["dict"] = SubPort;
+    Port["cArray"] = ArrayObject(vc.data(), { 2, 3 }, 2);
+    return Port;
+}
+
+void Test_RoundTrip()
+{
+    vector<Complex> vc;
+    for (int i = 0; i < 6; i++)
+        vc.push_back(Complex(i, -i));
+    Dictionary Port = TestPort(vc);
+    Port.BigSave("test_checkpoint");
+    sput_fail_unless(IsCheckpoint("test_checkpoint"), "BigSave writes a native checkpoint");
+
+    Dictionary Loaded;
+    Loaded.BigLoad("test_checkpoint");
+    sput_fail_unless(Loaded.Get<long long>("int") == numeric_limits<long long>::min()
+                         && Loaded.Get<real>("real") == 0.125 && Loaded.Get<bool>("bool"),
+                     "check scalars");
+    sput_fail_unless(Equal(Loaded.Get<Complex>("complex"), Complex(1.0, -2.0))
+                         && Loaded.Get<string>("string") == "G/W",
+                     "check complex and string");
+    auto list = Loaded.Get<vector<int> >("list");
+    sput_fail_unless(list.size() == 3 && list[2] == 3, "check list");
+    sput_fail_unless(Loaded.Get<Dictionary>("dict").Get<int>("b") == 11, "check dict");
+    ArrayObject array = Loaded.Get<ArrayObject>("cArray");
+    sput_fail_unless(array.Shape().size() == 2 && array.Shape()[1] == 3, "check shape of array");
+    sput_fail_unless(Equal(array.Data<Complex>()[5], vc[5]), "check data of array");
+}
+
+void Test_Layout()
+{
+    CheckpointReader reader;
+    reader.Open("test_checkpoint");
+    const CheckpointEntry* entry = reader.Find("cArray");
+    sput_fail_unless(entry != nullptr && entry->Offset % CHECKPOINT_ALIGN == 0, "arrays are aligned in the file");
+    sput_fail_unless(entry != nullptr && entry->DType == "<c16", "check dtype of array");
+    sput_fail_unless(reader.Find("dict/b") != nullptr && reader.Find("dict/c") == nullptr, "find entries by path");
+    reader.Close();
+    remove(("test_checkpoint" + CHECKPOINT_SUFFIX).c_str());
+    bool HasThrown = false;
+    try {
+        reader.Open("test_checkpoint");
+    }
+    catch (IOInvalid e) {
+        HasThrown = true;
+    }
+    sput_fail_unless(HasThrown, "missing checkpoint throws IOInvalid");
+}
+
+void Test_Async()
+{
+    vector<Complex> vc(6, Complex(1.0, 1.0));
+    Dictionary Port = TestPort(vc);
+    AsyncCheckpointWriter writer;
+    writer.Submit(Port, "test_checkpoint");
+    //the snapshot is taken in Submit, later changes go into the next checkpoint only
+    vc[0] = Complex(2.0, 2.0);
+    Port["real"] = 0.5;
+    Dictionary Loaded;
+    writer.Wait();
+    Loaded.BigLoad("test_checkpoint");
+    sput_fail_unless(Equal(Loaded.Get<ArrayObject>("cArray").Data<Complex>()[0], Complex(1.0, 1.0))
+                         && Loaded.Get<real>("real") == 0.125,
+                     "snapshot is not affected by later changes");
+    writer.Submit(Port, "test_checkpoint");
+    writer.Submit(Port, "test_checkpoint");
+    writer.Wait();
+    sput_fail_unless(!writer.IsBusy(), "writer is idle after Wait");
+    Loaded.Clear();
+    Loaded.BigLoad("test_checkpoint");
+    sput_fail_unless(Equal(Loaded.Get<ArrayObject>("cArray").Data<Complex>()[0], Complex(2.0, 2.0))
+                         && Loaded.Get<real>("real") == 0.5,
+                     "the newest snapshot is written");
+    remove(("test_checkpoint" + CHECKPOINT_SUFFIX).c_str());
+}
+
+void Test_Delta()
+{
+    vector<Complex> vc(6, Complex(1.0, 1.0)), hist(200, Complex(0.0, 0.0));
+    auto Snapshot = [&]() {
+        Dictionary Port = TestPort(vc);
+        Port["hist"] = Dictionary("acc", ArrayObject(hist.data(), { 200 }, 1));
+        return Port;
+    };
+    //200 complex are 4 blocks of the log
+    DirtyMap Dirty;
+    Dirty["hist/acc"] = vector<uint8_t>(4, 0);
+    string Log = "test_delta" + DELTA_SUFFIX;
+    AsyncCheckpointWriter writer;
+    writer.Submit(Snapshot(), "test_delta", Dirty);
+    writer.Wait();
+
+    hist[70] = Complex(1.0, 2.0);
+    Dirty["hist/acc"][1] = 1;
+    //a change which is not flagged is not written
+    hist[10] = Complex(5.0, 0.0);
+    vc[0] = Complex(3.0, 3.0);
+    writer.Submit(Snapshot(), "test_delta", Dirty);
+    writer.Wait();
+    CheckpointReader reader;
+    reader.Open("test_delta");
+    const Complex* acc = reinterpret_cast<const Complex*>(reader.Payload(*reader.Find("hist/acc")));
+    sput_fail_unless(reader.Tag() != 0 && acc[70].Re == 0.0, "a delta does not rewrite the base");
+    sput_fail_unless(reader.ReplayDelta("test_delta") && reader.HasDelta(), "the log of the base is replayed");
+    acc = reinterpret_cast<const Complex*>(reader.Payload(*reader.Find("hist/acc")));
+    sput_fail_unless(acc[70].Re == 1.0 && acc[70].Im == 2.0 && acc[10].Re == 0.0, "only the flagged blocks are replayed");
+    Dictionary Loaded;
+    Loaded.BigLoad("test_delta");
+    sput_fail_unless(Equal(Loaded.Get<ArrayObject>("cArray").Data<Complex>()[0], Complex(3.0, 3.0))
+                         && Equal(Loaded.Get<Dictionary>("hist").Get<ArrayObject>("acc").Data<Complex>()[70], Complex(1.0, 2.0)),
+                     "BigLoad replays the log");
+
+    Dirty["hist/acc"].assign(4, 0);
+    hist[199] = Complex(7.0, 7.0);
+    Dirty["hist/acc"][3] = 1;
+    writer.Submit(Snapshot(), "test_delta", Dirty);
+    writer.Wait();
+    struct stat info;
+    stat(Log.c_str(), &info);
+    sput_fail_unless(truncate(Log.c_str(), info.st_size - 5) == 0, "tear the last record");
+    reader.Open("test_delta");
+    reader.ReplayDelta("test_delta");
+    acc = reinterpret_cast<const Complex*>(reader.Payload(*reader.Find("hist/acc")));
+    sput_fail_unless(acc[199].Re == 0.0 && acc[70].Re == 1.0, "a torn record is dropped, the ones before are kept");
+
+    Dirty["hist/acc"].assign(4, 0);
+    writer.Submit(Snapshot(), "test_delta", Dirty, true);
+    writer.Wait();
+    reader.Open("test_delta");
+    acc = reinterpret_cast<const Complex*>(reader.Payload(*reader.Find("hist/acc")));
+    sput_fail_unless(acc[199].Re == 7.0 && acc[10].Re == 5.0, "compaction writes the whole state into the base");
+    sput_fail_unless(!reader.ReplayDelta("test_delta"), "the log is empty after compaction");
+
+    hist[0] = Complex(1.0, 0.0);
+    Dirty["hist/acc"][0] = 1;
+    writer.Submit(Snapshot(), "test_delta", Dirty);
+    writer.Wait();
+    Snapshot().BigSave("test_delta");
+    reader.Open("test_delta");
+    sput_fail_unless(reader.Tag() == 0 && !reader.ReplayDelta("test_delta"), "the log of another base is ignored");
+    reader.Close();
+    remove(("test_delta" + CHECKPOINT_SUFFIX).c_str());
+    remove(Log.c_str());
+}
+
+bool IsRejected(const string& FileName)
+{
+    CheckpointReader reader;
+    try {
+        reader.Open(FileName);
+    }
+    catch (IOInvalid e) {
+        return !reader.IsOpen();
+    }
+    return false;
+}
+
+void Test_Corrupt()
+{
+    vector<Complex> vc(6, Complex(1.0, 1.0));
+    CheckpointEntry root{ CK_DICT, -1, "", "", {}, 0, 0 };
+    auto Write = [&](CheckpointEntry entry) {
+        CheckpointWriter writer;
+        writer.Add(root, nullptr);
+        writer.Add(entry, (const char*)vc.data());
+        writer.Write("test_corrupt");
+    };
+    //payloads which do not fit their type would be read past the end of the mapping
+    Write(CheckpointEntry{ CK_ARRAY, 0, "a", "<c16", { 1000 }, 0, 16 });
+    sput_fail_unless(IsRejected("test_corrupt"), "array smaller than its shape is rejected");
+    Write(CheckpointEntry{ CK_ARRAY, 0, "a", "<x16", { 1 }, 0, 16 });
+    sput_fail_unless(IsRejected("test_corrupt"), "array of an unknown dtype is rejected");
+    Write(CheckpointEntry{ CK_INT, 0, "i", "", {}, 0, 4 });
+    sput_fail_unless(IsRejected("test_corrupt"), "truncated int is rejected");
+    Write(CheckpointEntry{ CK_COMPLEX, 0, "c", "", {}, 0, 8 });
+    sput_fail_unless(IsRejected("test_corrupt"), "truncated complex is rejected");
+    Write(CheckpointEntry{ CK_ARRAY, 0, "a", "<c16", { 2, 3 }, 0, 6 * sizeof(Complex) });
+    sput_fail_unless(!IsRejected("test_corrupt"), "array of the right size is accepted");
+
+    //a huge key length in the index is rejected before anything is allocated
+    string Name = "test_corrupt" + CHECKPOINT_SUFFIX;
+    FILE* file = fopen(Name.c_str(), "r+b");
+    uint64_t IndexOffset;
+    uint32_t KeySize = 0xFFFFFFF0u;
+    bool IsPatched = file != nullptr && fseek(file, 24, SEEK_SET) == 0 && fread(&IndexOffset, 8, 1, file) == 1
+                     && fseek(file, IndexOffset + 4, SEEK_SET) == 0 && fwrite(&KeySize, 4, 1, file) == 1;
+    if (file != nullptr)
+        fclose(file);
+    sput_fail_unless(IsPatched && IsRejected("test_corrupt"), "huge key length is rejected");
+    remove(Name.c_str());
+}
@@ -15,38 +15,113 @@
 #ifndef Complex_h
 #define Complex_h
 
-#include <iosfwd>
+#include <iostream>
 #include <iomanip>
+#include <type_traits>
 #include <math.h>
 #include "utility.h"
 
 // Complex number class
+// Header-only and trivially copyable, with the same layout as std::complex<double> and
+// numpy complex128: an array of Complex can be handed to numpy, memcpy'ed or treated as
+// an array of 2n reals, see the bulk kernels below.
 class Complex {
 public:
-    Complex(); // Default constructor
-    Complex(real re, real im = 0.0);
-    Complex(const Complex& c); // Copy constructor
+    Complex()
+        : Re(0.0)
+        , Im(0.0)
+    {
+    }
+    Complex(real re, real im = 0.0)
+        : Re(re)
+        , Im(im)
+    {
+    }
 
     real Re; // real part
     real Im; // imaginary part
 
-    Complex& operator=(const Complex&);
-    Complex& operator=(const real&);
+    Complex& operator=(const real& d)
+    {
+        Re = d;
+        Im = 0.0;
+        return (*this);
+    }
 
     // define the compound assignment operators first
-    Complex& operator+=(const Complex&);
-    Complex& operator+=(const real&);
-    Complex& operator-=(const Complex&);
-    Complex& operator-=(const real&);
-    Complex& operator*=(const Complex&);
-    Complex& operator*=(const real&);
-    Complex& operator/=(const Complex&);
-    Complex& operator/=(const real&);
-
-    friend std::ostream& operator<<(std::ostream&, const Complex&);
-    friend std::istream& operator>>(std::istream&, Complex&);
+    Complex& operator+=(const Complex& c)
+    {
+        Re += c.Re;
+        Im += c.Im;
+        return (*this);
+    }
+    Complex& operator+=(const real& d)
+    {
+        Re += d;
+        return (*this);
+    }
+    Complex& operator-=(const Complex& c)
+    {
+        Re -= c.Re;
+        Im -= c.Im;
+        return (*this);
+    }
+    Complex& operator-=(const real& d)
+    {
+        Re -= d;
+        return (*this);
+    }
+    Complex& operator*=(const Complex& c)
+    {
+        real re = Re; // backup Re, as we're going to modify it
+        real cre = c.Re; // backup c.Re too, in case c *= c;
+        Re = Re * c.Re - Im * c.Im;
+        Im = re * c.Im + Im * cre;
+        return (*this);
+    }
+    Complex& operator*=(const real& d)
+    {
+        Re *= d;
+        Im *= d;
+        return (*this);
+    }
+    Complex& operator/=(const Complex& c)
+    {
+        real re = Re, cre = c.Re; // backup both, in case c /= c;
+        real m = c.Re * c.Re + c.Im * c.Im;
+        Re = (Re * cre + Im * c.Im) / m;
+        Im = (Im * cre - re * c.Im) / m;
+        return (*this);
+    }
+    Complex& operator/=(const real& d)
+    {
+        Re /= d;
+        Im /= d;
+        return (*this);
+    }
 };
 
+static_assert(sizeof(Complex) == 2 * sizeof(real), "Complex should be laid out as two reals!");
+static_assert(std::is_trivially_copyable<Complex>::value, "Complex should be trivially copyable!");
+static_assert(std::is_standard_layout<Complex>::value, "Complex should have standard layout!");
+
+// Prints out a complex with the form (a,b)
+inline std::ostream& operator<<(std::ostream& s, const Complex& c)
+{
+    s << "(" << c.Re << "," << c.Im << ")";
+    return s;
+}
+
+// Reads a complex number c with the form (a,b), spaces can be used between the elements,
+// but not inside an element. If bad input is encountered, s.setstate(ios::failbit) is called.
+inline std::istream& operator>>(std::istream& s, Complex& c)
+{
+    char left, right, comma;
+    if (!((s >> left >> c.Re >> comma >> c.Im >> right) && (left == '(' && right == ')' && comma == ',')))
+        s.setstate(std::ios::failbit);
+    return s;
+}
+
 inline bool Equal(const Complex& c1, const Complex& c2, real eps = eps0)
 {
     return (fabs(c1.Re - c2.Re) < eps && fabs(c1.Im - c2.Im) < eps);
@@ -63,20 +138,79 @@ inline bool IsZero(const Complex& c)
 }
 
 // Nonmember operators (to allow implicit conversion of the left operand)
-Complex operator+(const Complex&, const Complex&);
-Complex operator+(const Complex&); // unary + operator
-Complex operator-(const Complex&, const Complex&);
-Complex operator-(const Complex&); // unary - operator
-Complex operator*(const Complex&, const Complex&);
-Complex operator/(const Complex&, const Complex&);
-
-Complex operator+(const Complex&, real);
-Complex operator+(real, const Complex&);
-Complex operator-(const Complex&, real);
-Complex operator-(real, const Complex&);
-Complex operator*(real, const Complex&);
-Complex operator*(const Complex&, real);
-Complex operator/(const Complex&, real);
+inline Complex operator+(const Complex& lhs, const Complex& rhs) { return Complex(lhs) += rhs; }
+inline Complex operator+(const Complex& c) { return c; } // unary + operator
+inline Complex operator-(const Complex& lhs, const Complex& rhs) { return Complex(lhs) -= rhs; }
+inline Complex operator-(const Complex& c) { return Complex(-c.Re, -c.Im); } // unary - operator
+inline Complex operator*(const Complex& lhs, const Complex& rhs) { return Complex(lhs) *= rhs; }
+inline Complex operator/(const Complex& lhs, const Complex& rhs) { return Complex(lhs) /= rhs; }
+
+// a real only touches the real part in + and -
+inline Complex operator+(const Complex& lhs, real rhs) { return Complex(lhs.Re + rhs, lhs.Im); }
+inline Complex operator+(real lhs, const Complex& rhs) { return Complex(lhs + rhs.Re, rhs.Im); }
+inline Complex operator-(const Complex& lhs, real rhs) { return Complex(lhs.Re - rhs, lhs.Im); }
+inline Complex operator-(real lhs, const Complex& rhs) { return Complex(lhs - rhs.Re, -rhs.Im); }
+inline Complex operator*(real lhs, const Complex& rhs) { return Complex(lhs * rhs.Re, lhs * rhs.Im); }
+inline Complex operator*(const Complex& lhs, real rhs) { return Complex(lhs.Re * rhs, lhs.Im * rhs); }
+inline Complex operator/(const Complex& lhs, real rhs) { return Complex(lhs.Re / rhs, lhs.Im / rhs); }
+inline Complex operator/(real lhs, const Complex& rhs)
+{
+    real factor = lhs / (rhs.Re * rhs.Re + rhs.Im * rhs.Im);
+    return Complex(rhs.Re * factor, -rhs.Im * factor);
+}
+
+// Bulk kernels over arrays of Complex. They work on the 2n reals underneath, so the loops
+// have no complex arithmetic in them and the compiler vectorizes them; with -O3 they run at
+// memory bandwidth. x and y should not overlap.
+
+// x[i] *= a
+inline void Scale(Complex* x, real a, size_t n)
+{
+    real* __restrict__ r = &x[0].Re;
+    for (size_t i = 0; i < 2 * n; i++)
+        r[i] *= a;
+}
+
+// x[i] *= a, with a complex
+inline void Scale(Complex* x, const Complex& a, size_t n)
+{
+    const real are = a.Re, aim = a.Im;
+    for (size_t i = 0; i < n; i++) {
+        real re = x[i].Re, im = x[i].Im;
+        x[i].Re = re * are - im * aim;
+        x[i].Im = re * aim + im * are;
+    }
+}
+
+// x[i] += y[i]
+inline void Add(Complex* x, const Complex* y, size_t n)
+{
+    real* __restrict__ r = &x[0].Re;
+    const real* __restrict__ s = &y[0].Re;
+    for (size_t i = 0; i < 2 * n; i++)
+        r[i] += s[i];
+}
+
+// x[i] += a*y[i]
+inline void AddScaled(Complex* x, real a, const Complex* y, size_t n)
+{
+    real* __restrict__ r = &x[0].Re;
+    const real* __restrict__ s = &y[0].Re;
+    for (size_t i = 0; i < 2 * n; i++)
+        r[i] += a * s[i];
+}
+
+// x[i] += y[i], then y[i] = 0
+inline void Accumulate(Complex* x, Complex* y, size_t n)
+{
+    real* __restrict__ r = &x[0].Re;
+    real* __restrict__ s = &y[0].Re;
+    for (size_t i = 0; i < 2 * n; i++) {
+        r[i] += s[i];
+        s[i] = 0.0;
+    }
+}
+
 // Complex library
 
 // mod2 = Re*Re + Im*Im
@@ -146,7 +280,7 @@ inline Complex pow(const Complex& z, const Complex& w)
 
 inline Complex pow(const Complex& z, real u)
 {
-    if (IsZero(0.0))
+    if (IsZero(z))
         return u == 0.0 ? 1.0 : 0.0;
     real logr = 0.5 * log(mod2(z));
     real theta = u * arg(z);
@@ -18,6 +18,9 @@ typedef unsigned int uint;
 const bool DEBUGMODE = false;
 //#define NDEBUG
 //define NDEBUG will turn off debug checking, including the boundary check in array.h
+//#define MARKOV_PROBE
+//define MARKOV_PROBE to count ticks, early rejects and weight lookups of every Markov update,
+//they are printed with the detailed balance info, see module/markov/markov_probe.h
 
 const real PI = 3.1415926535897932384626433832795;
 
@@ -36,7 +39,8 @@ const int IN = 0;
 const int OUT = 1;
 #define INVERSE(x) (1 - x)
 
-const int MAX_ORDER = 10;
+//the highest Order a job can ask for; diagrams and Markov tables are sized by the Order of the job
+const int MAX_ORDER = 32;
 
 //define your lattice here
 
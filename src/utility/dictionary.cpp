@@ -13,6 +13,8 @@
 #include "utility/abort.h"
 #include "utility/scopeguard.h"
 #include "dictionary.h"
+#include "checkpoint.h"
+#include "literal.h"
 
 using namespace std;
 using namespace Python;
@@ -39,46 +41,72 @@ void Dictionary::Update(const Dictionary& dict)
 }
 void Dictionary::LoadFromString(const std::string& script)
 {
-    AnyObject obj;
-    obj.EvalScript(script);
-    if (!FromPy(obj))
+    if (!FromPy(ParseLiteral(script)))
         ABORT("Script is invalided!");
 }
 
-void Dictionary::Load(const std::string& FileName)
+/**
+*  parameter files are read and written by the native literal reader/writer (see literal.h),
+*  FileName gets the suffix .txt if it does not have one, the same as IO.LoadDict/IO.SaveDict
+*/
+static string TextFileName(const string& FileName)
 {
-    ModuleObject LoadDict;
+    if (FileName.size() >= 4 && FileName.compare(FileName.size() - 4, 4, ".txt") == 0)
+        return FileName;
+    return FileName + ".txt";
+}
 
-    LoadDict.LoadModule("IO.py");
-    Object result = LoadDict.CallFunction("LoadDict", FileName);
-    PropagatePyError();
-    if (!FromPy(result))
-        ABORT("Fail to read file!");
+void Dictionary::Load(const std::string& FileName)
+{
+    string name = TextFileName(FileName);
+    ifstream file(name, ios::in | ios::binary);
+    if (!file.is_open())
+        THROW(IOInvalid, "Fail to open " << name, WARNING);
+    string text((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    if (!FromPy(ParseLiteral(text)))
+        ABORT("Fail to read file " << name);
 }
 
 void Dictionary::Save(const string& FileName, const std::string& Mode)
 {
-    ModuleObject SaveDict;
-    SaveDict.LoadModule("IO.py");
-    SaveDict.CallFunction("SaveDict", FileName, Mode, _Map);
-    PropagatePyError();
+    string name = TextFileName(FileName);
+    ofstream file(name, Mode == "a" ? ios::app : ios::trunc);
+    if (!file.is_open())
+        THROW_ERROR(IOInvalid, "Fail to open " << name);
+    file << FormatLiteral(ToPy());
+    if (!file.good())
+        THROW_ERROR(IOInvalid, "Fail to write " << name);
 }
 
+/**
+*  FileName is without suffix, a native checkpoint FileName.ckpt is preferred,
+*  older FileName.hkl files are still read through IO.py
+*/
 void Dictionary::BigLoad(const std::string& FileName)
 {
+    if (IsCheckpoint(FileName)) {
+        CheckpointReader reader;
+        reader.Open(FileName);
+        reader.ReplayDelta(FileName);
+        Update(reader.ToDict());
+        return;
+    }
+#ifdef NO_PYTHON
+    THROW(IOInvalid, "Fail to open checkpoint " << FileName << ", hickle files can only be read with python", WARNING);
+#else
     ModuleObject LoadBigDict;
     LoadBigDict.LoadModule("IO.py");
     Object result = LoadBigDict.CallFunction("LoadBigDict", FileName);
     PropagatePyError();
     if (!FromPy(result))
         ABORT("Fail to read file " << FileName);
+#endif
 }
 void Dictionary::BigSave(const std::string& FileName)
 {
-    ModuleObject SaveBigDict;
-    SaveBigDict.LoadModule("IO.py");
-    SaveBigDict.CallFunction("SaveBigDict", FileName, _Map);
-    PropagatePyError();
+    CheckpointWriter writer;
+    writer.Encode(*this);
+    writer.Write(FileName);
 }
 
 void Dictionary::Clear()
@@ -12,6 +12,8 @@
 #include "utility/complex.h"
 #include "utility/pyglue/pyarraywrapper.h"
 #include "dictionary.h"
+#include "literal.h"
+#include <stdio.h>
 
 using namespace std;
 using namespace Python;
@@ -19,17 +21,23 @@ using namespace Python;
 void Test_Ref();
 void Test_Cast();
 void Test_Dict();
+void Test_Literal();
 int TestDictionary()
 {
     sput_start_testing();
     sput_enter_suite("Test Python wrapper layer");
+#ifndef NO_PYTHON
+    //reference counting of PyObject
     sput_run_test(Test_Ref);
+#endif
     sput_run_test(Test_Cast);
     sput_run_test(Test_Dict);
+    sput_run_test(Test_Literal);
     sput_finish_testing();
     return sput_get_return_value();
 }
 
+#ifndef NO_PYTHON
 void Test_Ref()
 {
     PyObject* iptr = PyInt_FromLong(1);
@@ -56,6 +64,7 @@ void Test_Ref()
     PyObject* jjptr = j.Get(NoRef);
     sput_fail_unless(jjptr->ob_refcnt == j_ref, "get PyObject* witout reference");
 }
+#endif
 
 void Test_Cast()
 {
@@ -135,4 +144,42 @@ void Test_Dict()
     //                     "check dict IO");
     //    system("rm test.txt");
     //    system("rm test.pkl");
-}
\ No newline at end of file
+}
+
+void Test_Literal()
+{
+    Dictionary Para;
+    Para.LoadFromString("{'Model': {'ChemicalPotential': [3.141592653589793j, (1-2.5e-3j)], 'Name': u'J1J2'},\n"
+                        " 'L': (8, 8), 'Beta': 0.5, 'DoesLoad': False, 'Seed': -513857268L, 'Inf': -inf, #comment\n"
+                        " 'Array': array([[1.+2.j, 0.-1.j], [3., 4.j]]), 'Empty': array([], dtype=float64),\n"
+                        " 'Text': 'it\\'s\\n', 'Job': None, 'Steps': [1, None]}");
+    Dictionary Model = Para.Get<Dictionary>("Model");
+    vector<Complex> mu = Model.Get<vector<Complex> >("ChemicalPotential");
+    sput_fail_unless(Equal(mu[0], 0.0, 3.141592653589793) && Equal(mu[1], 1.0, -2.5e-3), "Read complex numbers");
+    sput_fail_unless(Model.Get<string>("Name") == "J1J2" && Para.Get<string>("Text") == "it's\n", "Read strings");
+    sput_fail_unless(Para.Get<vector<int> >("L") == vector<int>({ 8, 8 }) && Para.Get<long long>("Seed") == -513857268,
+                     "Read tuple and integers");
+    sput_fail_unless(Para.Get<real>("Beta") == 0.5 && !Para.Get<bool>("DoesLoad") && Para.Get<real>("Inf") < -1e300,
+                     "Read real and bool");
+    ArrayObject array = Para.Get<ArrayObject>("Array");
+    sput_fail_unless(array.Shape() == vector<uint>({ 2, 2 }) && Equal(array.Data<Complex>()[3], 0.0, 4.0),
+                     "Read complex array");
+    sput_fail_unless(Para.Get<ArrayObject>("Empty").Size() == 0, "Read empty array");
+    sput_fail_unless(IsNone(Para.Get<AnyObject>("Job")) && IsNone(Para.Get<vector<AnyObject> >("Steps")[1]), "Read None");
+    sput_fail_unless(FormatLiteral(ParseLiteral("{'a': [None, 1], 'b': None}")) == "{'a': [None, 1],\n 'b': None}", "Write None");
+
+    Para.Save("test_literal", "w");
+    Dictionary Loaded;
+    Loaded.Load("test_literal");
+    sput_fail_unless(FormatLiteral(Loaded.ToPy()) == FormatLiteral(Para.ToPy()), "Dictionary survives Save and Load");
+    remove("test_literal.txt");
+
+    bool IsThrown = false;
+    try {
+        Loaded.LoadFromString("{'a': [1, 2}");
+    }
+    catch (ValueInvalid e) {
+        IsThrown = true;
+    }
+    sput_fail_unless(IsThrown, "Broken literal is reported");
+}
@@ -0,0 +1,168 @@
+//
+//  fft.cpp
+//  Feynman_Simulator
+//
+//  Created by Kun Chen on 10/23/14.
+//  Copyright (c) 2014 Kun Chen. All rights reserved.
+//
+
+#include "fft.h"
+#include "parallel.h"
+#include "abort.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+
+using namespace std;
+using namespace fft;
+
+const uint Plan::WIDTH;
+
+static bool IsPowerOf2(uint n)
+{
+    return n > 0 && (n & (n - 1)) == 0;
+}
+
+static Complex Phase(const Twist& t, uint j, uint n)
+{
+    return polar(1.0, PI * t.Phase * (j + t.Offset) / n);
+}
+
+Plan::Plan(uint Outer_, uint N_, uint Inner_, Dir Direction_, Twist Pre, Twist Post, real Scale)
+    : Outer(Outer_)
+    , N(N_)
+    , Inner(Inner_)
+    , Direction(Direction_)
+{
+    ASSERT_ALLWAYS(N > 0 && Outer > 0 && Inner > 0, "Shape of FFT should not be empty!");
+    _IsRadix2 = IsPowerOf2(N);
+    _Store.resize(N);
+    for (uint k = 0; k < N; k++)
+        _Store[k] = Phase(Post, k, N) * Scale;
+    if (!_IsRadix2) {
+        //the twiddles are exact at the multiples of 2*PI/N, with (j*k)%N
+        _Matrix.resize(N * N);
+        for (uint k = 0; k < N; k++)
+            for (uint j = 0; j < N; j++)
+                _Matrix[k * N + j] = _Store[k] * polar(1.0, Direction * 2.0 * PI * ((unsigned long long)j * k % N) / N) * Phase(Pre, j, N);
+        return;
+    }
+    _Order.resize(N);
+    _Load.resize(N);
+    for (uint i = 0, j = 0; i < N; i++) {
+        _Order[i] = j;
+        _Load[i] = Phase(Pre, j, N);
+        uint bit = N >> 1;
+        for (; bit > 0 && (j & bit); bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+    }
+    _Twiddle.resize(N);
+    for (uint half = 1; half < N; half <<= 1)
+        for (uint k = 0; k < half; k++)
+            _Twiddle[half + k] = polar(1.0, Direction * PI * k / half);
+}
+
+/**
+*  transform Width lines starting at start, line and work are buffers of N*WIDTH
+*/
+void Plan::_Lines(Complex* start, uint Width, Complex* line, Complex* work) const
+{
+    if (!_IsRadix2) {
+        for (uint j = 0; j < N; j++)
+            for (uint w = 0; w < Width; w++)
+                line[j * WIDTH + w] = start[j * Inner + w];
+        for (uint k = 0; k < N; k++) {
+            Complex* y = work + k * WIDTH;
+            for (uint w = 0; w < Width; w++)
+                y[w] = Complex(0.0, 0.0);
+            for (uint j = 0; j < N; j++) {
+                const Complex& m = _Matrix[k * N + j];
+                const Complex* x = line + j * WIDTH;
+                for (uint w = 0; w < Width; w++) {
+                    y[w].Re += m.Re * x[w].Re - m.Im * x[w].Im;
+                    y[w].Im += m.Re * x[w].Im + m.Im * x[w].Re;
+                }
+            }
+        }
+        for (uint k = 0; k < N; k++)
+            for (uint w = 0; w < Width; w++)
+                start[k * Inner + w] = work[k * WIDTH + w];
+        return;
+    }
+    for (uint j = 0; j < N; j++) {
+        const Complex* x = start + _Order[j] * Inner;
+        for (uint w = 0; w < Width; w++)
+            line[j * WIDTH + w] = x[w] * _Load[j];
+    }
+    for (uint half = 1; half < N; half <<= 1)
+        for (uint k = 0; k < half; k++) {
+            const Complex& t = _Twiddle[half + k];
+            for (uint i = k; i < N; i += 2 * half) {
+                Complex* u = line + i * WIDTH;
+                Complex* v = line + (i + half) * WIDTH;
+                for (uint w = 0; w < Width; w++) {
+                    real re = t.Re * v[w].Re - t.Im * v[w].Im;
+                    real im = t.Re * v[w].Im + t.Im * v[w].Re;
+                    v[w].Re = u[w].Re - re;
+                    v[w].Im = u[w].Im - im;
+                    u[w].Re += re;
+                    u[w].Im += im;
+                }
+            }
+        }
+    for (uint k = 0; k < N; k++) {
+        Complex* y = start + k * Inner;
+        for (uint w = 0; w < Width; w++)
+            y[w] = line[k * WIDTH + w] * _Store[k];
+    }
+}
+
+void Plan::Execute(Complex* data, int NThread) const
+{
+    uint NColumn = (Inner + WIDTH - 1) / WIDTH;
+    ParallelFor(Outer * NColumn, NThread, [=](uint begin, uint end) {
+        vector<Complex> line(N * WIDTH), work(_IsRadix2 ? 0 : N * WIDTH);
+        for (uint l = begin; l < end; l++) {
+            uint o = l / NColumn, w = (l % NColumn) * WIDTH;
+            _Lines(data + o * N * Inner + w, min(WIDTH, Inner - w), line.data(), work.data());
+        }
+    });
+}
+
+typedef tuple<uint, uint, uint, int, real, real, real, real, real> PlanKey;
+
+const Plan& fft::GetPlan(uint Outer, uint N, uint Inner, Dir Direction, Twist Pre, Twist Post, real Scale)
+{
+    static mutex Mutex;
+    static map<PlanKey, unique_ptr<Plan> > Plans;
+    PlanKey key(Outer, N, Inner, Direction, Pre.Phase, Pre.Offset, Post.Phase, Post.Offset, Scale);
+    lock_guard<mutex> lock(Mutex);
+    unique_ptr<Plan>& plan = Plans[key];
+    if (!plan)
+        plan.reset(new Plan(Outer, N, Inner, Direction, Pre, Post, Scale));
+    return *plan;
+}
+
+void fft::fftnD(Complex* data, const uint* Shape, int Dim, Dir Direction, const bool* Mask, int NThread)
+{
+    uint Outer = 1, Inner = 1, Norm = 1;
+    for (int d = 0; d < Dim; d++)
+        Inner *= Shape[d];
+    int Last = -1;
+    for (int d = 0; d < Dim; d++)
+        if (Mask == nullptr || Mask[d]) {
+            Norm *= Shape[d];
+            Last = d;
+        }
+    for (int d = 0; d < Dim; d++) {
+        Inner /= Shape[d];
+        if (Mask == nullptr || Mask[d]) {
+            //1/Norm is folded into the last transform
+            real Scale = (Direction == BACK && d == Last) ? 1.0 / Norm : 1.0;
+            GetPlan(Outer, Shape[d], Inner, Direction, Twist(), Twist(), Scale).Execute(data, NThread);
+        }
+        Outer *= Shape[d];
+    }
+}
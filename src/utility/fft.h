@@ -0,0 +1,77 @@
+//
+//  fft.h
+//  Feynman_Simulator
+//
+//  Created by Kun Chen on 10/23/14.
+//  Copyright (c) 2014 Kun Chen. All rights reserved.
+//
+
+#ifndef __Feynman_Simulator__fft__
+#define __Feynman_Simulator__fft__
+
+#include "complex.h"
+#include <vector>
+
+/*
+ *  Fourier transforms of one axis of an array in the layout [Outer, N, Inner], in place.
+ *  A Plan is built once for a shape, a direction and the phase factors around the transform:
+ *      x_k <- Scale * Post_k * sum_j exp(Dir*2*PI*i*j*k/N) * Pre_j * x_j,
+ *  with Pre_j = exp(i*PI*Pre.Phase*(j+Pre.Offset)/N) and the same for Post_k. The phase factors are
+ *  folded into the load and the store of a line (and into the matrix of a direct transform for
+ *  N which is not a power of 2), so the twists of an anti-periodic function cost no extra pass.
+ *  Up to WIDTH neighbouring lines are transformed together in a buffer of the thread, so the array
+ *  itself is never copied and the strided axes are read in contiguous pieces.
+ */
+namespace fft {
+enum Dir {
+    FORTH = -1, //the same as numpy.fft.fft
+    BACK = 1 //numpy.fft.ifft without 1/N
+};
+
+//exp(i*PI*Phase*(j+Offset)/N)
+struct Twist {
+    Twist(real Phase_ = 0.0, real Offset_ = 0.0)
+        : Phase(Phase_)
+        , Offset(Offset_){};
+    real Phase;
+    real Offset;
+};
+
+class Plan {
+public:
+    Plan(uint Outer, uint N, uint Inner, Dir, Twist Pre = Twist(), Twist Post = Twist(), real Scale = 1.0);
+    uint Outer, N, Inner;
+    Dir Direction;
+    void Execute(Complex* data, int NThread = 1) const;
+
+    //lines next to each other in Inner are transformed together
+    static const uint WIDTH = 16;
+
+private:
+    bool _IsRadix2;
+    //the line is loaded in the bit reversed order, _Load[j] is the factor of x[_Order[j]]
+    std::vector<uint> _Order;
+    std::vector<Complex> _Load, _Store;
+    //_Twiddle[half+k] = exp(Dir*2*PI*i*k/(2*half)) for the stage of 2*half points
+    std::vector<Complex> _Twiddle;
+    //N x N matrix of a direct transform
+    std::vector<Complex> _Matrix;
+    void _Lines(Complex* start, uint Width, Complex* line, Complex* work) const;
+};
+
+/**
+*  the plan of the shape, built at the first call and kept for the lifetime of the program;
+*  it is safe to call from many threads
+*/
+const Plan& GetPlan(uint Outer, uint N, uint Inner, Dir, Twist Pre = Twist(), Twist Post = Twist(), real Scale = 1.0);
+
+/**
+*  transform the dimensions of a row major array with Shape[0...Dim-1], the ones with Mask[d]=false
+*  are left alone; BACK is normalized by the product of the transformed sizes, like numpy.fft.ifftn
+*/
+void fftnD(Complex* data, const uint* Shape, int Dim, Dir, const bool* Mask = nullptr, int NThread = 1);
+}
+
+int TestFFT();
+
+#endif /* defined(__Feynman_Simulator__fft__) */
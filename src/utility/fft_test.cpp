@@ -0,0 +1,120 @@
+//
+//  fft_test.cpp
+//  Feynman_Simulator
+//
+//  Created by Kun Chen on 10/23/14.
+//  Copyright (c) 2014 Kun Chen. All rights reserved.
+//
+
+#include "fft.h"
+#include "rng.h"
+#include "sput.h"
+#include "utility.h"
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+using namespace fft;
+
+void Test_fft1D();
+void Test_fftPlan();
+void Test_fftnD();
+
+int TestFFT()
+{
+    sput_start_testing();
+    sput_enter_suite("Test fft...");
+    sput_run_test(Test_fft1D);
+    sput_run_test(Test_fftPlan);
+    sput_run_test(Test_fftnD);
+    sput_finish_testing();
+    return sput_get_return_value();
+}
+
+bool CheckArray(const vector<Complex>& source, const vector<Complex>& target, real eps)
+{
+    for (uint i = 0; i < source.size(); i++)
+        if (!Equal(source[i], target[i], eps))
+            return false;
+    return true;
+}
+
+//the axis of length n of the layout [Outer, n, Inner] with the phase factors of a Plan, as a direct sum
+vector<Complex> NaiveFFT(const vector<Complex>& in, uint Outer, uint n, uint Inner, Dir dir,
+                         Twist Pre, Twist Post, real Scale)
+{
+    vector<Complex> out(in.size(), Complex(0.0, 0.0));
+    for (uint o = 0; o < Outer; o++)
+        for (uint i = 0; i < Inner; i++)
+            for (uint k = 0; k < n; k++) {
+                Complex& y = out[(o * n + k) * Inner + i];
+                for (uint j = 0; j < n; j++)
+                    y += in[(o * n + j) * Inner + i] * polar(1.0, PI * Pre.Phase * (j + Pre.Offset) / n)
+                         * polar(1.0, dir * 2.0 * PI * j * k / n);
+                y *= polar(1.0, PI * Post.Phase * (k + Post.Offset) / n) * Scale;
+            }
+    return out;
+}
+
+void Test_fft1D()
+{
+    //numpy.fft.fft(range(8))
+    vector<Complex> in = { 0, 1, 2, 3, 4, 5, 6, 7 };
+    vector<Complex> out = { { 28.0, 0.0 }, { -4.0, 9.65685424949238 }, { -4.0, 4.0 },
+                            { -4.0, 1.6568542494923806 }, { -4.0, 0.0 }, { -4.0, -1.6568542494923806 },
+                            { -4.0, -4.0 }, { -4.0, -9.65685424949238 } };
+    GetPlan(1, 8, 1, FORTH).Execute(in.data());
+    sput_fail_unless(CheckArray(in, out, 1.0e-13), "Check fft 1d");
+    GetPlan(1, 8, 1, BACK, Twist(), Twist(), 1.0 / 8).Execute(in.data());
+    bool IsBack = true;
+    for (uint i = 0; i < 8; i++)
+        IsBack &= Equal(in[i], Complex(i, 0.0), 1.0e-13);
+    sput_fail_unless(IsBack, "Check fft 1d backforth");
+}
+
+void Test_fftPlan()
+{
+    RandomFactory rng;
+    rng.Reset(519180543);
+    bool IsSame = true, IsExact = true;
+    for (uint n : { 1, 2, 3, 6, 8, 16 })
+        for (uint Inner : { 1, 5, 20 }) {
+            uint Outer = 3;
+            vector<Complex> in(Outer * n * Inner);
+            for (auto& x : in)
+                x = Complex(rng.urn() - 0.5, rng.urn() - 0.5);
+            for (Dir dir : { FORTH, BACK }) {
+                //the phase factors of an anti-symmetric function in tau
+                Twist Pre(dir, 0.5), Post(-dir, 0.0);
+                vector<Complex> out = in, serial = in;
+                GetPlan(Outer, n, Inner, dir, Pre, Post, 0.5).Execute(out.data(), 4);
+                IsSame &= CheckArray(out, NaiveFFT(in, Outer, n, Inner, dir, Pre, Post, 0.5), 1.0e-12);
+                GetPlan(Outer, n, Inner, dir, Pre, Post, 0.5).Execute(serial.data(), 1);
+                for (uint i = 0; i < in.size(); i++)
+                    IsExact &= (out[i].Re == serial[i].Re && out[i].Im == serial[i].Im);
+            }
+        }
+    sput_fail_unless(IsSame, "Plans with phase factors are the same as the direct sum");
+    sput_fail_unless(IsExact, "Threads do not change the transform");
+    sput_fail_unless(&GetPlan(3, 16, 5, FORTH) == &GetPlan(3, 16, 5, FORTH), "A plan is built only once");
+    sput_fail_unless(&GetPlan(3, 16, 5, FORTH) != &GetPlan(3, 16, 5, BACK), "Plans of different directions");
+}
+
+void Test_fftnD()
+{
+    const uint Nx = 4, Ny = 3, Nz = 16;
+    uint shape[] = { Nx, Ny, Nz };
+    bool mask[] = { true, false, true };
+    vector<Complex> in(Nx * Ny * Nz);
+    for (uint i = 0; i < Nx; i++)
+        for (uint j = 0; j < Ny; j++)
+            for (uint k = 0; k < Nz; k++)
+                in[(i * Ny + j) * Nz + k] = Complex((i * i + j * j) * cos(k), sin(i + k));
+    vector<Complex> out = NaiveFFT(in, Nx * Ny, Nz, 1, FORTH, Twist(), Twist(), 1.0);
+    out = NaiveFFT(out, 1, Nx, Ny * Nz, FORTH, Twist(), Twist(), 1.0);
+    vector<Complex> data = in;
+    fftnD(data.data(), shape, 3, FORTH, mask, 2);
+    sput_fail_unless(CheckArray(data, out, 1.0e-12), "Check fft nd");
+    fftnD(data.data(), shape, 3, BACK, mask, 2);
+    sput_fail_unless(CheckArray(data, in, 1.0e-13), "Check fft nd backforth");
+}
@@ -0,0 +1,643 @@
+//
+//  literal.cpp
+//  Feynman_Simulator
+//
+//  Created by Kun Chen on 3/5/15.
+//  Copyright (c) 2015 Kun Chen. All rights reserved.
+//
+
+#include "utility/complex.h"
+#include "literal.h"
+#include "utility/pyglue/pywrapper.h"
+#include <algorithm>
+#include <vector>
+#include <map>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <stdint.h>
+
+using namespace std;
+using namespace Python;
+
+namespace {
+
+/**********************   reader  **************************/
+
+//a number is the sum of terms like 2, -1.5e-3, inf or 3.j
+struct Number {
+    enum Type {
+        INT = 0,
+        REAL,
+        COMPLEX
+    } Kind;
+    long long Int;
+    Complex Value;
+};
+
+Number Add(const Number& a, const Number& b)
+{
+    Number sum;
+    sum.Kind = max(a.Kind, b.Kind);
+    sum.Int = a.Int + b.Int;
+    sum.Value = a.Value + b.Value;
+    return sum;
+}
+
+AnyObject ToObject(const Number& n)
+{
+    if (n.Kind == Number::INT)
+        return AnyObject(n.Int);
+    else if (n.Kind == Number::REAL)
+        return AnyObject(n.Value.Re);
+    else
+        return AnyObject(n.Value);
+}
+
+class LiteralParser {
+public:
+    LiteralParser(const string& text)
+        : _Begin(text.c_str())
+        , _Pos(text.c_str())
+        , _End(text.c_str() + text.size())
+    {
+    }
+    AnyObject Parse()
+    {
+        AnyObject obj = _Value();
+        if (_Peek() != '\0')
+            _Error("unexpected text after the literal");
+        return obj;
+    }
+
+private:
+    const char* _Begin, *_Pos, *_End;
+
+    void _Error(const string& msg)
+    {
+        long line = 1 + count(_Begin, _Pos, '\n');
+        THROW_ERROR(ValueInvalid, "Invalid literal at line " << line << ": " << msg);
+    }
+    //the next character which is not a space or in a comment, '\0' at the end
+    char _Peek()
+    {
+        while (_Pos < _End) {
+            if (isspace((unsigned char)*_Pos))
+                _Pos++;
+            else if (*_Pos == '#')
+                while (_Pos < _End && *_Pos != '\n')
+                    _Pos++;
+            else
+                return *_Pos;
+        }
+        return '\0';
+    }
+    bool _Accept(char c)
+    {
+        if (_Peek() != c)
+            return false;
+        _Pos++;
+        return true;
+    }
+    void _Expect(char c)
+    {
+        if (!_Accept(c))
+            _Error(string("'") + c + "' is expected");
+    }
+    string _Identifier()
+    {
+        _Peek();
+        const char* start = _Pos;
+        while (_Pos < _End && (isalnum((unsigned char)*_Pos) || *_Pos == '_'))
+            _Pos++;
+        return string(start, _Pos);
+    }
+    bool _IsQuote(const char* p)
+    {
+        return p < _End && (*p == '\'' || *p == '"');
+    }
+
+    AnyObject _Value()
+    {
+        char c = _Peek();
+        if (c == '{')
+            return _Dict();
+        if (c == '[') {
+            _Pos++;
+            vector<AnyObject> list;
+            _Sequence(']', list);
+            return AnyObject(list);
+        }
+        if (c == '(') {
+            //a tuple is read as a list, (1+2j) is only a number in parentheses
+            _Pos++;
+            vector<AnyObject> list;
+            if (_Sequence(')', list))
+                return AnyObject(list);
+            return list[0];
+        }
+        if (_IsQuote(_Pos))
+            return AnyObject(_String(false));
+        if (isalpha((unsigned char)c) || c == '_') {
+            const char* start = _Pos;
+            string name = _Identifier();
+            if (name == "True")
+                return AnyObject(true);
+            if (name == "False")
+                return AnyObject(false);
+            if (name == "None")
+                return AnyObject(NoneObject());
+            if (name == "array")
+                return _Array();
+            if ((name == "u" || name == "b" || name == "r") && _IsQuote(_Pos))
+                return AnyObject(_String(name == "r"));
+            //inf, nan or infj
+            _Pos = start;
+        }
+        return ToObject(_Number());
+    }
+
+    //items until close, return false if it is only one item in parentheses without comma
+    bool _Sequence(char close, vector<AnyObject>& items)
+    {
+        bool HasComma = false;
+        while (!_Accept(close)) {
+            items.push_back(_Value());
+            if (_Accept(','))
+                HasComma = true;
+            else {
+                _Expect(close);
+                break;
+            }
+        }
+        return HasComma || items.size() != 1;
+    }
+
+    AnyObject _Dict()
+    {
+        _Expect('{');
+        map<string, AnyObject> dict;
+        while (!_Accept('}')) {
+            string key;
+            if (!Convert(_Value(), key))
+                _Error("key of a dict should be a string");
+            _Expect(':');
+            dict[key] = _Value();
+            if (!_Accept(',')) {
+                _Expect('}');
+                break;
+            }
+        }
+        return AnyObject(dict);
+    }
+
+    string _String(bool IsRaw)
+    {
+        char quote = *_Pos++;
+        string s;
+        while (true) {
+            if (_Pos >= _End || *_Pos == '\n')
+                _Error("string is not closed");
+            char c = *_Pos++;
+            if (c == quote)
+                return s;
+            if (c != '\\') {
+                s += c;
+                continue;
+            }
+            if (_Pos >= _End)
+                _Error("string is not closed");
+            char e = *_Pos++;
+            if (IsRaw) {
+                s += c;
+                s += e;
+                continue;
+            }
+            switch (e) {
+            case 'n':
+                s += '\n';
+                break;
+            case 't':
+                s += '\t';
+                break;
+            case 'r':
+                s += '\r';
+                break;
+            case '0':
+                s += '\0';
+                break;
+            case '\\':
+            case '\'':
+            case '"':
+                s += e;
+                break;
+            case '\n':
+                break;
+            case 'x':
+                if (_End - _Pos < 2 || !isxdigit((unsigned char)_Pos[0]) || !isxdigit((unsigned char)_Pos[1]))
+                    _Error("invalid \\x escape");
+                s += (char)strtol(string(_Pos, 2).c_str(), nullptr, 16);
+                _Pos += 2;
+                break;
+            default:
+                //python keeps unknown escapes as they are
+                s += c;
+                s += e;
+            }
+        }
+    }
+
+    Number _Number()
+    {
+        Number sum = _Term();
+        for (char c = _Peek(); c == '+' || c == '-'; c = _Peek())
+            sum = Add(sum, _Term());
+        return sum;
+    }
+
+    Number _Term()
+    {
+        bool IsNegative = false;
+        for (char c = _Peek(); c == '+' || c == '-'; c = _Peek()) {
+            IsNegative ^= (c == '-');
+            _Pos++;
+        }
+        Number n{ Number::INT, 0, Complex(0.0, 0.0) };
+        if (_Accept('(')) {
+            //(1+2j) in an array
+            n = _Number();
+            _Expect(')');
+            if (IsNegative) {
+                n.Int = -n.Int;
+                n.Value = -n.Value;
+            }
+            return n;
+        }
+        real value;
+        bool IsImag = false;
+        if (_Pos < _End && isalpha((unsigned char)*_Pos)) {
+            string name = _Identifier();
+            if (name.size() == 4 && (name[3] == 'j' || name[3] == 'J')) {
+                IsImag = true;
+                name.resize(3);
+            }
+            if (name == "inf")
+                value = INFINITY;
+            else if (name == "nan")
+                value = NAN;
+            else if (name == "True" || name == "False") {
+                //only in arrays, where a bool is a number
+                n.Int = (name == "True");
+                n.Value = Complex(n.Int, 0.0);
+                return n;
+            }
+            else {
+                _Error("unknown name " + name);
+                return n;
+            }
+        }
+        else {
+            const char* p = _Pos;
+            bool IsReal = false;
+            while (p < _End && isdigit((unsigned char)*p))
+                p++;
+            if (p < _End && *p == '.') {
+                IsReal = true;
+                p++;
+                while (p < _End && isdigit((unsigned char)*p))
+                    p++;
+            }
+            if (p == _Pos || (IsReal && p == _Pos + 1))
+                _Error("a number is expected");
+            if (p < _End && (*p == 'e' || *p == 'E')) {
+                const char* q = p + 1;
+                if (q < _End && (*q == '+' || *q == '-'))
+                    q++;
+                if (q < _End && isdigit((unsigned char)*q)) {
+                    IsReal = true;
+                    p = q;
+                    while (p < _End && isdigit((unsigned char)*p))
+                        p++;
+                }
+            }
+            string token = (IsNegative ? "-" : "") + string(_Pos, p);
+            _Pos = p;
+            if (_Pos < _End && (*_Pos == 'j' || *_Pos == 'J')) {
+                IsImag = true;
+                _Pos++;
+            }
+            else if (!IsReal) {
+                //python 2 writes long integers as 123L
+                if (_Pos < _End && (*_Pos == 'L' || *_Pos == 'l'))
+                    _Pos++;
+                errno = 0;
+                n.Int = strtoll(token.c_str(), nullptr, 10);
+                if (errno == ERANGE)
+                    _Error("integer " + token + " is out of range");
+                n.Value = Complex(n.Int, 0.0);
+                return n;
+            }
+            value = strtod(token.c_str(), nullptr);
+            IsNegative = false;
+        }
+        if (IsNegative)
+            value = -value;
+        n.Kind = IsImag ? Number::COMPLEX : Number::REAL;
+        n.Value = IsImag ? Complex(0.0, value) : Complex(value, 0.0);
+        return n;
+    }
+
+    //array([...]) or array([...], dtype=...), array is already read
+    AnyObject _Array()
+    {
+        _Expect('(');
+        vector<long long> Shape;
+        vector<Number> Items;
+        int ScalarDepth = -1;
+        _ArrayItems(0, Shape, Items, ScalarDepth);
+        string DType;
+        if (_Accept(',') && _Peek() != ')') {
+            if (_Identifier() != "dtype")
+                _Error("only dtype is allowed in array()");
+            _Expect('=');
+            DType = _DType();
+            _Accept(',');
+        }
+        _Expect(')');
+        if (ScalarDepth >= 0 && ScalarDepth != (int)Shape.size())
+            _Error("array is not rectangular");
+        if (DType.empty()) {
+            //the same as numpy
+            int Kind = Items.empty() ? Number::REAL : Number::INT;
+            for (auto& n : Items)
+                Kind = max(Kind, (int)n.Kind);
+            DType = (Kind == Number::COMPLEX ? "<c16" : (Kind == Number::REAL ? "<f8" : "<i8"));
+        }
+        return _MakeArray(DType, vector<uint>(Shape.begin(), Shape.end()), Items);
+    }
+
+    void _ArrayItems(uint depth, vector<long long>& Shape, vector<Number>& Items, int& ScalarDepth)
+    {
+        if (_Peek() != '[') {
+            if (ScalarDepth >= 0 && ScalarDepth != (int)depth)
+                _Error("array is not rectangular");
+            ScalarDepth = depth;
+            Items.push_back(_Number());
+            return;
+        }
+        _Pos++;
+        if (Shape.size() <= depth)
+            Shape.resize(depth + 1, -1);
+        long long n = 0;
+        while (!_Accept(']')) {
+            _ArrayItems(depth + 1, Shape, Items, ScalarDepth);
+            n++;
+            if (!_Accept(',')) {
+                _Expect(']');
+                break;
+            }
+        }
+        if (Shape[depth] >= 0 && Shape[depth] != n)
+            _Error("array is not rectangular");
+        Shape[depth] = n;
+    }
+
+    string _DType()
+    {
+        string name;
+        if (_IsQuote(_Pos))
+            name = _String(false);
+        else {
+            //numpy.complex128 or complex128
+            name = _Identifier();
+            while (_Accept('.'))
+                name = _Identifier();
+        }
+        static const map<string, string> DTypes = {
+            { "complex", "<c16" }, { "complex128", "<c16" }, { "complex_", "<c16" }, { "<c16", "<c16" },
+            { "float", "<f8" }, { "float64", "<f8" }, { "float_", "<f8" }, { "<f8", "<f8" },
+            { "int", "<i8" }, { "int64", "<i8" }, { "int_", "<i8" }, { "<i8", "<i8" },
+            { "int32", "<i4" }, { "<i4", "<i4" },
+            { "bool", "|b1" }, { "bool_", "|b1" }, { "|b1", "|b1" }
+        };
+        auto it = DTypes.find(name);
+        if (it == DTypes.end())
+            _Error("dtype " + name + " is not supported");
+        return it->second;
+    }
+
+    template <typename T>
+    static void _Append(vector<char>& data, T value)
+    {
+        const char* p = reinterpret_cast<const char*>(&value);
+        data.insert(data.end(), p, p + sizeof(T));
+    }
+
+    AnyObject _MakeArray(const string& DType, const vector<uint>& Shape, const vector<Number>& Items)
+    {
+        vector<char> data;
+        for (auto& n : Items) {
+            if (DType == "<c16") {
+                _Append(data, (double)n.Value.Re);
+                _Append(data, (double)n.Value.Im);
+                continue;
+            }
+            if (n.Kind == Number::COMPLEX)
+                _Error("complex number in an array of " + DType);
+            if (DType == "<f8")
+                _Append(data, (double)n.Value.Re);
+            else if (n.Kind == Number::REAL)
+                _Error("real number in an array of " + DType);
+            else if (DType == "<i8")
+                _Append(data, (int64_t)n.Int);
+            else if (DType == "<i4")
+                _Append(data, (int32_t)n.Int);
+            else
+                _Append(data, (uint8_t)(n.Int != 0));
+        }
+        return ArrayObject(DType, Shape, data.data());
+    }
+};
+
+/**********************   writer  **************************/
+
+//shortest text which reads back to the same double, always with a dot or an exponent like python's repr
+string FormatReal(double x)
+{
+    if (std::isnan(x))
+        return "nan";
+    if (std::isinf(x))
+        return x > 0 ? "inf" : "-inf";
+    char temp[32];
+    for (int precision = 15; precision <= 17; precision++) {
+        snprintf(temp, sizeof(temp), "%.*g", precision, x);
+        if (strtod(temp, nullptr) == x)
+            break;
+    }
+    string s = temp;
+    if (s.find_first_of(".e") == string::npos)
+        s += ".0";
+    return s;
+}
+
+string FormatComplex(const Complex& c)
+{
+    bool IsNegative = std::signbit(c.Im) && !std::isnan(c.Im);
+    return "(" + FormatReal(c.Re) + (IsNegative ? "-" : "+") + FormatReal(fabs(c.Im)) + "j)";
+}
+
+string FormatString(const string& s)
+{
+    string out = "'";
+    for (char c : s) {
+        if (c == '\\' || c == '\'') {
+            out += '\\';
+            out += c;
+        }
+        else if (c == '\n')
+            out += "\\n";
+        else if (c == '\t')
+            out += "\\t";
+        else if (c == '\r')
+            out += "\\r";
+        else if (!isprint((unsigned char)c)) {
+            char temp[8];
+            snprintf(temp, sizeof(temp), "\\x%02x", (unsigned char)c);
+            out += temp;
+        }
+        else
+            out += c;
+    }
+    return out + "'";
+}
+
+//column of the end of out, where the next character will be
+size_t Column(const string& out)
+{
+    size_t line = out.rfind('\n');
+    return line == string::npos ? out.size() : out.size() - line - 1;
+}
+
+void FormatArrayItems(string& out, const string& DType, const char*& data,
+                      const vector<uint>& Shape, uint depth)
+{
+    if (depth == Shape.size()) {
+        if (DType == "<c16") {
+            double re, im;
+            memcpy(&re, data, sizeof(double));
+            memcpy(&im, data + sizeof(double), sizeof(double));
+            out += FormatComplex(Complex(re, im));
+            data += 2 * sizeof(double);
+        }
+        else if (DType == "<f8") {
+            double x;
+            memcpy(&x, data, sizeof(double));
+            out += FormatReal(x);
+            data += sizeof(double);
+        }
+        else if (DType == "<i8") {
+            int64_t i;
+            memcpy(&i, data, sizeof(int64_t));
+            out += ToString((long long)i);
+            data += sizeof(int64_t);
+        }
+        else if (DType == "<i4") {
+            int32_t i;
+            memcpy(&i, data, sizeof(int32_t));
+            out += ToString(i);
+            data += sizeof(int32_t);
+        }
+        else {
+            out += (*data != 0 ? "True" : "False");
+            data += 1;
+        }
+        return;
+    }
+    out += "[";
+    for (uint i = 0; i < Shape[depth]; i++) {
+        if (i > 0)
+            out += ", ";
+        FormatArrayItems(out, DType, data, Shape, depth + 1);
+    }
+    out += "]";
+}
+
+void Format(const AnyObject& obj, string& out)
+{
+    map<string, AnyObject> dict;
+    vector<AnyObject> list;
+    ArrayObject array;
+    bool b;
+    long long i;
+    double r;
+    Complex c;
+    string s;
+    //bool has to be checked before int, and int before real, since python converts them implicitly
+    if (IsNone(obj))
+        out += "None";
+    else if (Convert(obj, dict)) {
+        //the layout of pprint: one key per line, sorted, aligned after the brace
+        string indent = ",\n" + string(Column(out) + 1, ' ');
+        out += "{";
+        for (auto it = dict.begin(); it != dict.end(); it++) {
+            if (it != dict.begin())
+                out += indent;
+            out += FormatString(it->first) + ": ";
+            Format(it->second, out);
+        }
+        out += "}";
+    }
+    else if (Convert(obj, list)) {
+        //a list of dicts has one item per line
+        bool HasDict = false;
+        for (auto& item : list)
+            HasDict |= Convert(item, dict);
+        string separator = HasDict ? ",\n" + string(Column(out) + 1, ' ') : ", ";
+        out += "[";
+        for (uint k = 0; k < list.size(); k++) {
+            if (k > 0)
+                out += separator;
+            Format(list[k], out);
+        }
+        out += "]";
+    }
+    else if (Convert(obj, array)) {
+        static const map<string, string> Names = {
+            { "<c16", "complex128" }, { "<f8", "float64" }, { "<i8", "int64" }, { "<i4", "int32" }, { "|b1", "bool" }
+        };
+        string DType = array.DType();
+        if (Names.find(DType) == Names.end())
+            THROW_ERROR(TypeInvalid, "Array of " << DType << " can not be written as a literal!");
+        const char* data = array.Bytes();
+        out += "array(";
+        FormatArrayItems(out, DType, data, array.Shape(), 0);
+        out += ", dtype=" + Names.at(DType) + ")";
+    }
+    else if (Convert(obj, b))
+        out += b ? "True" : "False";
+    else if (Convert(obj, i))
+        out += ToString(i);
+    else if (Convert(obj, r))
+        out += FormatReal(r);
+    else if (Convert(obj, c))
+        out += FormatComplex(c);
+    else if (Convert(obj, s))
+        out += FormatString(s);
+    else
+        THROW_ERROR(TypeInvalid, AnyObject(obj).PrettyString() << " can not be written as a literal!");
+}
+}
+
+AnyObject ParseLiteral(const string& text)
+{
+    return LiteralParser(text).Parse();
+}
+
+string FormatLiteral(const AnyObject& obj)
+{
+    string out;
+    Format(obj, out);
+    return out;
+}
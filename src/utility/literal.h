@@ -0,0 +1,33 @@
+//
+//  literal.h
+//  Feynman_Simulator
+//
+//  Created by Kun Chen on 3/5/15.
+//  Copyright (c) 2015 Kun Chen. All rights reserved.
+//
+
+#ifndef __Feynman_Simulator__literal__
+#define __Feynman_Simulator__literal__
+
+#include <string>
+
+namespace Python {
+class AnyObject;
+}
+
+/*
+ *  Native reader and writer of the python literals in the parameter files (_in_MC_*, *_para, Message),
+ *  so that they are read and written without eval/pprint in the embedded interpreter.
+ *  Supported literals:
+ *      dict (with string keys), list, tuple (read as a list), str, bool, None (Python::NoneObject()),
+ *      int, float (with inf and nan), complex like 2j or (1.5-2j),
+ *      and numpy arrays like array([[1., 2.], [3., 4.]], dtype=complex128)
+ *  FormatLiteral writes the same subset in the layout of pprint.pformat, which IO.LoadDict can still eval.
+ */
+
+//throw ValueInvalid with the line number if text is not a literal of the subset above
+Python::AnyObject ParseLiteral(const std::string& text);
+//throw TypeInvalid if obj or one of its items is not in the subset above
+std::string FormatLiteral(const Python::AnyObject& obj);
+
+#endif /* defined(__Feynman_Simulator__literal__) */
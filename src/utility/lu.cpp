@@ -0,0 +1,266 @@
+//
+//  lu.cpp
+//  Feynman_Simulator
+//
+//  Created by Kun Chen on 3/5/15.
+//  Copyright (c) 2015 Kun Chen. All rights reserved.
+//
+
+#include "lu.h"
+#include "parallel.h"
+#include "abort.h"
+#include <math.h>
+
+using namespace std;
+
+const uint LANE = BatchedLU::LANE;
+
+/**
+*  factorize the LANE matrices of a tile in place, with the pivot of the largest |Re|+|Im| like izamax;
+*  NFixed>0 is the order N known at compile time
+*/
+template <uint NFixed>
+static void FactorTile(real* re, real* im, int* piv, Complex* det, uint n_)
+{
+    const uint n = NFixed > 0 ? NFixed : n_;
+    real sign[LANE];
+    for (uint l = 0; l < LANE; l++)
+        sign[l] = 1.0;
+    for (uint k = 0; k < n; k++) {
+        for (uint l = 0; l < LANE; l++) {
+            uint p = k;
+            real big = fabs(re[(k * n + k) * LANE + l]) + fabs(im[(k * n + k) * LANE + l]);
+            for (uint i = k + 1; i < n; i++) {
+                real v = fabs(re[(i * n + k) * LANE + l]) + fabs(im[(i * n + k) * LANE + l]);
+                if (v > big) {
+                    big = v;
+                    p = i;
+                }
+            }
+            piv[k * LANE + l] = p;
+            if (p != k) {
+                for (uint j = 0; j < n; j++) {
+                    swap(re[(k * n + j) * LANE + l], re[(p * n + j) * LANE + l]);
+                    swap(im[(k * n + j) * LANE + l], im[(p * n + j) * LANE + l]);
+                }
+                sign[l] = -sign[l];
+            }
+        }
+        //a zero pivot gives zero multipliers, so the column is left as it is
+        real invre[LANE], invim[LANE];
+        const real* dr = re + (k * n + k) * LANE;
+        const real* di = im + (k * n + k) * LANE;
+        for (uint l = 0; l < LANE; l++) {
+            real m2 = dr[l] * dr[l] + di[l] * di[l];
+            invre[l] = m2 > 0.0 ? dr[l] / m2 : 0.0;
+            invim[l] = m2 > 0.0 ? -di[l] / m2 : 0.0;
+        }
+        for (uint i = k + 1; i < n; i++) {
+            real* fr = re + (i * n + k) * LANE;
+            real* fi = im + (i * n + k) * LANE;
+            for (uint l = 0; l < LANE; l++) {
+                real r = fr[l] * invre[l] - fi[l] * invim[l];
+                fi[l] = fr[l] * invim[l] + fi[l] * invre[l];
+                fr[l] = r;
+            }
+            for (uint j = k + 1; j < n; j++) {
+                real* xr = re + (i * n + j) * LANE;
+                real* xi = im + (i * n + j) * LANE;
+                const real* ur = re + (k * n + j) * LANE;
+                const real* ui = im + (k * n + j) * LANE;
+                for (uint l = 0; l < LANE; l++) {
+                    xr[l] -= fr[l] * ur[l] - fi[l] * ui[l];
+                    xi[l] -= fr[l] * ui[l] + fi[l] * ur[l];
+                }
+            }
+        }
+    }
+    for (uint l = 0; l < LANE; l++) {
+        det[l] = Complex(sign[l], 0.0);
+        for (uint k = 0; k < n; k++)
+            det[l] *= Complex(re[(k * n + k) * LANE + l], im[(k * n + k) * LANE + l]);
+    }
+}
+
+/**
+*  solve the LANE systems of a tile in place, b is the right hand side of m columns in the tile layout
+*/
+template <uint NFixed>
+static void SolveTile(const real* re, const real* im, const int* piv, real* bre, real* bim, uint n_, uint m)
+{
+    const uint n = NFixed > 0 ? NFixed : n_;
+    //rows are swapped in the order of the factorization, like zlaswp
+    for (uint k = 0; k < n; k++)
+        for (uint l = 0; l < LANE; l++) {
+            uint p = piv[k * LANE + l];
+            if (p == k)
+                continue;
+            for (uint j = 0; j < m; j++) {
+                swap(bre[(k * m + j) * LANE + l], bre[(p * m + j) * LANE + l]);
+                swap(bim[(k * m + j) * LANE + l], bim[(p * m + j) * LANE + l]);
+            }
+        }
+    //L with unit diagonal
+    for (uint i = 1; i < n; i++)
+        for (uint k = 0; k < i; k++) {
+            const real* ar = re + (i * n + k) * LANE;
+            const real* ai = im + (i * n + k) * LANE;
+            for (uint j = 0; j < m; j++) {
+                real* xr = bre + (i * m + j) * LANE;
+                real* xi = bim + (i * m + j) * LANE;
+                const real* yr = bre + (k * m + j) * LANE;
+                const real* yi = bim + (k * m + j) * LANE;
+                for (uint l = 0; l < LANE; l++) {
+                    xr[l] -= ar[l] * yr[l] - ai[l] * yi[l];
+                    xi[l] -= ar[l] * yi[l] + ai[l] * yr[l];
+                }
+            }
+        }
+    //U
+    for (int i = n - 1; i >= 0; i--) {
+        for (uint k = i + 1; k < n; k++) {
+            const real* ar = re + (i * n + k) * LANE;
+            const real* ai = im + (i * n + k) * LANE;
+            for (uint j = 0; j < m; j++) {
+                real* xr = bre + (i * m + j) * LANE;
+                real* xi = bim + (i * m + j) * LANE;
+                const real* yr = bre + (k * m + j) * LANE;
+                const real* yi = bim + (k * m + j) * LANE;
+                for (uint l = 0; l < LANE; l++) {
+                    xr[l] -= ar[l] * yr[l] - ai[l] * yi[l];
+                    xi[l] -= ar[l] * yi[l] + ai[l] * yr[l];
+                }
+            }
+        }
+        const real* dr = re + (i * n + i) * LANE;
+        const real* di = im + (i * n + i) * LANE;
+        for (uint j = 0; j < m; j++) {
+            real* xr = bre + (i * m + j) * LANE;
+            real* xi = bim + (i * m + j) * LANE;
+            for (uint l = 0; l < LANE; l++) {
+                real m2 = dr[l] * dr[l] + di[l] * di[l];
+                real r = (xr[l] * dr[l] + xi[l] * di[l]) / m2;
+                xi[l] = (xi[l] * dr[l] - xr[l] * di[l]) / m2;
+                xr[l] = r;
+            }
+        }
+    }
+}
+
+static void Factor(uint n, real* re, real* im, int* piv, Complex* det)
+{
+    switch (n) {
+    case 2:
+        FactorTile<2>(re, im, piv, det, n);
+        break;
+    case 4:
+        FactorTile<4>(re, im, piv, det, n);
+        break;
+    case 8:
+        FactorTile<8>(re, im, piv, det, n);
+        break;
+    case 16:
+        FactorTile<16>(re, im, piv, det, n);
+        break;
+    default:
+        FactorTile<0>(re, im, piv, det, n);
+    }
+}
+
+static void Solve(uint n, const real* re, const real* im, const int* piv, real* bre, real* bim, uint m)
+{
+    switch (n) {
+    case 2:
+        SolveTile<2>(re, im, piv, bre, bim, n, m);
+        break;
+    case 4:
+        SolveTile<4>(re, im, piv, bre, bim, n, m);
+        break;
+    case 8:
+        SolveTile<8>(re, im, piv, bre, bim, n, m);
+        break;
+    case 16:
+        SolveTile<16>(re, im, piv, bre, bim, n, m);
+        break;
+    default:
+        SolveTile<0>(re, im, piv, bre, bim, n, m);
+    }
+}
+
+BatchedLU::BatchedLU(uint N_, uint NBatch_)
+{
+    Resize(N_, NBatch_);
+}
+
+void BatchedLU::Resize(uint N_, uint NBatch_)
+{
+    N = N_;
+    NBatch = NBatch_;
+    _NTile = (NBatch + LANE - 1) / LANE;
+    _Re.resize(_NTile * N * N * LANE);
+    _Im.resize(_NTile * N * N * LANE);
+    _Pivot.resize(_NTile * N * LANE);
+    _Determ.resize(NBatch);
+}
+
+void BatchedLU::Factor(const Complex* A, int NThread)
+{
+    ASSERT_ALLWAYS(N > 0, "BatchedLU should be resized first!");
+    ParallelFor(_NTile, NThread, [&](uint begin, uint end) {
+        Complex det[LANE];
+        for (uint t = begin; t < end; t++) {
+            real* re = &_Re[t * N * N * LANE];
+            real* im = &_Im[t * N * N * LANE];
+            //the lanes after the last matrix are identities
+            for (uint e = 0; e < N * N; e++)
+                for (uint l = 0, b = t * LANE; l < LANE; l++, b++) {
+                    Complex a = b < NBatch ? A[e * NBatch + b] : Complex(e % (N + 1) == 0 ? 1.0 : 0.0, 0.0);
+                    re[e * LANE + l] = a.Re;
+                    im[e * LANE + l] = a.Im;
+                }
+            ::Factor(N, re, im, &_Pivot[t * N * LANE], det);
+            for (uint l = 0, b = t * LANE; l < LANE && b < NBatch; l++, b++)
+                _Determ[b] = det[l];
+        }
+    });
+}
+
+/**
+*  B=nullptr is the identity
+*/
+static void SolveTiles(uint N, uint NBatch, uint NTile, const vector<real>& Re, const vector<real>& Im,
+                       const vector<int>& Pivot, const Complex* B, Complex* X, uint NRHS, int NThread)
+{
+    ParallelFor(NTile, NThread, [&](uint begin, uint end) {
+        vector<real> bre(N * NRHS * LANE), bim(N * NRHS * LANE);
+        for (uint t = begin; t < end; t++) {
+            for (uint e = 0; e < N * NRHS; e++)
+                for (uint l = 0, b = t * LANE; l < LANE; l++, b++) {
+                    Complex y(0.0, 0.0);
+                    if (B == nullptr)
+                        y.Re = (e / NRHS == e % NRHS) ? 1.0 : 0.0;
+                    else if (b < NBatch)
+                        y = B[e * NBatch + b];
+                    bre[e * LANE + l] = y.Re;
+                    bim[e * LANE + l] = y.Im;
+                }
+            ::Solve(N, &Re[t * N * N * LANE], &Im[t * N * N * LANE], &Pivot[t * N * LANE],
+                    bre.data(), bim.data(), NRHS);
+            for (uint e = 0; e < N * NRHS; e++)
+                for (uint l = 0, b = t * LANE; l < LANE && b < NBatch; l++, b++)
+                    X[e * NBatch + b] = Complex(bre[e * LANE + l], bim[e * LANE + l]);
+        }
+    });
+}
+
+void BatchedLU::Solve(const Complex* B, Complex* X, uint NRHS, int NThread) const
+{
+    ASSERT_ALLWAYS(B != nullptr && X != nullptr, "B and X should not be null!");
+    SolveTiles(N, NBatch, _NTile, _Re, _Im, _Pivot, B, X, NRHS, NThread);
+}
+
+void BatchedLU::Inverse(Complex* X, int NThread) const
+{
+    ASSERT_ALLWAYS(X != nullptr, "X should not be null!");
+    SolveTiles(N, NBatch, _NTile, _Re, _Im, _Pivot, nullptr, X, N, NThread);
+}
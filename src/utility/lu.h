@@ -0,0 +1,56 @@
+//
+//  lu.h
+//  Feynman_Simulator
+//
+//  Created by Kun Chen on 3/5/15.
+//  Copyright (c) 2015 Kun Chen. All rights reserved.
+//
+
+#ifndef __Feynman_Simulator__lu__
+#define __Feynman_Simulator__lu__
+
+#include "complex.h"
+#include <vector>
+
+/*
+ *  LU decomposition with partial pivoting of a batch of small complex matrices, the same as
+ *  LAPACK zgetrf/zgetrs/zgetri called on every matrix, but without LAPACK.
+ *  Matrices are interleaved: the element (i, j) of the b-th matrix of order N is A[(i*N+j)*NBatch+b],
+ *  which is the layout of the (spin, sublattice) matrices of a weight array at all (r, tau).
+ *  Inside, LANE matrices are factorized together, with the real and imaginary parts in separate
+ *  arrays, so that every step is a loop over the lane which the compiler vectorizes.
+ *  N = 2, 4, 8 and 16 are unrolled at compile time.
+ */
+class BatchedLU {
+public:
+    static const uint LANE = 8;
+
+    BatchedLU()
+        : N(0)
+        , NBatch(0){};
+    BatchedLU(uint N, uint NBatch);
+    void Resize(uint N, uint NBatch);
+
+    uint N, NBatch;
+
+    //like zgetrf, a zero pivot leaves a zero in U, so that the determinant is zero
+    void Factor(const Complex* A, int NThread = 1);
+    //solve A*X=B, B and X are interleaved NxNRHS matrices, X may be B
+    void Solve(const Complex* B, Complex* X, uint NRHS, int NThread = 1) const;
+    void Solve(const Complex* B, Complex* X, int NThread = 1) const { Solve(B, X, N, NThread); }
+    void Inverse(Complex* X, int NThread = 1) const;
+    //det(A) of every matrix
+    const std::vector<Complex>& Determinant() const { return _Determ; }
+
+private:
+    uint _NTile;
+    //tile t keeps the LU factors of the matrices t*LANE...t*LANE+LANE-1, element (i, j) of lane l is at
+    //[(t*N*N+i*N+j)*LANE+l]; a pivot is the row swapped with row k at step k
+    std::vector<real> _Re, _Im;
+    std::vector<int> _Pivot;
+    std::vector<Complex> _Determ;
+};
+
+int TestLU();
+
+#endif /* defined(__Feynman_Simulator__lu__) */
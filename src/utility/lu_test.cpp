@@ -0,0 +1,129 @@
+//
+//  lu_test.cpp
+//  Feynman_Simulator
+//
+//  Created by Kun Chen on 3/5/15.
+//  Copyright (c) 2015 Kun Chen. All rights reserved.
+//
+
+#include "lu.h"
+#include "rng.h"
+#include "sput.h"
+#include "utility.h"
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+void Test_LU_LAPACK();
+void Test_LU_Solve();
+void Test_LU_Singular();
+
+int TestLU()
+{
+    sput_start_testing();
+    sput_enter_suite("Test Batched LU:");
+    sput_run_test(Test_LU_LAPACK);
+    sput_run_test(Test_LU_Solve);
+    sput_run_test(Test_LU_Singular);
+    sput_finish_testing();
+    return sput_get_return_value();
+}
+
+//a batch of copies of the matrix
+vector<Complex> Batch(const vector<Complex>& matrix, uint NBatch)
+{
+    vector<Complex> batch(matrix.size() * NBatch);
+    for (uint e = 0; e < matrix.size(); e++)
+        for (uint b = 0; b < NBatch; b++)
+            batch[e * NBatch + b] = matrix[e];
+    return batch;
+}
+
+void Test_LU_LAPACK()
+{
+    //det and inv of numpy.linalg, which call zgetrf/zgetri
+    vector<Complex> A = { Complex(1, 2), Complex(2, -1), Complex(0.5, 0),
+                          Complex(3, 0), Complex(0, 1), Complex(-1, 1),
+                          Complex(0.25, -0.5), Complex(4, 0), Complex(2, 2) };
+    vector<Complex> Inv = { Complex(-0.12775951150774986, 0.4734617191169565), Complex(0.7740723344293096, -0.04509159229685327), Complex(-0.06575857209957749, -0.462188821042743),
+                            Complex(1.317989666510099, 0.2921559417566929), Complex(-0.22076092062000974, -1.1230624706434946), Complex(-0.7627994363550962, 0.23860967590418064),
+                            Complex(-1.7069046500704557, 1.0314701737905128), Complex(1.4006575857209962, 1.0446218882104272), Complex(0.8567402536402065, -1.2926256458431191) };
+    const uint NBatch = 11;
+    BatchedLU lu(3, NBatch);
+    lu.Factor(Batch(A, NBatch).data());
+    vector<Complex> X(9 * NBatch);
+    lu.Inverse(X.data());
+    bool IsSame = true;
+    for (uint b = 0; b < NBatch; b++) {
+        IsSame &= Equal(lu.Determinant()[b], Complex(-5.0, -2.8750000000000013), 1.0e-13);
+        for (uint e = 0; e < 9; e++)
+            IsSame &= Equal(X[e * NBatch + b], Inv[e], 1.0e-13);
+    }
+    sput_fail_unless(IsSame, "Determinant and inverse are the same as LAPACK");
+
+    //the row with the largest |Re|+|Im| is the pivot
+    lu.Resize(2, 1);
+    vector<Complex> B = { Complex(1, 0), Complex(2, 0), Complex(3, 0), Complex(4, 0) };
+    lu.Factor(B.data());
+    sput_fail_unless(Equal(lu.Determinant()[0], Complex(-2.0, 0.0), 1.0e-14), "Determinant of a pivoted matrix");
+}
+
+void Test_LU_Solve()
+{
+    RandomFactory rng;
+    rng.Reset(519180543);
+    const uint NBatch = 37;
+    for (uint n : { 2, 3, 4, 5, 8, 16 }) {
+        vector<Complex> A(n * n * NBatch), B(n * n * NBatch), X(n * n * NBatch), Y(n * n * NBatch);
+        for (auto& a : A)
+            a = Complex(rng.urn() - 0.5, rng.urn() - 0.5);
+        for (auto& b : B)
+            b = Complex(rng.urn() - 0.5, rng.urn() - 0.5);
+        BatchedLU lu(n, NBatch);
+        lu.Factor(A.data(), 4);
+        lu.Solve(B.data(), X.data(), 4);
+        real residual = 0.0;
+        for (uint p = 0; p < NBatch; p++)
+            for (uint i = 0; i < n; i++)
+                for (uint j = 0; j < n; j++) {
+                    Complex r = -B[(i * n + j) * NBatch + p];
+                    for (uint k = 0; k < n; k++)
+                        r += A[(i * n + k) * NBatch + p] * X[(k * n + j) * NBatch + p];
+                    residual = max(residual, mod(r));
+                }
+        sput_fail_unless(residual < 1.0e-10, ("A*X=B for N=" + ToString(n)).c_str());
+
+        //in place and with one thread
+        vector<Complex> Det = lu.Determinant();
+        BatchedLU serial(n, NBatch);
+        serial.Factor(A.data());
+        Y = B;
+        serial.Solve(Y.data(), Y.data());
+        bool IsExact = true;
+        for (uint i = 0; i < X.size(); i++)
+            IsExact &= (X[i].Re == Y[i].Re && X[i].Im == Y[i].Im);
+        for (uint p = 0; p < NBatch; p++)
+            IsExact &= (Det[p].Re == serial.Determinant()[p].Re && Det[p].Im == serial.Determinant()[p].Im);
+        sput_fail_unless(IsExact, ("Threads and solving in place do not change X for N=" + ToString(n)).c_str());
+
+        //det(A)*det(A^-1)=1
+        serial.Inverse(Y.data());
+        serial.Factor(Y.data());
+        bool IsOne = true;
+        for (uint p = 0; p < NBatch; p++)
+            IsOne &= Equal(Det[p] * serial.Determinant()[p], Complex(1.0, 0.0), 1.0e-8);
+        sput_fail_unless(IsOne, ("det(A)*det(A^-1)=1 for N=" + ToString(n)).c_str());
+    }
+}
+
+void Test_LU_Singular()
+{
+    vector<Complex> A = { Complex(1, 1), Complex(2, 2), Complex(0.5, 0.5), Complex(1, 1) };
+    BatchedLU lu(2, 1);
+    lu.Factor(A.data());
+    sput_fail_unless(Equal(lu.Determinant()[0], Complex(0.0, 0.0), 1.0e-14), "Singular matrix has zero determinant");
+    vector<Complex> Z(4, Complex(0.0, 0.0));
+    lu.Factor(Z.data());
+    sput_fail_unless(lu.Determinant()[0].Re == 0.0 && lu.Determinant()[0].Im == 0.0, "Zero matrix is factorized");
+}
@@ -11,6 +11,8 @@
 
 #include <stdio.h>
 #include <iostream>
+#include <array>
+#include <stdint.h>
 
 const int MAX_K = 10000;
 
@@ -56,4 +58,51 @@ bool operator!=(const Momentum &, const Momentum &);
 bool operator!=(const Momentum &, int);
 bool operator!=(int, const Momentum &);
 
+/**
+*  \brief occupancy of NSlot momentum slots packed into 64-bit words, with the number of occupied slots
+*/
+template <int NSlot>
+class MomentumHash {
+  public:
+    MomentumHash()
+    {
+        Clear();
+    }
+    bool Test(int i) const { return (_Words[i >> 6] >> (i & 63)) & 1; }
+    void Set(int i)
+    {
+        _Count += !Test(i);
+        _Words[i >> 6] |= uint64_t(1) << (i & 63);
+    }
+    void Reset(int i)
+    {
+        _Count -= Test(i);
+        _Words[i >> 6] &= ~(uint64_t(1) << (i & 63));
+    }
+    void Clear()
+    {
+        _Words.fill(0);
+        _Count = 0;
+    }
+    int Count() const { return _Count; }
+    /**
+    *  slot of the n-th (from 0) free slot, -1 if there are not so many free slots. The answer is n plus
+    *  the number of occupied slots below it, so only the words up to the answer are read, and an empty
+    *  word costs a single test
+    */
+    int SelectFree(int n) const
+    {
+        int slot = n;
+        for (int w = 0; w < NWord && w * 64 <= slot; w++)
+            for (uint64_t bits = _Words[w]; bits != 0 && w * 64 + __builtin_ctzll(bits) <= slot; bits &= bits - 1)
+                slot++;
+        return slot < NSlot ? slot : -1;
+    }
+
+  private:
+    static const int NWord = (NSlot + 63) / 64;
+    std::array<uint64_t, NWord> _Words;
+    int _Count;
+};
+
 #endif /* defined(__Feynman_Simulator__momentum__) */
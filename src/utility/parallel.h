@@ -0,0 +1,44 @@
+//
+//  parallel.h
+//  Feynman_Simulator
+//
+//  Created by Kun Chen on 3/5/15.
+//  Copyright (c) 2015 Kun Chen. All rights reserved.
+//
+
+#ifndef __Feynman_Simulator__parallel__
+#define __Feynman_Simulator__parallel__
+
+#include "convention.h"
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <vector>
+
+//the number of threads for NThread<=0, which means all cores
+inline int ThreadNumber(int NThread)
+{
+    return NThread > 0 ? NThread : std::max(1, (int)std::thread::hardware_concurrency());
+}
+
+/**
+*  run Body(Begin, End) on NThread slices of [0, N), each in its own thread; Body should not throw
+*/
+inline void ParallelFor(uint N, int NThread, const std::function<void(uint, uint)>& Body)
+{
+    uint nthread = (uint)std::max(1, NThread);
+    if (nthread > N)
+        nthread = N;
+    if (nthread <= 1) {
+        Body(0, N);
+        return;
+    }
+    std::vector<std::thread> threads;
+    uint chunk = (N + nthread - 1) / nthread;
+    for (uint begin = 0; begin < N; begin += chunk)
+        threads.push_back(std::thread(Body, begin, std::min(N, begin + chunk)));
+    for (auto& t : threads)
+        t.join();
+}
+
+#endif /* defined(__Feynman_Simulator__parallel__) */
@@ -0,0 +1,415 @@
+//
+//  native.cpp
+//  Feynman_Simulator
+//
+//  Created by Kun Chen on 3/5/15.
+//  Copyright (c) 2015 Kun Chen. All rights reserved.
+//
+
+#ifdef NO_PYTHON
+
+#include "utility/complex.h"
+#include "utility/rng.h"
+#include "utility/momentum.h"
+#include "utility/literal.h"
+#include "pywrapper.h"
+#include <iostream>
+#include <string.h>
+
+using namespace std;
+
+namespace Python {
+//there is no interpreter to start or stop
+void Initialize() {}
+void Finalize() {}
+void ArrayInitialize() {}
+void PrintError() {}
+void ClearError() {}
+void PropagatePyError() {}
+
+void Object::Print() const
+{
+    cout << Object(*this).PrettyString() << endl;
+}
+
+std::string Object::PrettyString()
+{
+    if (_Node == nullptr)
+        return "None";
+    return FormatLiteral(AnyObject(*this));
+}
+
+void Object::MakeSureNotNull()
+{
+    if (_Node == nullptr)
+        ABORT("Object is null!");
+}
+
+static Object NewNode(NodeType type)
+{
+    auto node = make_shared<Node>();
+    node->Type = type;
+    node->Int = 0;
+    node->Re = node->Im = 0.0;
+    return Object(node);
+}
+
+static bool IsType(const Object& obj, NodeType type)
+{
+    return obj.GetNode() != nullptr && obj.GetNode()->Type == type;
+}
+
+//the same as python, where a bool is also an int
+static bool IsInt(const Object& obj)
+{
+    return IsType(obj, NODE_INT) || IsType(obj, NODE_BOOL);
+}
+
+Object NoneObject()
+{
+    return Object();
+}
+
+bool IsNone(const Object& obj)
+{
+    return obj.GetNode() == nullptr;
+}
+
+const std::vector<Object>* ListOf(const Object& obj)
+{
+    return IsType(obj, NODE_LIST) ? &obj.GetNode()->List : nullptr;
+}
+
+const std::map<std::string, Object>* DictOf(const Object& obj)
+{
+    return IsType(obj, NODE_DICT) ? &obj.GetNode()->Dict : nullptr;
+}
+
+Object NewList(std::vector<Object>&& items)
+{
+    Object obj = NewNode(NODE_LIST);
+    obj.GetNode()->List = std::move(items);
+    return obj;
+}
+
+Object NewDict(std::map<std::string, Object>&& items)
+{
+    Object obj = NewNode(NODE_DICT);
+    obj.GetNode()->Dict = std::move(items);
+    return obj;
+}
+
+/**********************   Convert  **************************/
+
+bool Convert(Object obj, std::string& val)
+{
+    if (!IsType(obj, NODE_STRING))
+        return false;
+    val = obj.GetNode()->String;
+    return true;
+}
+bool Convert(Object obj, bool& value)
+{
+    if (!IsType(obj, NODE_BOOL))
+        return false;
+    value = obj.GetNode()->Int != 0;
+    return true;
+}
+
+template <typename T>
+bool ConvertInt(const Object& obj, T& value)
+{
+    if (!IsInt(obj))
+        return false;
+    value = (T)obj.GetNode()->Int;
+    return true;
+}
+bool Convert(Object obj, int& value)
+{
+    return ConvertInt(obj, value);
+}
+bool Convert(Object obj, unsigned int& value)
+{
+    return ConvertInt(obj, value);
+}
+bool Convert(Object obj, long& value)
+{
+    return ConvertInt(obj, value);
+}
+bool Convert(Object obj, unsigned long& value)
+{
+    return ConvertInt(obj, value);
+}
+bool Convert(Object obj, long long& value)
+{
+    return ConvertInt(obj, value);
+}
+bool Convert(Object obj, unsigned long long& value)
+{
+    return ConvertInt(obj, value);
+}
+
+template <typename T>
+bool ConvertReal(const Object& obj, T& value)
+{
+    if (IsInt(obj))
+        value = (T)obj.GetNode()->Int;
+    else if (IsType(obj, NODE_REAL))
+        value = (T)obj.GetNode()->Re;
+    else
+        return false;
+    return true;
+}
+bool Convert(Object obj, float& val)
+{
+    return ConvertReal(obj, val);
+}
+bool Convert(Object obj, double& val)
+{
+    return ConvertReal(obj, val);
+}
+bool Convert(Object obj, Complex& val)
+{
+    if (!IsType(obj, NODE_COMPLEX))
+        return false;
+    val = Complex(obj.GetNode()->Re, obj.GetNode()->Im);
+    return true;
+}
+bool Convert(Object obj, RandomFactory& rng)
+{
+    std::string source;
+    if (!Convert(obj, source))
+        return false;
+    istringstream iss(source);
+    iss >> rng;
+    return !(iss.bad() || iss.fail());
+}
+bool Convert(Object obj, ITypeCast& value)
+{
+    return value.FromPy(obj);
+}
+bool Convert(Object obj, spin& val)
+{
+    int value;
+    if (!Convert(obj, value))
+        return false;
+    val = (spin)value;
+    return true;
+}
+bool Convert(Object obj, Momentum& val)
+{
+    return Convert(obj, val.K);
+}
+bool Convert(Object obj, AnyObject& any)
+{
+    any = obj;
+    return true;
+}
+
+/**********************   CastToPy  **************************/
+
+Object CastToPy(const std::string& str)
+{
+    Object obj = NewNode(NODE_STRING);
+    obj.GetNode()->String = str;
+    return obj;
+}
+Object CastToPy(const char* str)
+{
+    return CastToPy(std::string(str));
+}
+Object CastToPy(bool value)
+{
+    Object obj = NewNode(NODE_BOOL);
+    obj.GetNode()->Int = value;
+    return obj;
+}
+Object CastToPy(long long num)
+{
+    Object obj = NewNode(NODE_INT);
+    obj.GetNode()->Int = num;
+    return obj;
+}
+Object CastToPy(int num)
+{
+    return CastToPy((long long)num);
+}
+Object CastToPy(unsigned int num)
+{
+    return CastToPy((long long)num);
+}
+Object CastToPy(long num)
+{
+    return CastToPy((long long)num);
+}
+Object CastToPy(unsigned long num)
+{
+    return CastToPy((long long)num);
+}
+//stored in the bits of a long long, so that it converts back to the same unsigned value
+Object CastToPy(unsigned long long num)
+{
+    return CastToPy((long long)num);
+}
+Object CastToPy(double num)
+{
+    Object obj = NewNode(NODE_REAL);
+    obj.GetNode()->Re = num;
+    return obj;
+}
+Object CastToPy(float num)
+{
+    return CastToPy((double)num);
+}
+Object CastToPy(const Complex& num)
+{
+    Object obj = NewNode(NODE_COMPLEX);
+    obj.GetNode()->Re = num.Re;
+    obj.GetNode()->Im = num.Im;
+    return obj;
+}
+Object CastToPy(const RandomFactory& rng)
+{
+    return CastToPy(ToString(rng));
+}
+Object CastToPy(const ITypeCast& val)
+{
+    return val.ToPy();
+}
+Object CastToPy(Object obj)
+{
+    return obj.Copy();
+}
+Object CastToPy(spin num)
+{
+    return CastToPy((int)num);
+}
+Object CastToPy(Momentum k)
+{
+    return CastToPy(k.K);
+}
+
+/**********************   ArrayObject  **************************/
+
+//number of bytes of one item, like 16 for "<c16"
+static size_t ItemSize(const std::string& DType)
+{
+    ASSERT_ALLWAYS(DType.size() >= 3 && (DType[0] == '<' || DType[0] == '|') && strchr("bifuc", DType[1]) != nullptr,
+                   "Unknown array type " << DType);
+    return (size_t)atoi(DType.c_str() + 2);
+}
+
+bool Convert(Object obj, ArrayObject& array)
+{
+    if (!IsType(obj, NODE_ARRAY))
+        return false;
+    array = obj;
+    return true;
+}
+
+ArrayObject::ArrayObject(const Object& obj)
+    : Object(obj)
+{
+    if (!IsType(obj, NODE_ARRAY))
+        ABORT("Array object is expected!");
+}
+
+ArrayObject::ArrayObject(const std::string& DType, const std::vector<uint>& Shape, const void* data)
+{
+    size_t size = ItemSize(DType);
+    for (auto n : Shape)
+        size *= n;
+    char* memory = new char[size > 0 ? size : 1];
+    if (size > 0)
+        memcpy(memory, data, size);
+    *this = Object(NewNode(NODE_ARRAY));
+    _Node->String = DType;
+    _Node->Shape = Shape;
+    _Node->Data = shared_ptr<char>(memory, default_delete<char[]>());
+}
+
+void ArrayObject::_Borrow(const std::string& DType, void* data, const uint* Shape, const int Dim)
+{
+    ASSERT_ALLWAYS(data != nullptr, "data pointer shouldn't be null!");
+    ASSERT_ALLWAYS(Shape != nullptr, "Shape pointer shouldn't be null!");
+    *this = Object(NewNode(NODE_ARRAY));
+    _Node->String = DType;
+    _Node->Shape.assign(Shape, Shape + Dim);
+    //the array does not own data, the same as PyArray_SimpleNewFromData
+    _Node->Data = shared_ptr<char>(static_cast<char*>(data), [](char*) {});
+}
+
+void ArrayObject::_Construct(Complex* data, const uint* Shape, const int Dim)
+{
+    _Borrow("<c" + ToString(sizeof(Complex)), data, Shape, Dim);
+}
+
+void ArrayObject::_Construct(real* data, const uint* Shape, const int Dim)
+{
+    _Borrow("<f" + ToString(sizeof(real)), data, Shape, Dim);
+}
+
+void ArrayObject::_KeepAlive(const std::shared_ptr<const void>& Owner)
+{
+    //the same data, but owned by Owner
+    _Node->Data = shared_ptr<char>(Owner, _Node->Data.get());
+}
+
+std::shared_ptr<char> ArrayObject::Share()
+{
+    ASSERT_ALLWAYS(_Node != nullptr, "ArrayObject is still empty!");
+    return _Node->Data;
+}
+
+template <>
+Complex* ArrayObject::Data<Complex>()
+{
+    ASSERT_ALLWAYS(_Node != nullptr, "ArrayObject is still empty!");
+    return reinterpret_cast<Complex*>(_Node->Data.get());
+}
+template <>
+real* ArrayObject::Data<real>()
+{
+    ASSERT_ALLWAYS(_Node != nullptr, "ArrayObject is still empty!");
+    return reinterpret_cast<real*>(_Node->Data.get());
+}
+
+std::vector<uint> ArrayObject::Shape()
+{
+    ASSERT_ALLWAYS(_Node != nullptr, "ArrayObject is still empty!");
+    return _Node->Shape;
+}
+
+uint ArrayObject::Size()
+{
+    uint size = 1;
+    for (auto i : Shape())
+        size *= i;
+    return size;
+}
+
+int ArrayObject::Dim()
+{
+    ASSERT_ALLWAYS(_Node != nullptr, "ArrayObject is still empty!");
+    return (int)_Node->Shape.size();
+}
+
+std::string ArrayObject::DType()
+{
+    ASSERT_ALLWAYS(_Node != nullptr, "ArrayObject is still empty!");
+    return _Node->String;
+}
+
+const char* ArrayObject::Bytes()
+{
+    ASSERT_ALLWAYS(_Node != nullptr, "ArrayObject is still empty!");
+    return _Node->Data.get();
+}
+
+size_t ArrayObject::NBytes()
+{
+    return Size() * ItemSize(DType());
+}
+}
+
+#endif
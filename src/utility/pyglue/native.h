@@ -0,0 +1,354 @@
+//
+//  native.h
+//  Feynman_Simulator
+//
+//  Created by Kun Chen on 3/5/15.
+//  Copyright (c) 2015 Kun Chen. All rights reserved.
+//
+
+#ifndef __Feynman_Simulator__native__
+#define __Feynman_Simulator__native__
+
+/*
+ *  Native backend of the pyglue layer, used instead of the embedded interpreter when the simulator
+ *  is built with -DUSE_PYTHON=OFF (NO_PYTHON is defined). It has the same interface as
+ *  object.h/type_cast.h/pyarraywrapper.h/pywrapper.h, but an Object is a reference counted C++ value
+ *  (bool, int, real, complex, string, list, dict with string keys, or array) instead of a PyObject.
+ *  Like in python, copies of an Object share the same value. Dictionary, checkpoints and the literal
+ *  reader/writer work the same on top of both backends; only ModuleObject (calling python scripts)
+ *  is not available.
+ */
+
+#include <string>
+#include <memory>
+#include <map>
+#include <vector>
+#include <list>
+#include <tuple>
+#include <type_traits>
+#include "utility/vector.h"
+#include "utility/convention.h"
+#include "utility/abort.h"
+
+class Complex;
+class RandomFactory;
+class Momentum;
+
+namespace Python {
+void Initialize();
+void Finalize();
+void ArrayInitialize();
+void PrintError();
+void ClearError();
+void PropagatePyError();
+
+enum NodeType {
+    NODE_BOOL = 0,
+    NODE_INT,
+    NODE_REAL,
+    NODE_COMPLEX,
+    NODE_STRING,
+    NODE_LIST,
+    NODE_DICT,
+    NODE_ARRAY
+};
+class Object;
+//the value behind an Object, only the fields of its Type are used
+struct Node {
+    NodeType Type;
+    long long Int; //also for bool
+    real Re, Im;
+    std::string String; //also the numpy typestr of an array, like "<c16"
+    std::vector<Object> List;
+    std::map<std::string, Object> Dict;
+    std::vector<uint> Shape;
+    std::shared_ptr<char> Data; //an array either owns Data or borrows it from its creator
+};
+
+class Object {
+public:
+    Object() {}
+    Object(const std::shared_ptr<Node>& node)
+        : _Node(node)
+    {
+    }
+    //a new reference to the same value, the same as the copy constructor
+    Object Copy() const { return *this; }
+    long RefCount() const { return _Node ? _Node.use_count() : -1; }
+    void Destroy() { _Node.reset(); }
+    void Print() const;
+    std::string PrettyString();
+    void MakeSureNotNull();
+    //nullptr for an empty Object
+    Node* GetNode() const { return _Node.get(); }
+
+protected:
+    std::shared_ptr<Node> _Node;
+};
+}
+
+#include "type_cast_interface.h"
+
+namespace Python {
+/**********************   conversion from/to Object  **************************/
+
+bool Convert(Object obj, std::string& val);
+bool Convert(Object obj, bool& value);
+bool Convert(Object obj, int& value);
+bool Convert(Object obj, unsigned int& value);
+bool Convert(Object obj, long& value);
+bool Convert(Object obj, unsigned long& value);
+bool Convert(Object obj, long long& value);
+bool Convert(Object obj, unsigned long long& value);
+bool Convert(Object obj, float& value);
+bool Convert(Object obj, double& value);
+bool Convert(Object obj, Complex& val);
+bool Convert(Object obj, RandomFactory& val);
+bool Convert(Object obj, spin& val);
+bool Convert(Object obj, Momentum& val);
+bool Convert(Object obj, ITypeCast& val);
+
+Object CastToPy(const std::string& str);
+Object CastToPy(const char* str);
+Object CastToPy(int num);
+Object CastToPy(unsigned int num);
+Object CastToPy(long num);
+Object CastToPy(unsigned long num);
+Object CastToPy(long long num);
+Object CastToPy(unsigned long long num);
+Object CastToPy(bool value);
+Object CastToPy(float num);
+Object CastToPy(double num);
+Object CastToPy(const Complex& num);
+Object CastToPy(const RandomFactory& val);
+Object CastToPy(spin num);
+Object CastToPy(Momentum num);
+Object CastToPy(const ITypeCast& val);
+Object CastToPy(Object);
+
+//None of python is an empty Object
+Object NoneObject();
+bool IsNone(const Object& obj);
+//items of a list/dict Object, nullptr if obj is not a list/dict
+const std::vector<Object>* ListOf(const Object& obj);
+const std::map<std::string, Object>* DictOf(const Object& obj);
+Object NewList(std::vector<Object>&& items);
+Object NewDict(std::map<std::string, Object>&& items);
+
+template <typename T>
+bool Convert(Object obj, Vec<T>& val)
+{
+    auto list = ListOf(obj);
+    if (list == nullptr || list->size() < val.size())
+        return false;
+    for (uint i = 0; i < val.size(); i++) {
+        T v;
+        if (!Convert((*list)[i], v))
+            return false;
+        val[i] = v;
+    }
+    return true;
+}
+
+//a tuple is stored as a list
+template <size_t n, class... Args>
+typename std::enable_if<n == 0, bool>::type
+AddToTuple(const std::vector<Object>& list, std::tuple<Args...>& tup)
+{
+    return Convert(list[n], std::get<n>(tup));
+}
+
+template <size_t n, class... Args>
+typename std::enable_if<n != 0, bool>::type
+AddToTuple(const std::vector<Object>& list, std::tuple<Args...>& tup)
+{
+    return AddToTuple<n - 1, Args...>(list, tup) && Convert(list[n], std::get<n>(tup));
+}
+
+template <class... Args>
+bool Convert(Object obj, std::tuple<Args...>& tup)
+{
+    auto list = ListOf(obj);
+    if (list == nullptr || list->size() != sizeof...(Args))
+        return false;
+    return AddToTuple<sizeof...(Args)-1, Args...>(*list, tup);
+}
+
+template <class K, class V>
+bool Convert(Object obj, std::map<K, V>& mp)
+{
+    auto dict = DictOf(obj);
+    if (dict == nullptr)
+        return false;
+    for (auto& item : *dict) {
+        K key;
+        if (!Convert(CastToPy(item.first), key))
+            return false;
+        V val;
+        if (!Convert(item.second, val))
+            return false;
+        mp.insert(std::make_pair(key, val));
+    }
+    return true;
+}
+
+template <class T, class C>
+bool ConvertList(Object obj, C& container)
+{
+    auto list = ListOf(obj);
+    if (list == nullptr)
+        return false;
+    for (auto& item : *list) {
+        T val;
+        if (!Convert(item, val))
+            return false;
+        container.push_back(std::move(val));
+    }
+    return true;
+}
+template <class T>
+bool Convert(Object obj, std::list<T>& lst)
+{
+    return ConvertList<T, std::list<T> >(obj, lst);
+}
+template <class T>
+bool Convert(Object obj, std::vector<T>& vec)
+{
+    return ConvertList<T, std::vector<T> >(obj, vec);
+}
+
+template <class T>
+static Object CastToPyList(const T& container)
+{
+    std::vector<Object> items;
+    for (auto it(container.begin()); it != container.end(); ++it)
+        items.push_back(CastToPy(*it));
+    return NewList(std::move(items));
+}
+template <typename T>
+Object CastToPy(const Vec<T>& container)
+{
+    return CastToPyList(container);
+}
+template <class T>
+Object CastToPy(const std::vector<T>& container)
+{
+    return CastToPyList(container);
+}
+template <class T>
+Object CastToPy(const std::list<T>& container)
+{
+    return CastToPyList(container);
+}
+//only string keys, like the keys of a Dictionary
+template <class T, class K>
+Object CastToPy(const std::map<T, K>& container)
+{
+    std::map<std::string, Object> items;
+    for (auto it(container.begin()); it != container.end(); ++it) {
+        std::string key;
+        if (!Convert(CastToPy(it->first), key))
+            THROW_ERROR(TypeInvalid, "Only string keys are supported without python!");
+        items[key] = CastToPy(it->second);
+    }
+    return NewDict(std::move(items));
+}
+
+/**********************   ArrayObject  **************************/
+
+void ArrayInitialize();
+class ArrayObject;
+bool Convert(Object, ArrayObject&);
+class ArrayObject : public Object {
+public:
+    ArrayObject()
+        : Object()
+    {
+    }
+    ArrayObject(const Object& obj);
+    //the array borrows data, which has to outlive the array, the same as the python backend
+    template <typename T>
+    ArrayObject(T* data, const std::vector<uint>& Shape, const int Dim)
+    {
+        _Construct(data, Shape.data(), Dim);
+    }
+    template <typename T>
+    ArrayObject(T* data, const uint* Shape, const int Dim)
+    {
+        _Construct(data, Shape, Dim);
+    }
+    //the array shares the ownership of data with Owner, so it stays valid after its creator is gone
+    template <typename T>
+    ArrayObject(T* data, const std::vector<uint>& Shape, const int Dim, const std::shared_ptr<const void>& Owner)
+    {
+        _Construct(data, Shape.data(), Dim);
+        _KeepAlive(Owner);
+    }
+    template <typename T>
+    ArrayObject(T* data, const uint* Shape, const int Dim, const std::shared_ptr<const void>& Owner)
+    {
+        _Construct(data, Shape, Dim);
+        _KeepAlive(Owner);
+    }
+    //a new array which owns a copy of data, DType is in numpy's typestr format, like "<c16"
+    ArrayObject(const std::string& DType, const std::vector<uint>& Shape, const void* data);
+    template <typename T>
+    T* Data();
+    std::vector<uint> Shape();
+    uint Size();
+    int Dim();
+    std::string DType();
+    const char* Bytes();
+    size_t NBytes();
+    bool IsWritable() { return true; }
+    //shared ownership of the data of the array, so that it can be used in place
+    std::shared_ptr<char> Share();
+    ArrayObject& operator=(const ArrayObject& obj)
+    {
+        Object::operator=(obj);
+        return *this;
+    }
+
+private:
+    void _Construct(real* data, const uint* Shape, const int Dim);
+    void _Construct(Complex* data, const uint* Shape, const int Dim);
+    void _Borrow(const std::string& DType, void* data, const uint* Shape, const int Dim);
+    void _KeepAlive(const std::shared_ptr<const void>& Owner);
+};
+
+/**********************   AnyObject  **************************/
+
+class AnyObject;
+bool Convert(Object, AnyObject&);
+class AnyObject : public Object {
+public:
+    AnyObject()
+        : Object()
+    {
+    }
+    AnyObject(const Object& obj)
+        : Object(obj)
+    {
+    }
+    AnyObject& operator=(const AnyObject& obj)
+    {
+        Object::operator=(obj);
+        return *this;
+    }
+    template <typename T>
+    AnyObject(T value)
+        : Object(CastToPy(value))
+    {
+    }
+    template <typename T>
+    T As()
+    {
+        T value;
+        if (!Python::Convert(*this, value))
+            ABORT("Fail to convert Object!");
+        return value;
+    }
+};
+}
+
+#endif /* defined(__Feynman_Simulator__native__) */
@@ -6,6 +6,8 @@
 //  Copyright (c) 2014 Kun Chen. All rights reserved.
 //
 
+#ifndef NO_PYTHON
+
 #include "object.h"
 #include <iostream>
 #include "utility/abort.h"
@@ -161,4 +163,6 @@ void Object::MakeSureNotNull()
     if (_PyPtr == nullptr)
         ABORT("PyObject* is null!");
 }
-}
\ No newline at end of file
+}
+
+#endif
@@ -9,6 +9,11 @@
 #ifndef __Feynman_Simulator__object__
 #define __Feynman_Simulator__object__
 
+//without python, the native backend has the same interface
+#ifdef NO_PYTHON
+#include "native.h"
+#else
+
 /*
    Make sure you have carefully gone through the following explaination about reference count behavior in python before touch following codes
 */
@@ -77,4 +82,6 @@ protected:
 };
 }
 
+#endif /* NO_PYTHON */
+
 #endif /* defined(__Feynman_Simulator__object__) */
@@ -6,8 +6,12 @@
 //  Copyright (c) 2014 Kun Chen. All rights reserved.
 //
 
+#ifndef NO_PYTHON
+
 #include "utility/complex.h"
 #include "pyarraywrapper.h"
+#include "utility/utility.h"
+#include <string.h>
 #include <Python.h>
 #include <numpy/arrayobject.h>
 
@@ -100,6 +104,64 @@ void ArrayObject::_Construct(real* data, const uint* Shape, const int Dim)
     *this = Object(array);
 }
 
+ArrayObject::ArrayObject(const std::string& DType, const std::vector<uint>& Shape, const void* data)
+{
+    PyArray_Descr* descr = nullptr;
+    Object typestr = PyString_FromString(DType.c_str());
+    if (!PyArray_DescrConverter(typestr.Get(), &descr))
+        PropagatePyError();
+    ASSERT_ALLWAYS(descr != nullptr, "Unknown array type " << DType);
+    vector<npy_intp> _Shape;
+    for (auto i : Shape)
+        _Shape.push_back((npy_intp)i);
+    //PyArray_NewFromDescr steals the reference of descr
+    PyObject* array = PyArray_NewFromDescr(&PyArray_Type, descr, (int)_Shape.size(), _Shape.data(),
+                                           nullptr, nullptr, NPY_ARRAY_C_CONTIGUOUS, nullptr);
+    PropagatePyError();
+    ASSERT_ALLWAYS(array != nullptr, "Failed to create python array!");
+    *this = Object(array);
+    if (NBytes() > 0)
+        memcpy(PyArray_DATA((PyArrayObject*)_PyPtr), data, NBytes());
+}
+
+static const char* OwnerName = "Feynman_Simulator.ArrayOwner";
+
+static void ReleaseOwner(PyObject* capsule)
+{
+    delete static_cast<shared_ptr<const void>*>(PyCapsule_GetPointer(capsule, OwnerName));
+}
+
+/**
+*  a capsule holding a copy of Owner becomes the base object of the array, numpy releases it
+*  together with the array
+*/
+void ArrayObject::_KeepAlive(const shared_ptr<const void>& Owner)
+{
+    PyObject* capsule = PyCapsule_New(new shared_ptr<const void>(Owner), OwnerName, ReleaseOwner);
+    PropagatePyError();
+    //PyArray_SetBaseObject steals the reference of capsule
+    if (PyArray_SetBaseObject((PyArrayObject*)_PyPtr, capsule) != 0)
+        PropagatePyError();
+}
+
+shared_ptr<char> ArrayObject::Share()
+{
+    ASSERT_ALLWAYS(_PyPtr != nullptr, "ArrayObject is still empty!");
+    PyObject* array = Get(NewRef);
+    //the last user of the data may be in any thread
+    return shared_ptr<char>(reinterpret_cast<char*>(PyArray_DATA((PyArrayObject*)array)), [array](char*) {
+        PyGILState_STATE state = PyGILState_Ensure();
+        Py_DECREF(array);
+        PyGILState_Release(state);
+    });
+}
+
+bool ArrayObject::IsWritable()
+{
+    ASSERT_ALLWAYS(_PyPtr != nullptr, "ArrayObject is still empty!");
+    return PyArray_ISWRITEABLE((PyArrayObject*)_PyPtr);
+}
+
 template <>
 Complex* ArrayObject::Data<Complex>()
 {
@@ -136,4 +198,28 @@ int ArrayObject::Dim()
     ASSERT_ALLWAYS(_PyPtr != nullptr, "ArrayObject is still empty!");
     return PyArray_NDIM(_PyPtr);
 }
+
+std::string ArrayObject::DType()
+{
+    ASSERT_ALLWAYS(_PyPtr != nullptr, "ArrayObject is still empty!");
+    PyArray_Descr* descr = PyArray_DESCR((PyArrayObject*)_PyPtr);
+    ASSERT_ALLWAYS(descr->byteorder != '>', "Big endian array is not supported!");
+    int size = PyArray_ITEMSIZE((PyArrayObject*)_PyPtr);
+    char order = size == 1 ? '|' : '<';
+    return string(1, order) + descr->kind + ToString(size);
 }
+
+const char* ArrayObject::Bytes()
+{
+    ASSERT_ALLWAYS(_PyPtr != nullptr, "ArrayObject is still empty!");
+    return reinterpret_cast<const char*>(PyArray_DATA(_PyPtr));
+}
+
+size_t ArrayObject::NBytes()
+{
+    ASSERT_ALLWAYS(_PyPtr != nullptr, "ArrayObject is still empty!");
+    return PyArray_NBYTES((PyArrayObject*)_PyPtr);
+}
+}
+
+#endif
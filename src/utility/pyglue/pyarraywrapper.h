@@ -9,8 +9,14 @@
 #ifndef __Feynman_Simulator__pyarraywrapper__
 #define __Feynman_Simulator__pyarraywrapper__
 
+//without python, the native backend has the same interface
+#ifdef NO_PYTHON
+#include "native.h"
+#else
+
 #include "utility/abort.h"
 #include <vector>
+#include <memory>
 #include "object.h"
 
 namespace Python {
@@ -36,11 +42,32 @@ public:
     {
         _Construct(data, Shape, Dim);
     }
+    //the array shares the ownership of data with Owner, so it stays valid after its creator is gone
+    template <typename T>
+    ArrayObject(T* data, const std::vector<uint>& Shape, const int Dim, const std::shared_ptr<const void>& Owner)
+    {
+        _Construct(data, Shape.data(), Dim);
+        _KeepAlive(Owner);
+    }
+    template <typename T>
+    ArrayObject(T* data, const uint* Shape, const int Dim, const std::shared_ptr<const void>& Owner)
+    {
+        _Construct(data, Shape, Dim);
+        _KeepAlive(Owner);
+    }
+    //a new array which owns a copy of data, DType is in numpy's typestr format, like "<c16"
+    ArrayObject(const std::string& DType, const std::vector<uint>& Shape, const void* data);
     template <typename T>
     T* Data();
     std::vector<uint> Shape();
     uint Size();
     int Dim();
+    std::string DType();
+    const char* Bytes();
+    size_t NBytes();
+    bool IsWritable();
+    //shared ownership of the data of the array, which keeps the array alive, so that it can be used in place
+    std::shared_ptr<char> Share();
     ArrayObject& operator=(const ArrayObject& obj)
     {
         Object::operator=(obj);
@@ -50,7 +77,10 @@ public:
 private:
     void _Construct(real* data, const uint* Shape, const int Dim);
     void _Construct(Complex* data, const uint* Shape, const int Dim);
+    void _KeepAlive(const std::shared_ptr<const void>& Owner);
 };
 }
 
+#endif /* NO_PYTHON */
+
 #endif /* defined(__Feynman_Simulator__pyarraywrapper__) */
@@ -18,6 +18,8 @@
  * 
  */
 
+#ifndef NO_PYTHON
+
 #include "utility/utility.h"
 #include "utility/complex.h"
 #include <stdio.h>
@@ -113,4 +115,6 @@ bool ModuleObject::HasAttr(const std::string& name)
         return false;
     }
 }
-}
\ No newline at end of file
+}
+
+#endif
@@ -21,6 +21,11 @@
 #ifndef PYWRAPPER_H
 #define PYWRAPPER_H
 
+//without python, the native backend has the same interface
+#ifdef NO_PYTHON
+#include "native.h"
+#else
+
 #include "utility/abort.h"
 #include "type_cast.h"
 #include "pyarraywrapper.h"
@@ -212,4 +217,6 @@ private:
 };
 };
 
+#endif /* NO_PYTHON */
+
 #endif // PYWRAPPER_H
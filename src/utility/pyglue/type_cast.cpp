@@ -6,6 +6,8 @@
 //  Copyright (c) 2014 Kun Chen. All rights reserved.
 //
 
+#ifndef NO_PYTHON
+
 #include "utility/complex.h"
 #include "utility/rng.h"
 #include "utility/momentum.h"
@@ -196,6 +198,16 @@ Object CastToPy(Object obj)
     return obj.Copy();
 }
 
+Object NoneObject()
+{
+    return Object(Py_None, NoRef);
+}
+
+bool IsNone(const Object& obj)
+{
+    return obj.Get() == nullptr || obj.Get() == Py_None;
+}
+
 Object CastToPy(spin num)
 {
     return CastToPy((int)num);
@@ -205,3 +217,5 @@ Object CastToPy(Momentum k)
     return CastToPy(k.K);
 }
 }
+
+#endif
@@ -9,6 +9,11 @@
 #ifndef __Feynman_Simulator__type_cast__
 #define __Feynman_Simulator__type_cast__
 
+//without python, the native backend has the same interface
+#ifdef NO_PYTHON
+#include "native.h"
+#else
+
 #include <string>
 #include <utility>
 #include <sstream>
@@ -157,6 +162,9 @@ Object CastToPy(spin num);
 Object CastToPy(Momentum num);
 Object CastToPy(const ITypeCast& val);
 Object CastToPy(Object);
+// Py_None, an empty Object is also taken as None
+Object NoneObject();
+bool IsNone(const Object& obj);
 // Creates a PyObject from a std::vector
 
 // Generic python list allocation
@@ -204,4 +212,6 @@ Object CastToPy(
     return dict;
 }
 }
+#endif /* NO_PYTHON */
+
 #endif /* defined(__Feynman_Simulator__type_cast__) */
@@ -8,40 +8,174 @@
 
 #include "rng.h"
 #include <sstream>
+#include <algorithm>
 
 using namespace std;
 
+static const char* PHILOX_NAME = "Philox4x32-10";
+
+const uint32_t PHILOX_M0 = 0xD2511F53, PHILOX_M1 = 0xCD9E8D57;
+const uint32_t PHILOX_W0 = 0x9E3779B9, PHILOX_W1 = 0xBB67AE85;
+
+inline void PhiloxRound(uint32_t& c0, uint32_t& c1, uint32_t& c2, uint32_t& c3, uint32_t k0, uint32_t k1)
+{
+    uint64_t p0 = (uint64_t)PHILOX_M0 * c0;
+    uint64_t p1 = (uint64_t)PHILOX_M1 * c2;
+    uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+    uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+    c1 = (uint32_t)p1;
+    c3 = (uint32_t)p0;
+    c0 = n0;
+    c2 = n2;
+}
+
+/**
+*  Philox4x32-10 of Salmon et al., "Parallel random numbers: as easy as 1, 2, 3", SC'11:
+*  ten rounds of two 32x32->64 multiplications, which is a bijection of the 128 bits counter
+*  for every key, so that different counters never give the same block.
+*/
+void Philox4x32(const uint32_t counter[4], const uint32_t key[2], uint32_t out[4])
+{
+    uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+    uint32_t k0 = key[0], k1 = key[1];
+    for (int round = 0; round < 10; round++) {
+        PhiloxRound(c0, c1, c2, c3, k0, k1);
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+}
+
+/**
+*  the blocks are independent, so they are computed in lanes of 8, which the compiler can vectorize
+*/
+void Philox4x32(unsigned long long seed, unsigned long long stream, unsigned long long position, int n, uint32_t* out)
+{
+    const int LANE = 8;
+    for (int b = 0; b < n; b += LANE) {
+        uint32_t c0[LANE], c1[LANE], c2[LANE], c3[LANE];
+        for (int l = 0; l < LANE; l++) {
+            unsigned long long counter = position + b + l;
+            c0[l] = (uint32_t)counter;
+            c1[l] = (uint32_t)(counter >> 32);
+            c2[l] = (uint32_t)stream;
+            c3[l] = (uint32_t)(stream >> 32);
+        }
+        uint32_t k0 = (uint32_t)seed, k1 = (uint32_t)(seed >> 32);
+        for (int round = 0; round < 10; round++) {
+            for (int l = 0; l < LANE; l++)
+                PhiloxRound(c0[l], c1[l], c2[l], c3[l], k0, k1);
+            k0 += PHILOX_W0;
+            k1 += PHILOX_W1;
+        }
+        for (int l = 0; l < LANE; l++) {
+            uint32_t* block = out + 4 * (b + l);
+            block[0] = c0[l];
+            block[1] = c1[l];
+            block[2] = c2[l];
+            block[3] = c3[l];
+        }
+    }
+}
+
+void RandomFactory::_Refill()
+{
+    Philox4x32(_Seed, _Stream, _Position, RNG_BLOCKS, _Buffer);
+    _Position += RNG_BLOCKS;
+    _Index = 0;
+}
+
 RandomFactory::RandomFactory()
 {
-    random_device dev;
-    _eng.seed(dev());
+    Reset();
 }
 
 RandomFactory::RandomFactory(int seed)
 {
-    _eng.seed(seed);
+    _Engine = MT19937;
+    Reset(seed);
 }
 
 RandomFactory::RandomFactory(const std::string& state)
 {
+    _Engine = MT19937;
     Reset(state);
 }
 
 void RandomFactory::Reset()
 {
     random_device dev;
+    _Engine = MT19937;
     _eng.seed(dev());
 }
 
 void RandomFactory::Reset(int seed)
 {
-    _eng.seed(seed);
+    if (_Engine == PHILOX)
+        Reset((unsigned long long)(unsigned int)seed, 0);
+    else
+        _eng.seed(seed);
 }
 
 void RandomFactory::Reset(const std::string& state)
 {
     std::istringstream iss(state);
-    iss >> _eng;
+    iss >> *this;
+}
+
+void RandomFactory::Reset(unsigned long long seed, unsigned long long stream)
+{
+    _Engine = PHILOX;
+    _Seed = seed;
+    _Stream = stream;
+    //the buffer is filled by the first number
+    _Position = 0;
+    _Index = RNG_BUFFER;
+}
+
+/**
+*  switch the engine, the new engine starts from a seed drawn from the old one
+*/
+void RandomFactory::SetEngine(RNGEngine engine)
+{
+    if (engine == _Engine)
+        return;
+    int seed = irn(0, 1 << 30);
+    _Engine = engine;
+    Reset(seed);
+}
+
+RandomFactory RandomFactory::Spawn()
+{
+    RandomFactory rng(*this);
+    if (_Engine == PHILOX) {
+        unsigned long long high = _Next();
+        rng.Reset(_Seed, (high << 32) | _Next());
+    }
+    else
+        rng.Reset(irn(0, 1 << 30));
+    return rng;
+}
+
+void RandomFactory::Fill(real* buffer, int n)
+{
+    if (_Engine == MT19937) {
+        for (int i = 0; i < n; i++)
+            buffer[i] = urn();
+        return;
+    }
+    for (int i = 0; i < n;) {
+        if (_Index == RNG_BUFFER)
+            _Refill();
+        int count = min(n - i, RNG_BUFFER - _Index);
+        for (int j = 0; j < count; j++)
+            buffer[i + j] = RANDBL_32(_Buffer[_Index + j]);
+        _Index += count;
+        i += count;
+    }
 }
 
 // double pick_a_number(double from, double upto)
@@ -51,22 +185,52 @@ void RandomFactory::Reset(const std::string& state)
 //    return d(global_urng(), parm_t{from, upto});
 //}
 
+/**
+*  PHILOX is written as "Philox4x32-10 seed stream position index", where the next number is word
+*  index (1 to 4) of block position-1 of the stream, MT19937 as the text of std::mt19937
+*/
 std::ostream& operator<<(std::ostream& os, RandomFactory& r)
 {
-    os << r._eng;
+    if (r._Engine == PHILOX) {
+        unsigned long long word = r._Position * 4 - RNG_BUFFER + r._Index;
+        int index = word % 4 == 0 ? 4 : word % 4;
+        //a fresh stream has not used any word yet, it is position 0
+        unsigned long long position = word == 0 ? 0 : (word - index) / 4 + 1;
+        os << PHILOX_NAME << " " << r._Seed << " " << r._Stream << " " << position << " " << index;
+    }
+    else
+        os << r._eng;
     return os;
 }
 
 std::istream& operator>>(std::istream& is, RandomFactory& r)
 {
-    is >> r._eng;
+    is >> ws;
+    if (is.peek() != 'P') {
+        r._Engine = MT19937;
+        is >> r._eng;
+        return is;
+    }
+    string name;
+    unsigned long long seed, stream, position;
+    int index;
+    is >> name >> seed >> stream >> position >> index;
+    if (is.fail() || name != PHILOX_NAME || index < 0 || index > 4 || (position == 0 && index < 4)) {
+        is.setstate(ios::failbit);
+        return is;
+    }
+    unsigned long long word = (position - 1) * 4 + index;
+    r.Reset(seed, stream);
+    r._Position = word / 4;
+    r._Refill();
+    r._Index = word % 4;
     return is;
 }
 
 std::string ToString(const RandomFactory& rng)
 {
     std::ostringstream oss;
-    oss << rng._eng;
+    oss << const_cast<RandomFactory&>(rng);
     return oss.str();
 }
 RandomFactory RNG;
@@ -11,6 +11,7 @@
 
 #include <random>
 #include <string>
+#include <stdint.h>
 typedef double real;
 
 #define M_RAN_INVM32 2.32830643653869628906e-010
@@ -30,30 +31,76 @@ Jurgen A. Doornik. 2007. Conversion of high-period random numbers to floating po
 #define RANDBL_52_NO_ZERO(iRan1, iRan2) \
     ((int)(iRan1)*M_RAN_INVM32 + (0.5 + M_RAN_INVM52 / 2) + (int)((iRan2)&0x000FFFFF) * M_RAN_INVM52)
 
+//engines of RandomFactory
+enum RNGEngine {
+    MT19937, //std::mt19937, the state is a text of about 5KB
+    PHILOX //counter-based Philox4x32-10, addressed by (seed, stream), the state is a few words
+};
+//blocks of 4 words which a PHILOX engine generates at once
+const int RNG_BLOCKS = 64;
+const int RNG_BUFFER = 4 * RNG_BLOCKS;
+
 class RandomFactory {
     friend std::ostream& operator<<(std::ostream& os, RandomFactory& r);
     friend std::istream& operator>>(std::istream& is, RandomFactory& r);
     friend std::string ToString(const RandomFactory& RNG);
 
 private:
+    RNGEngine _Engine;
     std::mt19937 _eng;
+    //Philox: _Buffer keeps the RNG_BLOCKS blocks before the counter (_Position, _Stream) under key _Seed,
+    //its words before _Index are used. The next word is always word _Position*4-RNG_BUFFER+_Index of the stream,
+    //so that the numbers do not depend on the buffer.
+    unsigned long long _Seed;
+    unsigned long long _Stream;
+    unsigned long long _Position;
+    int _Index;
+    uint32_t _Buffer[RNG_BUFFER];
+    void _Refill();
+    inline uint32_t _Next()
+    {
+        if (_Engine == MT19937)
+            return (uint32_t)_eng();
+        if (_Index == RNG_BUFFER)
+            _Refill();
+        return _Buffer[_Index++];
+    }
 
 public:
     RandomFactory();
     RandomFactory(int);
     RandomFactory(const std::string& state);
     void Reset();
+    //keep the engine, the stream of a PHILOX engine restarts from 0
     void Reset(int);
     void Reset(const std::string& state);
+    //switch to a PHILOX engine at the beginning of stream of seed,
+    //different streams of the same seed never overlap
+    void Reset(unsigned long long seed, unsigned long long stream);
+    void SetEngine(RNGEngine);
+    RNGEngine Engine() const { return _Engine; }
+    //a generator for another walker: a new stream of the same seed for PHILOX,
+    //a new seed drawn from this generator for MT19937
+    RandomFactory Spawn();
     inline real urn()
     {
-        return RANDBL_32(_eng());
+        return RANDBL_32(_Next());
     }
+    //fill buffer with n numbers of urn(), the same numbers as n calls of urn()
+    void Fill(real* buffer, int n);
 
     //Generator integer random numbers in the closed interval [from, thru]
+    //unbiased, with Lemire's multiply-and-reject instead of a modulo
     inline int irn(int from, int thru)
     {
-        return _eng() % (thru - from + 1) + from;
+        uint32_t range = (uint32_t)(thru - from) + 1;
+        uint64_t m = (uint64_t)_Next() * range;
+        if ((uint32_t)m < range) {
+            uint32_t threshold = (uint32_t)(-range) % range;
+            while ((uint32_t)m < threshold)
+                m = (uint64_t)_Next() * range;
+        }
+        return from + (int)(m >> 32);
     }
     //    inline int nrn(real mean, real std)
     //    {
@@ -62,5 +109,10 @@ public:
     //    }
 };
 
+//one block of Philox4x32-10, exposed for the known answer test
+void Philox4x32(const uint32_t counter[4], const uint32_t key[2], uint32_t out[4]);
+//n blocks with the counters (position, stream) to (position+n-1, stream) into out, n is a multiple of 8
+void Philox4x32(unsigned long long seed, unsigned long long stream, unsigned long long position, int n, uint32_t* out);
+
 int TestRNG();
 #endif
@@ -96,12 +96,84 @@ void Test_RNG_Bound_And_Efficiency()
     sput_fail_unless(flag == false, "RNG irn1() exceeds the limit");
 }
 
+void Test_Philox()
+{
+    //known answers of Random123
+    uint32_t out[4];
+    uint32_t counter0[4] = { 0, 0, 0, 0 }, key0[2] = { 0, 0 };
+    Philox4x32(counter0, key0, out);
+    sput_fail_unless(out[0] == 0x6627e8d5 && out[1] == 0xe169c58d && out[2] == 0xbc57ac4c && out[3] == 0x9b00dbd8,
+                     "Philox4x32-10 of zeros");
+    uint32_t counter1[4] = { 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344 }, key1[2] = { 0xa4093822, 0x299f31d0 };
+    Philox4x32(counter1, key1, out);
+    sput_fail_unless(out[0] == 0xd16cfe09 && out[1] == 0x94fdcceb && out[2] == 0x5001e420 && out[3] == 0x24126ea1,
+                     "Philox4x32-10 of pi");
+
+    RandomFactory RNG, Same;
+    RNG.Reset(7, 3);
+    Same.Reset(7, 3);
+    sput_fail_unless(ToString(RNG) == "Philox4x32-10 7 3 0 4", "Philox state of a fresh stream");
+    RandomFactory Fresh(ToString(RNG));
+    sput_fail_unless(Fresh.Engine() == PHILOX && Fresh.urn() == Same.urn(), "import/export a fresh Philox state");
+    Same.Reset(7, 3);
+    RNG.urn();
+    Same.urn();
+    string state = ToString(RNG);
+    sput_fail_unless(state.size() < 64, "Philox state is a few words");
+    real a = RNG.urn();
+    RandomFactory Loaded(state);
+    sput_fail_unless(Loaded.Engine() == PHILOX && Loaded.urn() == a, "import/export the Philox state");
+
+    const int n = 11;
+    real bulk[n];
+    Same.urn();
+    Same.Fill(bulk, n);
+    bool IsSame = true;
+    for (int i = 0; i < n; i++)
+        IsSame &= (bulk[i] == RNG.urn());
+    sput_fail_unless(IsSame, "Fill gives the same numbers as urn()");
+
+    RandomFactory Other;
+    Other.Reset(7, 4);
+    IsSame = true;
+    for (int i = 0; i < n; i++)
+        IsSame &= (Other.urn() == RNG.urn());
+    sput_fail_unless(!IsSame, "Streams of the same seed are different");
+    RandomFactory Walker = RNG.Spawn();
+    sput_fail_unless(Walker.Engine() == PHILOX && Walker.urn() != RNG.urn(), "Spawn a new stream");
+
+    //the buffer does not change the numbers, even if the state is saved in the middle of it
+    RandomFactory Buffered;
+    Buffered.Reset(7, 3);
+    IsSame = true;
+    for (int i = 0; i < 2 * RNG_BUFFER + 5; i++) {
+        uint32_t counter[4] = { (uint32_t)(i / 4), 0, 3, 0 }, key[2] = { 7, 0 }, block[4];
+        Philox4x32(counter, key, block);
+        IsSame &= (Buffered.urn() == RANDBL_32(block[i % 4]));
+    }
+    sput_fail_unless(IsSame, "Buffered numbers are the words of the stream");
+    RandomFactory Resumed(ToString(Buffered));
+    IsSame = true;
+    for (int i = 0; i < RNG_BUFFER; i++)
+        IsSame &= (Resumed.urn() == Buffered.urn());
+    sput_fail_unless(IsSame, "Resume from the middle of the buffer");
+
+    //range 3*2^29: a modulo of 32 bits gives the numbers below 2^30 with probability 3/4 instead of 2/3
+    const int N = 300000;
+    int low = 0;
+    for (int i = 0; i < N; i++)
+        if (RNG.irn(0, 3 * (1 << 29) - 1) < (1 << 30))
+            low++;
+    sput_fail_unless(fabs(low / (real)N - 2.0 / 3.0) < 5.0 / sqrt(N), "irn() is unbiased");
+}
+
 int TestRNG()
 {
     sput_start_testing();
     sput_enter_suite("Test Random Number Generator");
     sput_run_test(Test_RNG_IO);
     sput_run_test(Test_RNG_Bound_And_Efficiency);
+    sput_run_test(Test_Philox);
     sput_finish_testing();
     return sput_get_return_value();
 }